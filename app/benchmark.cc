@@ -0,0 +1,399 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/geom.h"
+#include "../inc/ic.h"
+#include "../inc/bc.h"
+#include "../inc/gradient.h"
+#include "../inc/spatial.h"
+#include "../inc/temporal.h"
+#include "../inc/poisson.h"
+#include "../inc/misc.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+std::vector<Patch *> patch;
+std::vector<Node *> node;
+std::vector<Face *> face;
+std::vector<Cell *> cell;
+
+/// Time step of the integrators, small enough for the finest mesh of a typical sweep.
+static const FLM_SCALAR dt = 1e-7;
+
+/// A timed operation on the loaded mesh.
+struct Kernel
+{
+    const char *name;
+    std::function<void(const std::string &)> run;
+    bool reload; /// Mesh has to be prepared again afterwards
+};
+
+/// Timing statistics of one kernel on one mesh with one thread count, in seconds.
+struct Result
+{
+    std::string kernel, mesh;
+    size_t nodes, faces, cells, threads;
+    std::vector<FLM_SCALAR> sample;
+    FLM_SCALAR min, max, mean, stddev, median, mad;
+};
+
+static void usage()
+{
+    std::cout << "Usage: BENCHMARK [--mesh <path or gen spec> ...] [--shape <hex|tet|prism|pyramid> ...] [--size <n> ...]" << std::endl;
+    std::cout << "                 [--threads <n> ...] [--kernel <name> ...] [--warmup <n>] [--repeat <n>]" << std::endl;
+    std::cout << "                 [--json <path>] [--csv <path>]" << std::endl;
+    std::cout << "  Without \"--mesh\", meshes \"gen:<shape>:<n>\" are generated for each shape and size," << std::endl;
+    std::cout << "  \"hex\" and \"tet\" with n=16 and n=32 by default." << std::endl;
+    std::cout << "  Each kernel is run \"warmup\" times untimed, then \"repeat\" times timed, for each thread count." << std::endl;
+    std::cout << "  Kernels:";
+}
+
+static void release_mesh()
+{
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+    node.clear();
+    face.clear();
+    cell.clear();
+    patch.clear();
+}
+
+/**
+ * Everything the solver does between loading the mesh and the first time step.
+ */
+static void prepare()
+{
+    set_bc_desc();
+    set_bc_val();
+    calculate_geometric_value();
+    check_skewness();
+    prepare_lsq();
+    prepare_poisson();
+    zero_init();
+    interpolate_face_value();
+    interpolate_nodal_value();
+}
+
+static void set_threads(size_t n)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(static_cast<int>(n));
+#endif
+}
+
+static size_t max_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static FLM_SCALAR median(std::vector<FLM_SCALAR> x)
+{
+    const size_t n = x.size();
+    std::sort(x.begin(), x.end());
+    return n % 2 ? x[n / 2] : 0.5 * (x[n / 2 - 1] + x[n / 2]);
+}
+
+static void summarize(Result &r)
+{
+    const auto &x = r.sample;
+    const size_t n = x.size();
+
+    r.min = *std::min_element(x.begin(), x.end());
+    r.max = *std::max_element(x.begin(), x.end());
+
+    r.mean = 0.0;
+    for (auto e : x)
+        r.mean += e;
+    r.mean /= n;
+
+    r.stddev = 0.0;
+    for (auto e : x)
+        r.stddev += (e - r.mean) * (e - r.mean);
+    r.stddev = n > 1 ? std::sqrt(r.stddev / (n - 1)) : 0.0;
+
+    /// Median absolute deviation, insensitive to the occasional descheduled run
+    r.median = median(x);
+    std::vector<FLM_SCALAR> dev(n);
+    for (size_t i = 0; i < n; ++i)
+        dev[i] = std::abs(x[i] - r.median);
+    r.mad = median(dev);
+}
+
+static std::string json_str(const std::string &s)
+{
+    std::ostringstream ss;
+    ss << '"';
+    for (char ch : s)
+    {
+        if (ch == '"' || ch == '\\')
+            ss << '\\' << ch;
+        else if (static_cast<unsigned char>(ch) < 0x20)
+            ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec << std::setfill(' ');
+        else
+            ss << ch;
+    }
+    ss << '"';
+    return ss.str();
+}
+
+static void write_json(const std::string &path, const std::vector<Result> &res, size_t warmup, size_t repeat)
+{
+    std::ofstream out(path);
+    if (out.fail())
+        throw failed_to_open_file(path);
+
+    std::string date;
+    runtime_str(date);
+
+    out << std::setprecision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+    out << "{\n";
+    out << "  \"benchmark\": \"Diffusion3D\",\n";
+    out << "  \"format\": 1,\n";
+    out << "  \"date\": " << json_str(date) << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"repeat\": " << repeat << ",\n";
+    out << "  \"unit\": \"s\",\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < res.size(); ++i)
+    {
+        const auto &r = res[i];
+        out << (i ? ",\n" : "\n") << "    {";
+        out << "\"kernel\": " << json_str(r.kernel) << ", \"mesh\": " << json_str(r.mesh);
+        out << ", \"nodes\": " << r.nodes << ", \"faces\": " << r.faces << ", \"cells\": " << r.cells << ", \"threads\": " << r.threads;
+        out << ", \"min\": " << r.min << ", \"max\": " << r.max << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev;
+        out << ", \"median\": " << r.median << ", \"mad\": " << r.mad << ", \"samples\": [";
+        for (size_t k = 0; k < r.sample.size(); ++k)
+            out << (k ? ", " : "") << r.sample[k];
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void write_csv(const std::string &path, const std::vector<Result> &res)
+{
+    std::ofstream out(path);
+    if (out.fail())
+        throw failed_to_open_file(path);
+
+    out << std::setprecision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+    out << "kernel,mesh,nodes,faces,cells,threads,min,max,mean,stddev,median,mad\n";
+    for (const auto &r : res)
+    {
+        out << r.kernel << ",\"" << r.mesh << "\"," << r.nodes << "," << r.faces << "," << r.cells << "," << r.threads;
+        out << "," << r.min << "," << r.max << "," << r.mean << "," << r.stddev << "," << r.median << "," << r.mad << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<Kernel> KERNEL = {
+        {"load_mesh", [](const std::string &spec) { release_mesh(); load_mesh(spec); }, true},
+        {"calculate_geometric_value", [](const std::string &) { calculate_geometric_value(); }, false},
+        {"prepare_lsq", [](const std::string &) { prepare_lsq(); }, false},
+        {"interpolate_nodal_value", [](const std::string &) { interpolate_nodal_value(); }, false},
+        {"interpolate_face_value", [](const std::string &) { interpolate_face_value(); }, false},
+        {"gradient.gg1", [](const std::string &) { calculate_cell_gradient(FLM_GRADIENT::GG1); }, false},
+        {"gradient.gg2", [](const std::string &) { calculate_cell_gradient(FLM_GRADIENT::GG2); }, false},
+        {"gradient.lsq", [](const std::string &) { calculate_cell_gradient(FLM_GRADIENT::LSQ); }, false},
+        {"calculate_residual", [](const std::string &) { static std::vector<FLM_SCALAR> R; calculate_residual(R); }, false},
+        {"ForwardEuler", [](const std::string &) { ForwardEuler(dt); }, false},
+        {"RK3", [](const std::string &) { RK3(dt); }, false},
+        {"prepare_poisson", [](const std::string &) { prepare_poisson(); }, false},
+        {"solve_poisson", [](const std::string &) {
+            const std::vector<FLM_SCALAR> source(cell.size(), 0.0);
+            FLM_POISSON_STAT stat;
+            zero_init();
+            solve_poisson(source, FLM_GRADIENT::LSQ, 1e-8, 20, stat);
+        }, false}};
+
+    std::vector<std::string> MESH, SHAPE, KERNEL_NAME;
+    std::vector<size_t> SIZE, THREADS;
+    size_t WARMUP = 2, REPEAT = 10;
+    std::string JSON_PATH, CSV_PATH;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--mesh"))
+        {
+            MESH.emplace_back(argv[cnt + 1]);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--shape"))
+        {
+            SHAPE.emplace_back(argv[cnt + 1]);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--size"))
+        {
+            char *pEnd;
+            SIZE.push_back(std::strtoul(argv[cnt + 1], &pEnd, 10));
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--threads"))
+        {
+            char *pEnd;
+            THREADS.push_back(std::strtoul(argv[cnt + 1], &pEnd, 10));
+            if (THREADS.back() == 0)
+                throw std::invalid_argument("Number of threads must be positive.");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--kernel"))
+        {
+            const std::string name = argv[cnt + 1];
+            if (std::none_of(KERNEL.begin(), KERNEL.end(), [&name](const Kernel &k) { return name == k.name; }))
+                throw std::invalid_argument("Unrecognized kernel: \"" + name + "\".");
+            KERNEL_NAME.push_back(name);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--warmup"))
+        {
+            char *pEnd;
+            WARMUP = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--repeat"))
+        {
+            char *pEnd;
+            REPEAT = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            if (REPEAT == 0)
+                throw std::invalid_argument("Number of repetitions must be positive.");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--json"))
+        {
+            JSON_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--csv"))
+        {
+            CSV_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--help"))
+        {
+            usage();
+            for (const auto &k : KERNEL)
+                std::cout << " " << k.name;
+            std::cout << std::endl;
+            return 0;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (MESH.empty())
+    {
+        if (SHAPE.empty())
+            SHAPE = {"hex", "tet"};
+        if (SIZE.empty())
+            SIZE = {16, 32};
+        for (const auto &s : SHAPE)
+            for (auto n : SIZE)
+                MESH.push_back("gen:" + s + ":" + std::to_string(n));
+    }
+    if (THREADS.empty())
+        THREADS.push_back(max_threads());
+#ifndef _OPENMP
+    if (THREADS.size() != 1 || THREADS[0] != 1)
+        throw std::invalid_argument("Built without OpenMP, only 1 thread is available.");
+#endif
+
+    std::vector<const Kernel *> selected;
+    for (const auto &k : KERNEL)
+        if (KERNEL_NAME.empty() || std::find(KERNEL_NAME.begin(), KERNEL_NAME.end(), k.name) != KERNEL_NAME.end())
+            selected.push_back(&k);
+
+    /// Set-up reports, such as the skewness histogram, are not of interest here
+    std::ostringstream discard;
+    auto console = std::cout.rdbuf();
+
+    std::vector<Result> res;
+    for (const auto &spec : MESH)
+    {
+        std::cout << "\nMesh \"" << spec << "\"" << std::endl;
+        std::cout.rdbuf(discard.rdbuf());
+        release_mesh();
+        load_mesh(spec);
+        prepare();
+        std::cout.rdbuf(console);
+        std::cout << "  " << node.size() << " nodes, " << face.size() << " faces, " << cell.size() << " cells" << std::endl;
+        std::cout << "  " << std::left << std::setw(28) << "kernel" << std::right << std::setw(8) << "threads";
+        std::cout << std::setw(14) << "median(s)" << std::setw(14) << "mad(s)" << std::setw(14) << "min(s)" << std::setw(14) << "ns/cell" << std::endl;
+
+        for (auto nt : THREADS)
+        {
+            set_threads(nt);
+            for (auto k : selected)
+            {
+                Result r;
+                r.kernel = k->name;
+                r.mesh = spec;
+                r.threads = nt;
+                r.sample.resize(REPEAT);
+
+                for (size_t i = 0; i < WARMUP; ++i)
+                    k->run(spec);
+                for (size_t i = 0; i < REPEAT; ++i)
+                {
+                    auto t0 = std::chrono::steady_clock::now();
+                    k->run(spec);
+                    auto t1 = std::chrono::steady_clock::now();
+                    r.sample[i] = duration(t0, t1);
+                }
+                if (k->reload)
+                {
+                    std::cout.rdbuf(discard.rdbuf());
+                    prepare();
+                    std::cout.rdbuf(console);
+                    discard.str("");
+                }
+
+                r.nodes = node.size();
+                r.faces = face.size();
+                r.cells = cell.size();
+                summarize(r);
+
+                std::cout << "  " << std::left << std::setw(28) << r.kernel << std::right << std::setw(8) << r.threads;
+                std::cout << std::scientific << std::setprecision(4) << std::setw(14) << r.median << std::setw(14) << r.mad << std::setw(14) << r.min;
+                std::cout << std::fixed << std::setprecision(2) << std::setw(14) << 1e9 * r.median / r.cells << std::defaultfloat << std::endl;
+                res.push_back(std::move(r));
+            }
+        }
+    }
+    release_mesh();
+
+    if (!JSON_PATH.empty())
+    {
+        write_json(JSON_PATH, res, WARMUP, REPEAT);
+        std::cout << "\nResults written to \"" << JSON_PATH << "\"" << std::endl;
+    }
+    if (!CSV_PATH.empty())
+    {
+        write_csv(CSV_PATH, res);
+        std::cout << "\nResults written to \"" << CSV_PATH << "\"" << std::endl;
+    }
+
+    return 0;
+}
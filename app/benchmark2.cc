@@ -0,0 +1,177 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <chrono>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/misc.h"
+
+std::vector<Patch *> patch;
+std::vector<Node *> node;
+std::vector<Face *> face;
+std::vector<Cell *> cell;
+
+static void release_mesh()
+{
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+    node.clear();
+    face.clear();
+    cell.clear();
+    patch.clear();
+}
+
+template<typename T>
+static bool same_ref(const T *a, const T *b)
+{
+    if (a == nullptr || b == nullptr)
+        return a == b;
+    return a->index == b->index;
+}
+
+template<typename T>
+static bool same_refs(const std::vector<T *> &a, const std::vector<T *> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (!same_ref(a[i], b[i]))
+            return false;
+    return true;
+}
+
+/**
+ * Entity-by-entity comparison of the loaded mesh against a reference one.
+ * Values are compared bitwise, references by index.
+ */
+static bool identical(const std::vector<Node *> &n_ref, const std::vector<Face *> &f_ref, const std::vector<Cell *> &c_ref, const std::vector<Patch *> &p_ref)
+{
+    if (n_ref.size() != node.size() || f_ref.size() != face.size() || c_ref.size() != cell.size() || p_ref.size() != patch.size())
+        return false;
+
+    for (size_t i = 0; i < node.size(); ++i)
+    {
+        auto a = n_ref[i], b = node[i];
+        if (a->index != b->index || a->at_boundary != b->at_boundary || a->coordinate != b->coordinate ||
+            !same_refs(a->cell_dependency, b->cell_dependency))
+            return false;
+    }
+
+    for (size_t i = 0; i < face.size(); ++i)
+    {
+        auto a = f_ref[i], b = face[i];
+        if (a->index != b->index || a->at_boundary() != b->at_boundary() || a->centroid != b->centroid ||
+            a->area != b->area || !same_refs(a->vertex, b->vertex) || !same_ref(a->c0, b->c0) ||
+            !same_ref(a->c1, b->c1) || a->n01 != b->n01 || a->n10 != b->n10 ||
+            (a->parent == nullptr) != (b->parent == nullptr) || (a->parent && a->parent->name != b->parent->name))
+            return false;
+    }
+
+    for (size_t i = 0; i < cell.size(); ++i)
+    {
+        auto a = c_ref[i], b = cell[i];
+        if (a->index != b->index || a->centroid != b->centroid || a->volume != b->volume ||
+            !same_refs(a->vertex, b->vertex) || !same_refs(a->surface, b->surface) ||
+            !same_refs(a->cell_adjacency, b->cell_adjacency) || a->S != b->S)
+            return false;
+    }
+
+    for (size_t i = 0; i < patch.size(); ++i)
+    {
+        auto a = p_ref[i], b = patch[i];
+        if (a->name != b->name || !same_refs(a->surface, b->surface) || !same_refs(a->vertex, b->vertex))
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> MESH_PATH;
+    size_t REPEAT = 3;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--mesh"))
+        {
+            MESH_PATH.emplace_back(argv[cnt + 1]);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--repeat"))
+        {
+            char *pEnd;
+            REPEAT = std::strtol(argv[cnt + 1], &pEnd, 10);
+            cnt += 2;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (MESH_PATH.empty())
+    {
+        std::cout << "Usage: MESH-LOAD --mesh <text mesh> [--mesh <text mesh> ...] [--repeat N]" << std::endl;
+        return 1;
+    }
+
+    bool all_identical = true;
+    std::cout << std::fixed << std::setprecision(4);
+    for (const auto &fn : MESH_PATH)
+    {
+        FLM_SCALAR t_stream = 0.0, t_mapped = 0.0;
+        bool same = true;
+        for (size_t k = 0; k < REPEAT; ++k)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            {
+                std::ifstream in(fn);
+                if (in.fail())
+                    throw failed_to_open_file(fn);
+                read_mesh(in);
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            t_stream += duration(t0, t1);
+
+            std::vector<Node *> n_ref;
+            std::vector<Face *> f_ref;
+            std::vector<Cell *> c_ref;
+            std::vector<Patch *> p_ref;
+            std::swap(n_ref, node);
+            std::swap(f_ref, face);
+            std::swap(c_ref, cell);
+            std::swap(p_ref, patch);
+
+            t0 = std::chrono::steady_clock::now();
+            read_mesh_mapped(fn);
+            t1 = std::chrono::steady_clock::now();
+            t_mapped += duration(t0, t1);
+
+            same = same && identical(n_ref, f_ref, c_ref, p_ref);
+            release_mesh();
+            std::swap(n_ref, node);
+            std::swap(f_ref, face);
+            std::swap(c_ref, cell);
+            std::swap(p_ref, patch);
+            release_mesh();
+        }
+
+        t_stream /= REPEAT;
+        t_mapped /= REPEAT;
+        std::cout << "\"" << fn << "\"" << std::endl;
+        std::cout << "  std::istream: " << t_stream << "s" << std::endl;
+        std::cout << "  from_chars:   " << t_mapped << "s (x" << t_stream / t_mapped << ")" << std::endl;
+        std::cout << "  Output: " << (same ? "identical" : "DIFFERENT") << std::endl;
+        all_identical = all_identical && same;
+    }
+
+    return all_identical ? 0 : 1;
+}
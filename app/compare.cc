@@ -0,0 +1,501 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <string>
+#include "../inc/error.h"
+
+/// Parsed JSON value, enough for the result files written by BENCHMARK.
+struct JsonValue
+{
+    enum class Type : int
+    {
+        Null = 0,
+        Bool = 1,
+        Number = 2,
+        String = 3,
+        Array = 4,
+        Object = 5
+    };
+
+    Type type = Type::Null;
+    bool b = false;
+    double num = 0.0;
+    std::string str;
+    std::vector<JsonValue> arr;
+    std::vector<std::pair<std::string, JsonValue>> obj;
+
+    const JsonValue *find(const std::string &key) const
+    {
+        for (const auto &e : obj)
+            if (e.first == key)
+                return &e.second;
+        return nullptr;
+    }
+};
+
+/**
+ * Recursive descent parser of RFC 8259 JSON.
+ * Errors are reported with the byte offset at which they are detected.
+ */
+class JsonParser
+{
+private:
+    const std::string &fn;
+    const std::string &s;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string &msg) const
+    {
+        throw invalid_file_format(fn, msg + " at offset " + std::to_string(pos) + ".");
+    }
+
+    void skip_space()
+    {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+            ++pos;
+    }
+
+    void expect(const char *word)
+    {
+        const size_t n = std::strlen(word);
+        if (s.compare(pos, n, word) != 0)
+            fail("expected \"" + std::string(word) + "\"");
+        pos += n;
+    }
+
+    static void append_utf8(std::string &dst, unsigned cp)
+    {
+        if (cp < 0x80)
+            dst += static_cast<char>(cp);
+        else if (cp < 0x800)
+        {
+            dst += static_cast<char>(0xC0 | (cp >> 6));
+            dst += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            dst += static_cast<char>(0xE0 | (cp >> 12));
+            dst += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            dst += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            dst += static_cast<char>(0xF0 | (cp >> 18));
+            dst += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            dst += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            dst += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    unsigned hex4()
+    {
+        if (pos + 4 > s.size())
+            fail("truncated escape");
+        unsigned x = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            const char ch = s[pos++];
+            x <<= 4;
+            if (ch >= '0' && ch <= '9')
+                x |= ch - '0';
+            else if (ch >= 'a' && ch <= 'f')
+                x |= ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F')
+                x |= ch - 'A' + 10;
+            else
+                fail("invalid escape");
+        }
+        return x;
+    }
+
+    std::string string()
+    {
+        ++pos;
+        std::string ret;
+        while (true)
+        {
+            if (pos >= s.size())
+                fail("unterminated string");
+            const char ch = s[pos++];
+            if (ch == '"')
+                break;
+            if (static_cast<unsigned char>(ch) < 0x20)
+                fail("control character in string");
+            if (ch != '\\')
+            {
+                ret += ch;
+                continue;
+            }
+            if (pos >= s.size())
+                fail("unterminated string");
+            switch (s[pos++])
+            {
+            case '"':
+                ret += '"';
+                break;
+            case '\\':
+                ret += '\\';
+                break;
+            case '/':
+                ret += '/';
+                break;
+            case 'b':
+                ret += '\b';
+                break;
+            case 'f':
+                ret += '\f';
+                break;
+            case 'n':
+                ret += '\n';
+                break;
+            case 'r':
+                ret += '\r';
+                break;
+            case 't':
+                ret += '\t';
+                break;
+            case 'u':
+            {
+                unsigned cp = hex4();
+                if (cp >= 0xD800 && cp < 0xDC00 && s.compare(pos, 2, "\\u") == 0)
+                {
+                    pos += 2;
+                    const unsigned lo = hex4();
+                    if (lo < 0xDC00 || lo >= 0xE000)
+                        fail("invalid surrogate pair");
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                append_utf8(ret, cp);
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+        return ret;
+    }
+
+    double number()
+    {
+        const char *b = s.c_str() + pos;
+        char *e;
+        const double x = std::strtod(b, &e);
+        if (e == b)
+            fail("invalid number");
+        pos += e - b;
+        return x;
+    }
+
+    JsonValue value()
+    {
+        skip_space();
+        if (pos >= s.size())
+            fail("unexpected end of file");
+
+        JsonValue ret;
+        const char ch = s[pos];
+        if (ch == '{')
+        {
+            ret.type = JsonValue::Type::Object;
+            ++pos;
+            skip_space();
+            if (pos < s.size() && s[pos] == '}')
+            {
+                ++pos;
+                return ret;
+            }
+            while (true)
+            {
+                skip_space();
+                if (pos >= s.size() || s[pos] != '"')
+                    fail("expected key");
+                std::string key = string();
+                skip_space();
+                expect(":");
+                ret.obj.emplace_back(std::move(key), value());
+                skip_space();
+                if (pos < s.size() && s[pos] == ',')
+                    ++pos;
+                else
+                {
+                    expect("}");
+                    break;
+                }
+            }
+        }
+        else if (ch == '[')
+        {
+            ret.type = JsonValue::Type::Array;
+            ++pos;
+            skip_space();
+            if (pos < s.size() && s[pos] == ']')
+            {
+                ++pos;
+                return ret;
+            }
+            while (true)
+            {
+                ret.arr.push_back(value());
+                skip_space();
+                if (pos < s.size() && s[pos] == ',')
+                    ++pos;
+                else
+                {
+                    expect("]");
+                    break;
+                }
+            }
+        }
+        else if (ch == '"')
+        {
+            ret.type = JsonValue::Type::String;
+            ret.str = string();
+        }
+        else if (ch == 't')
+        {
+            expect("true");
+            ret.type = JsonValue::Type::Bool;
+            ret.b = true;
+        }
+        else if (ch == 'f')
+        {
+            expect("false");
+            ret.type = JsonValue::Type::Bool;
+        }
+        else if (ch == 'n')
+            expect("null");
+        else
+        {
+            ret.type = JsonValue::Type::Number;
+            ret.num = number();
+        }
+        return ret;
+    }
+
+public:
+    JsonParser(const std::string &path, const std::string &text) :
+        fn(path),
+        s(text)
+    {}
+
+    JsonValue parse()
+    {
+        JsonValue ret = value();
+        skip_space();
+        if (pos != s.size())
+            fail("trailing characters");
+        return ret;
+    }
+};
+
+/// Timing statistics of one kernel on one mesh with one thread count.
+struct Entry
+{
+    size_t cells;
+    double median, mad;
+};
+
+/// Kernel, mesh and thread count.
+typedef std::tuple<std::string, std::string, size_t> Key;
+
+/**
+ * Load the results of a BENCHMARK run.
+ * @param fn Path of the JSON output.
+ * @param dst Statistics of each kernel, mesh and thread count.
+ */
+static void load_results(const std::string &fn, std::map<Key, Entry> &dst)
+{
+    std::ifstream fin(fn, std::ios::binary);
+    if (fin.fail())
+        throw failed_to_open_file(fn);
+    std::ostringstream ss;
+    ss << fin.rdbuf();
+    const std::string text = ss.str();
+
+    const JsonValue doc = JsonParser(fn, text).parse();
+    const JsonValue *res = doc.find("results");
+    if (doc.type != JsonValue::Type::Object || res == nullptr || res->type != JsonValue::Type::Array)
+        throw invalid_file_format(fn, "missing \"results\".");
+
+    for (const auto &r : res->arr)
+    {
+        auto kernel = r.find("kernel"), mesh = r.find("mesh"), threads = r.find("threads");
+        auto cells = r.find("cells"), median = r.find("median"), mad = r.find("mad");
+        if (!kernel || !mesh || !threads || !cells || !median || !mad ||
+            kernel->type != JsonValue::Type::String || mesh->type != JsonValue::Type::String ||
+            threads->type != JsonValue::Type::Number || cells->type != JsonValue::Type::Number ||
+            median->type != JsonValue::Type::Number || mad->type != JsonValue::Type::Number)
+            throw invalid_file_format(fn, "incomplete result entry.");
+        if (!(median->num > 0.0) || !std::isfinite(median->num) || !(mad->num >= 0.0) || !std::isfinite(mad->num))
+            throw invalid_file_format(fn, "invalid timing of \"" + kernel->str + "\" on \"" + mesh->str + "\", median must be positive and MAD non-negative.");
+
+        const Key key(kernel->str, mesh->str, static_cast<size_t>(threads->num));
+        if (!dst.emplace(key, Entry{static_cast<size_t>(cells->num), median->num, mad->num}).second)
+            throw invalid_file_format(fn, "duplicated result of \"" + kernel->str + "\" on \"" + mesh->str + "\".");
+    }
+}
+
+static void usage()
+{
+    std::cout << "Usage: BENCHMARK-COMPARE --baseline <json> --current <json> [--budget <r>] [--sigma <k>] [--fail-on-missing]" << std::endl;
+    std::cout << "  Compare two result files of BENCHMARK, matched by kernel, mesh and thread count." << std::endl;
+    std::cout << "  A change is significant if the medians differ by more than k times their combined spread," << std::endl;
+    std::cout << "  estimated from the median absolute deviations (k=3 by default)." << std::endl;
+    std::cout << "  Significant slowdowns beyond the relative budget r (0.05 by default) are regressions," << std::endl;
+    std::cout << "  significant speedups beyond it are improvements." << std::endl;
+    std::cout << "  Results on meshes of different sizes are not comparable and always fail." << std::endl;
+    std::cout << "  Exit status is 1 if any regression or mesh mismatch is found, or if results are missing with \"--fail-on-missing\"," << std::endl;
+    std::cout << "  and 2 if the comparison could not be made, e.g. for bad options or unreadable result files." << std::endl;
+}
+
+/// Exit status when nothing could be compared, distinct from a failed comparison.
+static const int EXIT_ERROR = 2;
+
+/**
+ * Compare the result files given on command line.
+ * @return Exit status, 0 if no regression is found.
+ */
+static int compare(int argc, char *argv[])
+{
+    std::string BASELINE_PATH, CURRENT_PATH;
+    double BUDGET = 0.05, SIGMA = 3.0;
+    bool FAIL_ON_MISSING = false;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--baseline"))
+        {
+            BASELINE_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--current"))
+        {
+            CURRENT_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--budget"))
+        {
+            char *pEnd;
+            BUDGET = std::strtod(argv[cnt + 1], &pEnd);
+            if (!(BUDGET >= 0.0))
+                throw std::invalid_argument("Budget must be non-negative.");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--sigma"))
+        {
+            char *pEnd;
+            SIGMA = std::strtod(argv[cnt + 1], &pEnd);
+            if (!(SIGMA >= 0.0))
+                throw std::invalid_argument("Sigma must be non-negative.");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--fail-on-missing"))
+        {
+            FAIL_ON_MISSING = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--help"))
+        {
+            usage();
+            return 0;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (BASELINE_PATH.empty() || CURRENT_PATH.empty())
+    {
+        usage();
+        return EXIT_ERROR;
+    }
+
+    std::map<Key, Entry> baseline, current;
+    load_results(BASELINE_PATH, baseline);
+    load_results(CURRENT_PATH, current);
+
+    /// Scale factor turning MAD into a standard deviation for normally distributed noise
+    static const double MAD_TO_SIGMA = 1.4826;
+
+    size_t n_regression = 0, n_improvement = 0, n_missing = 0, n_mismatch = 0;
+    std::cout << std::left << std::setw(28) << "kernel" << std::setw(24) << "mesh" << std::right << std::setw(8) << "threads";
+    std::cout << std::setw(14) << "baseline(s)" << std::setw(14) << "current(s)" << std::setw(10) << "change" << std::setw(10) << "noise" << "  verdict" << std::endl;
+    for (const auto &e : baseline)
+    {
+        const auto &kernel = std::get<0>(e.first);
+        const auto &mesh = std::get<1>(e.first);
+        const auto threads = std::get<2>(e.first);
+        const Entry &b = e.second;
+
+        std::cout << std::left << std::setw(28) << kernel << std::setw(24) << mesh << std::right << std::setw(8) << threads;
+        std::cout << std::scientific << std::setprecision(4) << std::setw(14) << b.median;
+
+        auto it = current.find(e.first);
+        if (it == current.end())
+        {
+            ++n_missing;
+            std::cout << std::setw(14) << "-" << std::setw(10) << "-" << std::setw(10) << "-" << "  missing" << std::defaultfloat << std::endl;
+            continue;
+        }
+        const Entry &c = it->second;
+
+        const double change = c.median / b.median - 1.0;
+        const double noise = SIGMA * MAD_TO_SIGMA * std::hypot(b.mad, c.mad) / b.median;
+        const bool significant = std::abs(change) > noise;
+
+        std::string verdict = "unchanged";
+        if (b.cells != c.cells)
+        {
+            verdict = "MESH DIFFERS";
+            ++n_mismatch;
+        }
+        else if (significant && change > BUDGET)
+        {
+            verdict = "REGRESSION";
+            ++n_regression;
+        }
+        else if (significant && change < -BUDGET)
+        {
+            verdict = "improvement";
+            ++n_improvement;
+        }
+        else if (significant)
+            verdict = "within budget";
+
+        std::cout << std::setw(14) << c.median << std::fixed << std::setprecision(1);
+        std::cout << std::setw(9) << 100.0 * change << "%" << std::setw(9) << 100.0 * noise << "%";
+        std::cout << "  " << verdict << std::defaultfloat << std::endl;
+    }
+    for (const auto &e : current)
+        if (baseline.find(e.first) == baseline.end())
+        {
+            std::cout << std::left << std::setw(28) << std::get<0>(e.first) << std::setw(24) << std::get<1>(e.first) << std::right << std::setw(8) << std::get<2>(e.first);
+            std::cout << std::setw(14) << "-" << std::scientific << std::setprecision(4) << std::setw(14) << e.second.median;
+            std::cout << std::setw(10) << "-" << std::setw(10) << "-" << "  new" << std::defaultfloat << std::endl;
+        }
+
+    std::cout << "\n" << n_regression << " regression(s), " << n_improvement << " improvement(s), " << n_missing << " missing, " << n_mismatch << " mesh mismatch(es)" << std::endl;
+    if (n_regression > 0 || n_mismatch > 0 || (FAIL_ON_MISSING && n_missing > 0))
+        return 1;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return compare(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_ERROR;
+    }
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cstring>
+#include <iomanip>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/binmesh.h"
+#include "../inc/reduction.h"
+#include "../inc/misc.h"
+
+std::vector<Patch *> patch;
+std::vector<Node *> node;
+std::vector<Face *> face;
+std::vector<Cell *> cell;
+
+static void usage()
+{
+    std::cout << "Usage: MESH-CONVERT --mesh <input> --output <output> [--minimal]" << std::endl;
+    std::cout << "  Convert a mesh in any supported format into the binary format." << std::endl;
+    std::cout << "  With \"--minimal\", only coordinates, face connectivity and patches are stored." << std::endl;
+    std::cout << "  Entity counts, patches and total volume of the input are reported." << std::endl;
+}
+
+/**
+ * Entity counts, faces of each patch and total volume, so that meshes from different sources can be compared.
+ */
+static void summary()
+{
+    const FLM_SCALAR volume = reduce_sum(cell.size(), [](size_t i) { return cell[i]->volume; }, FLM_REDUCTION::Compensated);
+    std::cout << "  " << node.size() << " nodes, " << face.size() << " faces, " << cell.size() << " cells, volume ";
+    std::cout << std::setprecision(12) << volume << std::endl;
+    for (auto p : patch)
+        std::cout << "  Patch \"" << p->name << "\": " << p->surface.size() << " faces" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string MESH_PATH, OUTPUT_PATH;
+    bool minimal = false;
+    std::chrono::steady_clock::time_point tick_begin, tick_end;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--mesh"))
+        {
+            MESH_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--output"))
+        {
+            OUTPUT_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--minimal"))
+        {
+            minimal = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--help"))
+        {
+            usage();
+            return 0;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (MESH_PATH.empty() || OUTPUT_PATH.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    std::cout << "Loading mesh from \"" << MESH_PATH << "\" ... ";
+    {
+        tick_begin = std::chrono::steady_clock::now();
+        load_mesh(MESH_PATH);
+        tick_end = std::chrono::steady_clock::now();
+    }
+    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+    summary();
+
+    std::cout << "Writing binary mesh to \"" << OUTPUT_PATH << "\" ... ";
+    {
+        tick_begin = std::chrono::steady_clock::now();
+        if (minimal)
+            write_mesh_minimal(OUTPUT_PATH);
+        else
+            write_mesh_binary(OUTPUT_PATH);
+        tick_end = std::chrono::steady_clock::now();
+    }
+    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+
+    return 0;
+}
@@ -3,8 +3,12 @@
 #include <cstdlib>
 #include <regex>
 #include <filesystem>
+#include <memory>
+#include <sstream>
+#include <iomanip>
 #include "../inc/element.h"
 #include "../inc/io.h"
+#include "../inc/meshgen.h"
 #include "../inc/geom.h"
 #include "../inc/bc.h"
 #include "../inc/ic.h"
@@ -13,6 +17,18 @@
 #include "../inc/temporal.h"
 #include "../inc/diagnose.h"
 #include "../inc/misc.h"
+#include "../inc/snapshot.h"
+#include "../inc/writer.h"
+#include "../inc/series.h"
+#include "../inc/vtk.h"
+#include "../inc/geomcache.h"
+#include "../inc/locator.h"
+#include "../inc/monitor.h"
+#include "../inc/transfer.h"
+#include "../inc/roofline.h"
+#include "../inc/alloctrack.h"
+#include "../inc/telemetry.h"
+#include "../inc/profile.h"
 
 std::vector<Patch *> patch;
 std::vector<Node *> node;
@@ -27,6 +43,89 @@ static size_t iter = 0;
 static FLM_SCALAR t = 0.0; /// s
 FLM_SCALAR dt = 1e-4; /// s
 
+/// Solution output
+static bool BINARY_OUTPUT = true;
+static size_t OUTPUT_QUEUE = 2; /// 0 for synchronous output
+static FLM_CODEC OUTPUT_CODEC = FLM_CODEC::Raw;
+static FLM_SCALAR OUTPUT_TOL = 0.0; /// Error bound of lossy output
+static bool SERIES_OUTPUT = true; /// One container per run instead of one file per record
+static std::unique_ptr<SeriesWriter> series;
+static bool VTK_OUTPUT = false; /// Visualization files along with each record
+
+/// Monitors
+static std::string MONITOR_CONFIG;
+static bool MONITOR_BINARY = false;
+
+/// Machine-readable progress, see "Telemetry"
+static std::string TELEMETRY_PATH;
+static size_t TELEMETRY_GAP = 1;
+static bool QUIET = false; /// No per-iteration console output
+
+/// Geometry cache
+static bool GEOM_CACHE = true;
+static std::string GEOM_CACHE_DIR; /// Directory of the mesh if empty
+
+/// Wall time of each stage and kernel, reported at exit
+static bool PROFILE = false;
+static bool PERF_COUNTERS = false; /// Hardware events along with wall time
+static bool ROOFLINE = false; /// Achieved bandwidth and flop rate against a STREAM probe
+
+/// Timeline of each thread, dumped at exit or on SIGUSR1
+static bool TRACE = false;
+static size_t TRACE_BUFFER = 1 << 16; /// Events kept per thread
+
+/// Fail if any step after the first allocates, needs a build with FLM_ALLOC_TRACKING.
+/// Files created per record, by synchronous output to separate files and by VTK output, are exempt.
+/// On a single thread libgomp allocates a team per parallel region, so check with 2 or more.
+static bool ALLOC_CHECK = false;
+
+static Snapshot solution;
+
+/**
+ * Encode a solution in the selected format.
+ * Separate files are named after the prefix and the iteration, a container needs no name.
+ * @param dir Output directory.
+ * @param prefix Leading part of file names.
+ * @param src The solution.
+ */
+static void write_solution(const std::filesystem::path &dir, const std::string &prefix, const Snapshot &src)
+{
+    if (series)
+    {
+        series->append(src, OUTPUT_CODEC, OUTPUT_TOL);
+        return;
+    }
+
+    auto path = dir / (prefix + std::to_string(src.iter));
+    if (BINARY_OUTPUT)
+    {
+        path += ".dat";
+        write_snapshot(path.string(), src, OUTPUT_CODEC, OUTPUT_TOL);
+    }
+    else
+    {
+        path += ".txt";
+        std::ofstream dts(path);
+        if (dts.fail())
+            throw failed_to_open_file(path.filename());
+        write_data(dts, src);
+    }
+}
+
+/**
+ * Run "f" and add its heap allocations to "acc", so that they are left out of "ALLOC_CHECK".
+ */
+template <typename F>
+static void alloc_exempt(AllocSample &acc, F &&f)
+{
+    AllocSample a, b;
+    alloc_read_all(a);
+    f();
+    alloc_read_all(b);
+    acc.count += b.count - a.count;
+    acc.bytes += b.bytes - a.bytes;
+}
+
 static void banner()
 {
     std::cout << "================================================================================" << std::endl;
@@ -39,9 +138,10 @@ static void banner()
 int main(int argc, char *argv[])
 {
     std::string MESH_PATH, DATA_PATH, RUN_TAG;
+    std::string INIT_MESH_PATH, INIT_DATA_PATH; /// Solution on another mesh as I.C.
     std::string OUTPUT_PREFIX = "ITER";
     bool resume_mode = false;
-    clock_t tick_begin, tick_end;
+    std::chrono::steady_clock::time_point tick_begin, tick_end;
 
     banner();
 
@@ -60,6 +160,16 @@ int main(int argc, char *argv[])
             DATA_PATH = argv[cnt + 1];
             cnt += 2;
         }
+        else if (!std::strcmp(argv[cnt], "--init-from-mesh"))
+        {
+            INIT_MESH_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--init-from-data"))
+        {
+            INIT_DATA_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
         else if (!std::strcmp(argv[cnt], "--tag"))
         {
             RUN_TAG = argv[cnt + 1];
@@ -105,6 +215,137 @@ int main(int argc, char *argv[])
             std::cout << "V2.0.0" << std::endl;
             return 0;
         }
+        else if (!std::strcmp(argv[cnt], "--output-format"))
+        {
+            const std::string fmt = argv[cnt + 1];
+            if (fmt == "bin")
+                BINARY_OUTPUT = true;
+            else if (fmt == "txt")
+                BINARY_OUTPUT = false;
+            else
+                throw std::invalid_argument("Unrecognized output format: \"" + fmt + "\".");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--output-layout"))
+        {
+            const std::string layout = argv[cnt + 1];
+            if (layout == "series")
+                SERIES_OUTPUT = true;
+            else if (layout == "files")
+                SERIES_OUTPUT = false;
+            else
+                throw std::invalid_argument("Unrecognized output layout: \"" + layout + "\".");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--monitor"))
+        {
+            MONITOR_CONFIG = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--monitor-format"))
+        {
+            const std::string fmt = argv[cnt + 1];
+            if (fmt == "bin")
+                MONITOR_BINARY = true;
+            else if (fmt == "csv")
+                MONITOR_BINARY = false;
+            else
+                throw std::invalid_argument("Unrecognized monitor format: \"" + fmt + "\".");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--telemetry"))
+        {
+            TELEMETRY_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--telemetry-interval"))
+        {
+            char *pEnd;
+            TELEMETRY_GAP = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            if (TELEMETRY_GAP == 0)
+                throw std::invalid_argument("Telemetry interval should be positive.");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--quiet"))
+        {
+            QUIET = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--geom-cache"))
+        {
+            GEOM_CACHE_DIR = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--no-geom-cache"))
+        {
+            GEOM_CACHE = false;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--vtk"))
+        {
+            VTK_OUTPUT = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--compress"))
+        {
+            const std::string mode = argv[cnt + 1];
+            if (mode == "none")
+                OUTPUT_CODEC = FLM_CODEC::Raw;
+            else if (mode == "lossless")
+                OUTPUT_CODEC = FLM_CODEC::Xor;
+            else if (mode.compare(0, 6, "lossy:") == 0)
+            {
+                char *pEnd;
+                OUTPUT_CODEC = FLM_CODEC::Quantized;
+                OUTPUT_TOL = std::strtod(mode.c_str() + 6, &pEnd);
+                if (*pEnd != '\0' || !(OUTPUT_TOL > 0.0))
+                    throw std::invalid_argument("Invalid error bound: \"" + mode + "\".");
+            }
+            else
+                throw std::invalid_argument("Unrecognized compression mode: \"" + mode + "\".");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--output-queue"))
+        {
+            char *pEnd;
+            OUTPUT_QUEUE = std::strtol(argv[cnt + 1], &pEnd, 10);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--profile"))
+        {
+            PROFILE = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--perf-counters"))
+        {
+            PROFILE = true;
+            PERF_COUNTERS = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--roofline"))
+        {
+            PROFILE = true;
+            ROOFLINE = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--trace"))
+        {
+            TRACE = true;
+            cnt += 1;
+        }
+        else if (!std::strcmp(argv[cnt], "--trace-buffer"))
+        {
+            char *pEnd;
+            TRACE_BUFFER = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--alloc-check"))
+        {
+            if (!alloc_tracking())
+                throw std::invalid_argument("Option \"--alloc-check\" needs a build with FLM_ALLOC_TRACKING.");
+            ALLOC_CHECK = true;
+            cnt += 1;
+        }
         else if (!std::strcmp(argv[cnt], "--output-prefix"))
         {
             OUTPUT_PREFIX = argv[cnt + 1];
@@ -113,6 +354,34 @@ int main(int argc, char *argv[])
         else
             throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
     }
+    if (INIT_MESH_PATH.empty() != INIT_DATA_PATH.empty())
+        throw std::invalid_argument("Options \"--init-from-mesh\" and \"--init-from-data\" go together.");
+    if (!INIT_MESH_PATH.empty() && (!DATA_PATH.empty() || resume_mode))
+        throw std::invalid_argument("Interpolated I.C. conflicts with \"--data\" and \"--resume-from\".");
+    if (OUTPUT_CODEC != FLM_CODEC::Raw && !BINARY_OUTPUT)
+        throw std::invalid_argument("Compression is only available for binary output.");
+    if (!BINARY_OUTPUT)
+        SERIES_OUTPUT = false; /// Text output always goes to separate files
+    if (is_mesh_spec(MESH_PATH))
+        GEOM_CACHE = false; /// A generated mesh has no file to sit next to, and is cheap to rebuild
+
+    profile_enable(PROFILE);
+    if (PERF_COUNTERS)
+    {
+        std::string why;
+        if (!profile_counters(why))
+            std::cout << "\nWarning: hardware counters unavailable (" << why << "), reporting wall time only." << std::endl;
+    }
+    if (ROOFLINE)
+    {
+        std::cout << "\nProbing memory bandwidth ..." << std::endl;
+        const double bw = stream_bandwidth();
+        profile_roofline(bw);
+        std::cout << "Done: " << std::fixed << std::setprecision(2) << bw / 1e9 << " GB/s" << std::defaultfloat << std::endl;
+    }
+    if (TRACE)
+        trace_enable(TRACE_BUFFER);
+    profile_thread_name("solver");
 
     std::cout << "\nOutput directory set to: ";
     {
@@ -124,10 +393,18 @@ int main(int argc, char *argv[])
     }
     std::cout << "\"" << RUN_TAG << "\"" << std::endl;
 
-    if (resume_mode)
+    const std::filesystem::path OUTPUT_DIR(RUN_TAG);
+    const std::string TRACE_PATH = (std::filesystem::path(RUN_TAG) / "trace.json").string();
+    const std::string SERIES_PATH = (std::filesystem::path(RUN_TAG) / (OUTPUT_PREFIX + ".series")).string();
+    SeriesEntry latest_record;
+    if (resume_mode && series_latest(SERIES_PATH, latest_record))
+        DATA_PATH = SERIES_PATH;
+    else if (resume_mode)
     {
         size_t latest = 0;
-        const std::regex data_file("([a-zA-Z]*)(\\d+)\\.dat");
+        std::string data_name = OUTPUT_PREFIX + "0.dat";
+        bool found = false;
+        const std::regex data_file("([a-zA-Z]*)(\\d+)\\.(dat|txt)");
         for (auto &it : std::filesystem::directory_iterator(RUN_TAG))
         {
             std::string s = it.path().filename().string();
@@ -140,13 +417,16 @@ int main(int argc, char *argv[])
                     std::string idx = sm[2];
                     char *pEnd;
                     size_t idx10 = std::strtol(idx.c_str(), &pEnd, 10);
-                    if (idx10 > latest)
+                    if (!found || idx10 > latest)
+                    {
                         latest = idx10;
+                        data_name = s;
+                        found = true;
+                    }
                 }
             }
         }
         auto output_dir = std::filesystem::path(RUN_TAG);
-        std::string data_name = OUTPUT_PREFIX + std::to_string(latest) + ".dat";
         auto p_data = output_dir.append(data_name);
         DATA_PATH = p_data.string();
     }
@@ -160,127 +440,277 @@ int main(int argc, char *argv[])
     /// Init
     std::cout << "\nLoading mesh from \"" << MESH_PATH << "\" ... ";
     {
-        std::ifstream in(MESH_PATH);
-        if (in.fail())
-            throw failed_to_open_file(MESH_PATH);
-        tick_begin = clock();
-        read_mesh(in);
-        tick_end = clock();
-        in.close();
+        tick_begin = std::chrono::steady_clock::now();
+        load_mesh(MESH_PATH);
+        tick_end = std::chrono::steady_clock::now();
     }
     std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
 
-    std::cout << "\nPreparing geometric quantities ... ";
-    {
-        tick_begin = clock();
-        calculate_geometric_value();
-        tick_end = clock();
-    }
-    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
-
-    std::cout << "\nCalculating skewness factor on each face ... " << std::endl;
-    check_skewness();
+    solution.mesh = mesh_hash();
+    if (SERIES_OUTPUT)
+        series = std::make_unique<SeriesWriter>(SERIES_PATH, solution.mesh, resume_mode);
 
+    /// B.C. types are part of the key of the geometry cache
     std::cout << "\nSetting B.C. for each patch ... ";
     {
+        FLM_PROFILE("set_bc");
         set_bc_desc();
         set_bc_val();
     }
     std::cout << "Done!" << std::endl;
 
-    std::cout << "\nPreparing Least-Square coefficients ... ";
+    std::string GEOM_CACHE_PATH;
+    bool geom_cached = false;
+    const uint64_t geom_key = geometry_key(solution.mesh);
+    if (GEOM_CACHE)
     {
-        tick_begin = clock();
-        prepare_lsq();
-        tick_end = clock();
+        std::filesystem::path p_mesh(MESH_PATH);
+        std::filesystem::path p_cache = GEOM_CACHE_DIR.empty() ? p_mesh.parent_path() : std::filesystem::path(GEOM_CACHE_DIR);
+        std::ostringstream name;
+        name << p_mesh.filename().string() << "." << std::hex << std::setw(16) << std::setfill('0') << geom_key << ".geom";
+        GEOM_CACHE_PATH = (p_cache / name.str()).string();
+
+        std::cout << "\nLooking up geometry cache \"" << GEOM_CACHE_PATH << "\" ... ";
+        tick_begin = std::chrono::steady_clock::now();
+        geom_cached = load_geometry_cache(GEOM_CACHE_PATH, geom_key);
+        tick_end = std::chrono::steady_clock::now();
+        if (geom_cached)
+            std::cout << "loaded in " << duration(tick_begin, tick_end) << "s" << std::endl;
+        else
+            std::cout << "not found" << std::endl;
+    }
+
+    if (geom_cached)
+    {
+        std::cout << "\nSkewness factor on each face:" << std::endl;
+        report_skewness();
+    }
+    else
+    {
+        std::cout << "\nPreparing geometric quantities ... ";
+        {
+            tick_begin = std::chrono::steady_clock::now();
+            calculate_geometric_value();
+            tick_end = std::chrono::steady_clock::now();
+        }
+        std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+
+        std::cout << "\nCalculating skewness factor on each face ... " << std::endl;
+        check_skewness();
+
+        std::cout << "\nPreparing Least-Square coefficients ... ";
+        {
+            tick_begin = std::chrono::steady_clock::now();
+            prepare_lsq();
+            tick_end = std::chrono::steady_clock::now();
+        }
+        std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+
+        if (GEOM_CACHE)
+        {
+            /// A missing cache only costs time, so failing to write one is not fatal
+            try
+            {
+                save_geometry_cache(GEOM_CACHE_PATH, geom_key);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "\nWarning: geometry cache not saved: " << e.what() << std::endl;
+            }
+        }
     }
-    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
 
     std::cout << "\nPreparing Poisson equation coefficients ... ";
     {
-        tick_begin = clock();
+        FLM_PROFILE("prepare_poisson");
+        tick_begin = std::chrono::steady_clock::now();
         /// TODO
-        tick_end = clock();
+        tick_end = std::chrono::steady_clock::now();
     }
     std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
 
+    std::cout << "\nBuilding spatial index ... ";
+    tick_begin = std::chrono::steady_clock::now();
+    const CellLocator locator(cell);
+    tick_end = std::chrono::steady_clock::now();
+    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+
+    std::unique_ptr<VtuSeries> vtk;
+    if (VTK_OUTPUT)
+    {
+        std::cout << "\nEncoding topology for visualization ... ";
+        tick_begin = std::chrono::steady_clock::now();
+        vtk = std::make_unique<VtuSeries>(RUN_TAG, OUTPUT_PREFIX, resume_mode);
+        tick_end = std::chrono::steady_clock::now();
+        std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+    }
+
     if (DATA_PATH.empty())
     {
-        std::cout << "\nSetting I.C. ... ";
+        if (INIT_MESH_PATH.empty())
         {
-            tick_begin = clock();
+            FLM_PROFILE("initial_condition");
+            std::cout << "\nSetting I.C. ... ";
+            tick_begin = std::chrono::steady_clock::now();
             zero_init();
             interpolate_nodal_value();
-            tick_end = clock();
+            tick_end = std::chrono::steady_clock::now();
+        }
+        else
+        {
+            FLM_PROFILE("initial_condition");
+            std::cout << "\nSetting I.C. from \"" + INIT_DATA_PATH + "\" on \"" + INIT_MESH_PATH + "\" ... ";
+            tick_begin = std::chrono::steady_clock::now();
+            transfer_solution(INIT_MESH_PATH, INIT_DATA_PATH);
+            interpolate_nodal_value();
+            tick_end = std::chrono::steady_clock::now();
         }
         std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
 
         std::cout << "\nWriting initial output ... ";
         {
-            std::filesystem::path p_output(RUN_TAG);
-            p_output.append(OUTPUT_PREFIX + "0.txt");
-            std::ofstream dts(p_output);
-            if (dts.fail())
-                throw failed_to_open_file(p_output.filename());
-            tick_begin = clock();
-            write_data(dts, 0, 0.0);
-            tick_end = clock();
-            dts.close();
+            FLM_PROFILE("output");
+            tick_begin = std::chrono::steady_clock::now();
+            gather_snapshot(solution, 0, 0.0);
+            write_solution(OUTPUT_DIR, OUTPUT_PREFIX, solution);
+            if (vtk)
+                vtk->write(0, 0.0);
+            tick_end = std::chrono::steady_clock::now();
         }
         std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
     }
     else
     {
         std::cout << "\nSetting I.C. from \"" + DATA_PATH + "\" ... ";
-        std::ifstream dts(DATA_PATH);
-        if (dts.fail())
-            throw failed_to_open_file(DATA_PATH);
-        tick_begin = clock();
-        read_data(dts, iter, t);
-        tick_end = clock();
-        dts.close();
+        tick_begin = std::chrono::steady_clock::now();
+        load_data(DATA_PATH, iter, t);
+        tick_end = std::chrono::steady_clock::now();
+        std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+    }
+
+    std::unique_ptr<Monitor> monitor;
+    if (!MONITOR_CONFIG.empty())
+    {
+        const std::filesystem::path p_monitor = std::filesystem::path(RUN_TAG) / (MONITOR_BINARY ? "monitor.bin" : "monitor.csv");
+        FLM_PROFILE("Monitor::setup");
+        std::cout << "\nSetting up monitors from \"" << MONITOR_CONFIG << "\" ... ";
+        tick_begin = std::chrono::steady_clock::now();
+        monitor = std::make_unique<Monitor>(MONITOR_CONFIG, p_monitor.string(), resume_mode, locator);
+        if (!resume_mode)
+            monitor->record(iter, t);
+        tick_end = std::chrono::steady_clock::now();
         std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
     }
 
+    /// Output during time-stepping
+    std::unique_ptr<AsyncWriter> writer;
+    if (OUTPUT_QUEUE > 0)
+    {
+        writer = std::make_unique<AsyncWriter>(OUTPUT_QUEUE, solution.mesh, [OUTPUT_DIR, OUTPUT_PREFIX](const Snapshot &src) {
+            write_solution(OUTPUT_DIR, OUTPUT_PREFIX, src);
+        });
+    }
+
+    std::unique_ptr<Telemetry> telemetry;
+    if (!TELEMETRY_PATH.empty())
+    {
+        telemetry = std::make_unique<Telemetry>(TELEMETRY_PATH, resume_mode);
+        std::cout << "\nTelemetry every " << TELEMETRY_GAP << " iteration to \"" << TELEMETRY_PATH << "\"" << std::endl;
+    }
+    if (ALLOC_CHECK)
+        std::cout << "\nChecking heap allocations of every iteration after the first, except files created per record by synchronous or VTK output" << std::endl;
+
     /// Solve
     std::cout << "\nStarting calculation ... " << std::endl;
+    const size_t first_iter = iter + 1;
     while (iter <= MAX_ITER && t <= MAX_TIME)
     {
+        FLM_PROFILE("iteration");
+        AllocSample alloc_begin, alloc_skip = {0, 0};
+        alloc_read_all(alloc_begin);
         ++iter;
         t += dt;
 
         /// Time-Stepping
-        std::cout << "\nIter" << iter << ": " << "t=" << t << "s, dt=" << dt << "s" << std::endl;
+        FLM_STAGE_TIME wall = {0.0, 0.0, 0.0};
+        if (!QUIET)
+            std::cout << "\nIter" << iter << ": " << "t=" << t << "s, dt=" << dt << "s\n";
         {
-            tick_begin = clock();
+            tick_begin = std::chrono::steady_clock::now();
             ForwardEuler(dt);
-            tick_end = clock();
+            tick_end = std::chrono::steady_clock::now();
         }
-        std::cout << duration(tick_begin, tick_end) << "s CPU time" << std::endl;
+        wall.step = duration(tick_begin, tick_end);
+        if (!QUIET)
+            std::cout << wall.step << "s\n";
 
         /// Check
+        tick_begin = std::chrono::steady_clock::now();
         bool diverge_flag = false;
         diagnose(diverge_flag);
         if (diverge_flag)
         {
             /// TODO
         }
+        if (monitor)
+            monitor->record(iter, t);
+        tick_end = std::chrono::steady_clock::now();
+        wall.check = duration(tick_begin, tick_end);
 
         /// Output
         if (!(iter % OUTPUT_GAP))
         {
-            const std::string fn = OUTPUT_PREFIX + std::to_string(iter) + ".txt";
-            std::filesystem::path p_output(RUN_TAG);
-            p_output.append(fn);
-            std::ofstream dts(p_output);
-            if (dts.fail())
-                throw failed_to_open_file(p_output.filename());
-            write_data(dts, iter, t);
-            dts.close();
+            FLM_PROFILE("output");
+            tick_begin = std::chrono::steady_clock::now();
+            if (writer)
+                writer->submit(iter, t);
+            else
+            {
+                gather_snapshot(solution, iter, t);
+                if (series)
+                    write_solution(OUTPUT_DIR, OUTPUT_PREFIX, solution);
+                else
+                    alloc_exempt(alloc_skip, [&] { write_solution(OUTPUT_DIR, OUTPUT_PREFIX, solution); });
+            }
+            if (vtk)
+                alloc_exempt(alloc_skip, [&] { vtk->write(iter, t); });
+            if (monitor)
+                monitor->flush();
+            tick_end = std::chrono::steady_clock::now();
+            wall.output = duration(tick_begin, tick_end);
+        }
+
+        if (telemetry && !(iter % TELEMETRY_GAP))
+            telemetry->record(iter, t, dt, wall);
+
+        if (TRACE && trace_requested())
+        {
+            trace_dump(TRACE_PATH);
+            std::cout << "Trace written to \"" << TRACE_PATH << "\"" << std::endl;
+        }
+
+        /// Storage is sized by the first step, later steps must reuse it
+        if (ALLOC_CHECK && iter > first_iter)
+        {
+            AllocSample alloc_end;
+            alloc_read_all(alloc_end);
+            const uint64_t n_alloc = alloc_end.count - alloc_begin.count - alloc_skip.count;
+            if (n_alloc != 0)
+                throw std::runtime_error("Iteration " + std::to_string(iter) + " made " + std::to_string(n_alloc) + " heap allocations (" + std::to_string(alloc_end.bytes - alloc_begin.bytes - alloc_skip.bytes) + " bytes).");
         }
     }
 
     /// Finalize
+    if (writer)
+    {
+        FLM_PROFILE("AsyncWriter::flush");
+        std::cout << "\nWaiting for pending output ... " << std::endl;
+        writer->flush();
+        writer.reset();
+    }
+    series.reset();
+    telemetry.reset();
+
     std::cout << "\nReleasing Memory ... " << std::endl;
     {
         for (auto e : node)
@@ -292,6 +722,16 @@ int main(int argc, char *argv[])
         for (auto e : patch)
             delete e;
     }
+    if (TRACE)
+    {
+        trace_dump(TRACE_PATH);
+        std::cout << "\nTrace written to \"" << TRACE_PATH << "\"" << std::endl;
+    }
+    if (PROFILE)
+    {
+        std::cout << "\nProfile:" << std::endl;
+        profile_report(std::cout, cell.size());
+    }
     std::cout << "\nFinished!" << std::endl;
 
     return 0;
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/binmesh.h"
+#include "../inc/meshgen.h"
+#include "../inc/misc.h"
+
+std::vector<Patch *> patch;
+std::vector<Node *> node;
+std::vector<Face *> face;
+std::vector<Cell *> cell;
+
+static void usage()
+{
+    std::cout << "Usage: MESHGEN --shape <hex|tet|prism|pyramid> --blocks <nx> <ny> <nz> --output <output>" << std::endl;
+    std::cout << "               [--perturbation <p>] [--seed <s>] [--format <text|binary|minimal>]" << std::endl;
+    std::cout << "  Generate a mesh of the unit box, with cells of one shape in each of nx*ny*nz blocks." << std::endl;
+    std::cout << "  Interior nodes are moved randomly by up to p times the spacing, with p in [0, 0.5)." << std::endl;
+    std::cout << "  The same mesh can be built in memory by any solver with \"--mesh gen:<shape>:<nx>x<ny>x<nz>[:<p>[:<s>]]\"." << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string SHAPE = "hex", OUTPUT_PATH, FORMAT = "binary";
+    size_t NX = 0, NY = 0, NZ = 0;
+    std::string PERTURBATION = "0", SEED = "0";
+    std::chrono::steady_clock::time_point tick_begin, tick_end;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--shape"))
+        {
+            SHAPE = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--blocks"))
+        {
+            char *pEnd;
+            NX = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            NY = std::strtoul(argv[cnt + 2], &pEnd, 10);
+            NZ = std::strtoul(argv[cnt + 3], &pEnd, 10);
+            cnt += 4;
+        }
+        else if (!std::strcmp(argv[cnt], "--perturbation"))
+        {
+            PERTURBATION = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--seed"))
+        {
+            SEED = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--output"))
+        {
+            OUTPUT_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--format"))
+        {
+            FORMAT = argv[cnt + 1];
+            if (FORMAT != "text" && FORMAT != "binary" && FORMAT != "minimal")
+                throw std::invalid_argument("Unrecognized mesh format: \"" + FORMAT + "\".");
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--help"))
+        {
+            usage();
+            return 0;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (NX == 0 || NY == 0 || NZ == 0 || OUTPUT_PATH.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    FLM_MESH_SPEC spec;
+    const std::string SPEC = "gen:" + SHAPE + ":" + std::to_string(NX) + "x" + std::to_string(NY) + "x" + std::to_string(NZ) + ":" + PERTURBATION + ":" + SEED;
+    parse_mesh_spec(SPEC, spec);
+
+    std::cout << "Generating \"" << SPEC << "\" ... ";
+    {
+        tick_begin = std::chrono::steady_clock::now();
+        generate_mesh(spec);
+        tick_end = std::chrono::steady_clock::now();
+    }
+    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+    std::cout << "  " << node.size() << " nodes, " << face.size() << " faces, " << cell.size() << " cells" << std::endl;
+
+    std::cout << "Writing " << FORMAT << " mesh to \"" << OUTPUT_PATH << "\" ... ";
+    {
+        tick_begin = std::chrono::steady_clock::now();
+        if (FORMAT == "text")
+        {
+            std::ofstream fout(OUTPUT_PATH);
+            if (fout.fail())
+                throw failed_to_open_file(OUTPUT_PATH);
+            write_mesh(fout);
+        }
+        else if (FORMAT == "minimal")
+            write_mesh_minimal(OUTPUT_PATH);
+        else
+            write_mesh_binary(OUTPUT_PATH);
+        tick_end = std::chrono::steady_clock::now();
+    }
+    std::cout << duration(tick_begin, tick_end) << "s" << std::endl;
+
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+
+    return 0;
+}
@@ -0,0 +1,489 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/geom.h"
+#include "../inc/gradient.h"
+#include "../inc/spatial.h"
+#include "../inc/poisson.h"
+#include "../inc/misc.h"
+
+std::vector<Patch *> patch;
+std::vector<Node *> node;
+std::vector<Face *> face;
+std::vector<Cell *> cell;
+
+static const FLM_SCALAR PI = 3.14159265358979323846;
+
+/**
+ * Manufactured solution "T = sin(pi*x) * cos(pi*y) * exp(z)".
+ * Smooth, not aligned with any mesh direction, and of different scales along each axis.
+ */
+static FLM_SCALAR exact_T(const FLM_VECTOR &x)
+{
+    return std::sin(PI * x.x()) * std::cos(PI * x.y()) * std::exp(x.z());
+}
+
+static FLM_VECTOR exact_grad_T(const FLM_VECTOR &x)
+{
+    const FLM_SCALAR sx = std::sin(PI * x.x()), cx = std::cos(PI * x.x());
+    const FLM_SCALAR sy = std::sin(PI * x.y()), cy = std::cos(PI * x.y());
+    const FLM_SCALAR ez = std::exp(x.z());
+    return FLM_VECTOR(PI * cx * cy * ez, -PI * sx * sy * ez, sx * cy * ez);
+}
+
+/**
+ * Source term balancing the manufactured solution, "div(grad(T))".
+ */
+static FLM_SCALAR exact_source(const FLM_VECTOR &x)
+{
+    return (1.0 - 2.0 * PI * PI) * exact_T(x);
+}
+
+/**
+ * Linear field "T = 1 + 2x - 3y + z/2", which every consistent operator reproduces exactly.
+ */
+static const FLM_VECTOR LINEAR_GRAD_T(2.0, -3.0, 0.5);
+
+static FLM_SCALAR linear_T(const FLM_VECTOR &x)
+{
+    return 1.0 + LINEAR_GRAD_T.dot(x);
+}
+
+/// Errors relative to "|grad(T)|", and to "|grad(T)| / h" for the residual, accepted as round-off.
+static const FLM_SCALAR CONSISTENCY_TOLERANCE = 1e-9;
+
+/// Names of the options, in order of the enum values.
+static const char *GRADIENT_NAME[] = {"gg1", "gg2", "lsq"};
+static const char *NOC_NAME[] = {"minimum", "orthogonal", "over-relaxed"};
+
+/// Errors and costs of one configuration on one mesh.
+struct Case
+{
+    std::string shape;
+    std::string perturbation;
+    FLM_GRADIENT gradient;
+    FLM_NOC noc;
+    size_t size, cells;
+    FLM_SCALAR h;
+    FLM_SCALAR err_L2, err_Linf, err_grad_L2;
+    FLM_POISSON_STAT stat;
+    FLM_SCALAR t_setup, t_solve;
+    size_t rss;
+};
+
+static void usage()
+{
+    std::cout << "Usage: MMS [--shape <hex|tet|prism|pyramid> ...] [--size <n> ...] [--perturbation <p> ...]" << std::endl;
+    std::cout << "           [--gradient <gg1|gg2|lsq> ...] [--noc <minimum|orthogonal|over-relaxed> ...]" << std::endl;
+    std::cout << "           [--tolerance <tol>] [--max-correction <n>] [--target <e>] [--csv <path>] [--consistency]" << std::endl;
+    std::cout << "  Solve \"div(grad(T)) = f\" for the manufactured solution T = sin(pi*x)*cos(pi*y)*exp(z)" << std::endl;
+    std::cout << "  on generated meshes \"gen:<shape>:<n>:<p>\" of the unit box, with Dirichlet values on \"UP\" and \"DOWN\"" << std::endl;
+    std::cout << "  and exact surface normal gradients elsewhere." << std::endl;
+    std::cout << "  Defaults: hex and tet, n=4,8,16, p=0 and 0.2, all gradient schemes, over-relaxed decomposition." << std::endl;
+    std::cout << "  Every configuration reports error norms, observed order, correction steps, time and memory." << std::endl;
+    std::cout << "  With \"--target\", configurations are ranked by cost on the finest mesh among those with L2 error below e." << std::endl;
+    std::cout << "  With \"--consistency\", nothing is solved: cells and B.C. are set to a linear field instead, and" << std::endl;
+    std::cout << "  the largest errors of the cell gradient and of the steady residual are checked to vanish." << std::endl;
+    std::cout << "  Exit status is 1 if any configuration exceeds " << CONSISTENCY_TOLERANCE << " relative to the exact gradient." << std::endl;
+}
+
+static void release_mesh()
+{
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+    node.clear();
+    face.clear();
+    cell.clear();
+    patch.clear();
+}
+
+/**
+ * Dirichlet on "UP" and "DOWN", Neumann on the others, both taken from the manufactured solution.
+ */
+static void set_bc()
+{
+    for (auto p : patch)
+    {
+        p->BC = FLM_BC_PHY::Wall;
+        p->T = (p->name == "UP" || p->name == "DOWN") ? FLM_BC_MATH::Dirichlet : FLM_BC_MATH::Neumann;
+        for (auto f : p->surface)
+        {
+            const FLM_VECTOR n = f->c0 ? f->n01 : f->n10;
+            f->T = exact_T(f->centroid);
+            f->sn_grad_T = exact_grad_T(f->centroid).dot(n);
+        }
+    }
+}
+
+/**
+ * Solve with one configuration on the loaded mesh, starting from zero.
+ */
+static void run(Case &dst, FLM_SCALAR tol, size_t max_outer)
+{
+    std::chrono::steady_clock::time_point tick_begin, tick_end;
+    const size_t NumOfCell = cell.size();
+
+    tick_begin = std::chrono::steady_clock::now();
+    calculate_geometric_value(dst.noc);
+    if (dst.gradient == FLM_GRADIENT::LSQ)
+        prepare_lsq();
+    prepare_poisson();
+    tick_end = std::chrono::steady_clock::now();
+    dst.t_setup = duration(tick_begin, tick_end);
+
+    std::vector<FLM_SCALAR> source(NumOfCell);
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        source[i] = exact_source(cell[i]->centroid);
+        cell[i]->T = 0.0;
+    }
+
+    tick_begin = std::chrono::steady_clock::now();
+    solve_poisson(source, dst.gradient, tol, max_outer, dst.stat);
+    tick_end = std::chrono::steady_clock::now();
+    dst.t_solve = duration(tick_begin, tick_end);
+    dst.rss = resident_memory();
+
+    /// Volume-weighted norms of the error at cell centroids
+    FLM_SCALAR vol = 0.0, e2 = 0.0, g2 = 0.0;
+    dst.err_Linf = 0.0;
+    for (auto c : cell)
+    {
+        const FLM_SCALAR e = c->T - exact_T(c->centroid);
+        const FLM_SCALAR g = (c->grad_T - exact_grad_T(c->centroid)).norm();
+        vol += c->volume;
+        e2 += c->volume * e * e;
+        g2 += c->volume * g * g;
+        dst.err_Linf = std::max(dst.err_Linf, std::abs(e));
+    }
+    dst.cells = NumOfCell;
+    dst.h = std::cbrt(vol / NumOfCell);
+    dst.err_L2 = std::sqrt(e2 / vol);
+    dst.err_grad_L2 = std::sqrt(g2 / vol);
+}
+
+/**
+ * Evaluate the operators of the solver on the linear field over the loaded mesh, with B.C. as in "set_bc".
+ * Face and nodal values are interpolated twice, like a correction step, so that extrapolation
+ * onto Neumann faces sees a gradient already.
+ * @param gradient The gradient scheme.
+ * @param noc The decomposition of face normals.
+ * @param err_grad Largest error of the cell gradient, relative to the exact one.
+ * @param err_res Largest residual, relative to "|grad(T)| / h".
+ */
+static void consistency(FLM_GRADIENT gradient, FLM_NOC noc, FLM_SCALAR &err_grad, FLM_SCALAR &err_res)
+{
+    const size_t NumOfCell = cell.size();
+
+    for (auto p : patch)
+    {
+        p->BC = FLM_BC_PHY::Wall;
+        p->T = (p->name == "UP" || p->name == "DOWN") ? FLM_BC_MATH::Dirichlet : FLM_BC_MATH::Neumann;
+        for (auto f : p->surface)
+        {
+            const FLM_VECTOR n = f->c0 ? f->n01 : f->n10;
+            f->T = linear_T(f->centroid);
+            f->sn_grad_T = LINEAR_GRAD_T.dot(n);
+        }
+    }
+
+    calculate_geometric_value(noc);
+    if (gradient == FLM_GRADIENT::LSQ)
+        prepare_lsq();
+
+    FLM_SCALAR vol = 0.0;
+    for (auto c : cell)
+    {
+        c->T = linear_T(c->centroid);
+        c->grad_T.setZero();
+        vol += c->volume;
+    }
+
+    for (int k = 0; k < 2; ++k)
+    {
+        interpolate_face_value();
+        interpolate_nodal_value();
+        calculate_cell_gradient(gradient);
+    }
+    std::vector<FLM_SCALAR> R(NumOfCell);
+    calculate_residual(R);
+
+    const FLM_SCALAR h = std::cbrt(vol / NumOfCell);
+    err_grad = 0.0;
+    err_res = 0.0;
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        err_grad = std::max(err_grad, (cell[i]->grad_T - LINEAR_GRAD_T).norm());
+        err_res = std::max(err_res, std::abs(R[i]));
+    }
+    err_grad /= LINEAR_GRAD_T.norm();
+    err_res *= h / LINEAR_GRAD_T.norm();
+}
+
+static FLM_SCALAR order(FLM_SCALAR e_coarse, FLM_SCALAR e_fine, FLM_SCALAR h_coarse, FLM_SCALAR h_fine)
+{
+    return std::log(e_coarse / e_fine) / std::log(h_coarse / h_fine);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> SHAPE, PERTURBATION;
+    std::vector<size_t> SIZE;
+    std::vector<FLM_GRADIENT> GRADIENT;
+    std::vector<FLM_NOC> NOC;
+    FLM_SCALAR TOLERANCE = 1e-8, TARGET = 0.0;
+    size_t MAX_CORRECTION = 100;
+    std::string CSV_PATH;
+    bool CONSISTENCY = false;
+
+    /// Parse parameters
+    int cnt = 1;
+    while (cnt < argc)
+    {
+        if (!std::strcmp(argv[cnt], "--shape"))
+        {
+            SHAPE.emplace_back(argv[cnt + 1]);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--size"))
+        {
+            char *pEnd;
+            SIZE.push_back(std::strtoul(argv[cnt + 1], &pEnd, 10));
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--perturbation"))
+        {
+            PERTURBATION.emplace_back(argv[cnt + 1]);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--gradient"))
+        {
+            const auto it = std::find_if(std::begin(GRADIENT_NAME), std::end(GRADIENT_NAME), [&](const char *s) { return !std::strcmp(s, argv[cnt + 1]); });
+            if (it == std::end(GRADIENT_NAME))
+                throw std::invalid_argument("Unrecognized gradient scheme: \"" + std::string(argv[cnt + 1]) + "\".");
+            GRADIENT.push_back(static_cast<FLM_GRADIENT>(it - std::begin(GRADIENT_NAME)));
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--noc"))
+        {
+            const auto it = std::find_if(std::begin(NOC_NAME), std::end(NOC_NAME), [&](const char *s) { return !std::strcmp(s, argv[cnt + 1]); });
+            if (it == std::end(NOC_NAME))
+                throw std::invalid_argument("Unrecognized decomposition: \"" + std::string(argv[cnt + 1]) + "\".");
+            NOC.push_back(static_cast<FLM_NOC>(it - std::begin(NOC_NAME)));
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--tolerance"))
+        {
+            char *pEnd;
+            TOLERANCE = std::strtod(argv[cnt + 1], &pEnd);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--max-correction"))
+        {
+            char *pEnd;
+            MAX_CORRECTION = std::strtoul(argv[cnt + 1], &pEnd, 10);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--target"))
+        {
+            char *pEnd;
+            TARGET = std::strtod(argv[cnt + 1], &pEnd);
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--csv"))
+        {
+            CSV_PATH = argv[cnt + 1];
+            cnt += 2;
+        }
+        else if (!std::strcmp(argv[cnt], "--consistency"))
+        {
+            CONSISTENCY = true;
+            ++cnt;
+        }
+        else if (!std::strcmp(argv[cnt], "--help"))
+        {
+            usage();
+            return 0;
+        }
+        else
+            throw std::invalid_argument("Unrecognized option: \"" + std::string(argv[cnt]) + "\".");
+    }
+
+    if (SHAPE.empty())
+        SHAPE = {"hex", "tet"};
+    if (SIZE.empty())
+        SIZE = {4, 8, 16};
+    if (PERTURBATION.empty())
+        PERTURBATION = {"0", "0.2"};
+    if (GRADIENT.empty())
+        GRADIENT = {FLM_GRADIENT::GG1, FLM_GRADIENT::GG2, FLM_GRADIENT::LSQ};
+    if (NOC.empty())
+        NOC = {FLM_NOC::OverRelaxed};
+    std::sort(SIZE.begin(), SIZE.end());
+
+    /// Progress of the solver kernels is not of interest here
+    std::ostringstream discard;
+    auto console = std::cout.rdbuf();
+
+    if (CONSISTENCY)
+    {
+        bool pass = true;
+        std::cout << std::left << std::setw(28) << "mesh" << std::setw(6) << "grad" << std::setw(14) << "noc" << std::right;
+        std::cout << std::setw(9) << "cells" << std::setw(12) << "err(grad)" << std::setw(12) << "err(res)" << std::endl;
+        for (const auto &shape : SHAPE)
+            for (const auto &p : PERTURBATION)
+                for (auto n : SIZE)
+                {
+                    const std::string spec = "gen:" + shape + ":" + std::to_string(n) + ":" + p;
+                    std::cout.rdbuf(discard.rdbuf());
+                    release_mesh();
+                    load_mesh(spec);
+                    std::cout.rdbuf(console);
+                    for (auto g : GRADIENT)
+                        for (auto v : NOC)
+                        {
+                            FLM_SCALAR err_grad, err_res;
+                            std::cout.rdbuf(discard.rdbuf());
+                            consistency(g, v, err_grad, err_res);
+                            std::cout.rdbuf(console);
+                            discard.str("");
+
+                            const bool ok = err_grad <= CONSISTENCY_TOLERANCE && err_res <= CONSISTENCY_TOLERANCE;
+                            pass = pass && ok;
+                            std::cout << std::left << std::setw(28) << spec << std::setw(6) << GRADIENT_NAME[static_cast<int>(g)] << std::setw(14) << NOC_NAME[static_cast<int>(v)] << std::right;
+                            std::cout << std::setw(9) << cell.size() << std::scientific << std::setprecision(3) << std::setw(12) << err_grad << std::setw(12) << err_res << std::defaultfloat;
+                            std::cout << (ok ? "" : "  FAILED") << std::endl;
+                        }
+                }
+        release_mesh();
+        return pass ? 0 : 1;
+    }
+
+    std::vector<Case> res;
+    for (const auto &shape : SHAPE)
+        for (const auto &p : PERTURBATION)
+        {
+            std::cout << "\nShape \"" << shape << "\", perturbation " << p << std::endl;
+            const size_t first = res.size();
+            for (auto n : SIZE)
+            {
+                const std::string spec = "gen:" + shape + ":" + std::to_string(n) + ":" + p;
+                std::cout << "  Solving on \"" << spec << "\" ... " << std::flush;
+
+                std::cout.rdbuf(discard.rdbuf());
+                release_mesh();
+                load_mesh(spec);
+                for (auto g : GRADIENT)
+                    for (auto v : NOC)
+                    {
+                        Case c;
+                        c.shape = shape;
+                        c.perturbation = p;
+                        c.gradient = g;
+                        c.noc = v;
+                        c.size = n;
+                        set_bc();
+                        run(c, TOLERANCE, MAX_CORRECTION);
+                        res.push_back(c);
+                    }
+                std::cout.rdbuf(console);
+                discard.str("");
+                std::cout << cell.size() << " cells" << std::endl;
+            }
+
+            /// One table per configuration, from coarse to fine
+            for (auto g : GRADIENT)
+                for (auto v : NOC)
+                {
+                    std::cout << "\n  gradient=" << GRADIENT_NAME[static_cast<int>(g)] << ", noc=" << NOC_NAME[static_cast<int>(v)] << std::endl;
+                    std::cout << "  " << std::setw(9) << "cells" << std::setw(10) << "h" << std::setw(11) << "L2" << std::setw(6) << "p";
+                    std::cout << std::setw(11) << "Linf" << std::setw(6) << "p" << std::setw(11) << "L2(grad)" << std::setw(6) << "p";
+                    std::cout << std::setw(6) << "corr" << std::setw(7) << "CG" << std::setw(11) << "setup(s)" << std::setw(11) << "solve(s)" << std::setw(9) << "RSS(MB)" << std::endl;
+
+                    const Case *prev = nullptr;
+                    for (size_t k = first; k < res.size(); ++k)
+                    {
+                        const Case &c = res[k];
+                        if (c.gradient != g || c.noc != v)
+                            continue;
+
+                        std::cout << "  " << std::setw(9) << c.cells << std::fixed << std::setprecision(4) << std::setw(10) << c.h;
+                        std::cout << std::scientific << std::setprecision(3);
+                        auto print_order = [&prev, &c](FLM_SCALAR e_prev, FLM_SCALAR e) {
+                            if (prev)
+                                std::cout << std::fixed << std::setprecision(2) << std::setw(6) << order(e_prev, e, prev->h, c.h) << std::scientific << std::setprecision(3);
+                            else
+                                std::cout << std::setw(6) << "-";
+                        };
+                        std::cout << std::setw(11) << c.err_L2;
+                        print_order(prev ? prev->err_L2 : 0.0, c.err_L2);
+                        std::cout << std::setw(11) << c.err_Linf;
+                        print_order(prev ? prev->err_Linf : 0.0, c.err_Linf);
+                        std::cout << std::setw(11) << c.err_grad_L2;
+                        print_order(prev ? prev->err_grad_L2 : 0.0, c.err_grad_L2);
+                        std::cout << std::setw(6) << c.stat.outer << std::setw(7) << c.stat.inner;
+                        std::cout << std::setw(11) << c.t_setup << std::setw(11) << c.t_solve;
+                        std::cout << std::fixed << std::setprecision(1) << std::setw(9) << c.rss / 1048576.0 << std::defaultfloat << std::endl;
+                        if (c.stat.outer == MAX_CORRECTION || !std::isfinite(c.stat.correction))
+                            std::cout << "  Warning: not converged, last correction " << c.stat.correction << std::endl;
+                        prev = &c;
+                    }
+                }
+
+            /// Error against cost on the finest mesh
+            std::vector<const Case *> finest;
+            for (size_t k = first; k < res.size(); ++k)
+                if (res[k].size == SIZE.back())
+                    finest.push_back(&res[k]);
+            std::sort(finest.begin(), finest.end(), [](const Case *a, const Case *b) { return a->t_setup + a->t_solve < b->t_setup + b->t_solve; });
+            std::cout << "\n  Error vs. time on the finest mesh, fastest first:" << std::endl;
+            bool chosen = false;
+            for (auto c : finest)
+            {
+                std::cout << "  " << std::left << std::setw(6) << GRADIENT_NAME[static_cast<int>(c->gradient)] << std::setw(14) << NOC_NAME[static_cast<int>(c->noc)] << std::right;
+                std::cout << std::scientific << std::setprecision(3) << std::setw(11) << c->err_L2 << std::setw(11) << c->t_setup + c->t_solve << "s" << std::defaultfloat;
+                if (TARGET > 0.0 && !chosen && c->err_L2 <= TARGET)
+                {
+                    std::cout << "  <- fastest with L2 error below " << TARGET;
+                    chosen = true;
+                }
+                std::cout << std::endl;
+            }
+            if (TARGET > 0.0 && !chosen)
+                std::cout << "  No configuration reaches L2 error " << TARGET << std::endl;
+        }
+    release_mesh();
+
+    std::cout << "\nPeak memory: " << peak_resident_memory() / 1048576.0 << "MB" << std::endl;
+
+    if (!CSV_PATH.empty())
+    {
+        std::ofstream out(CSV_PATH);
+        if (out.fail())
+            throw failed_to_open_file(CSV_PATH);
+        out << std::setprecision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+        out << "shape,perturbation,gradient,noc,size,cells,h,L2,Linf,L2_grad,correction_steps,cg_iterations,residual,setup,solve,rss\n";
+        for (const auto &c : res)
+        {
+            out << c.shape << "," << c.perturbation << "," << GRADIENT_NAME[static_cast<int>(c.gradient)] << "," << NOC_NAME[static_cast<int>(c.noc)];
+            out << "," << c.size << "," << c.cells << "," << c.h << "," << c.err_L2 << "," << c.err_Linf << "," << c.err_grad_L2;
+            out << "," << c.stat.outer << "," << c.stat.inner << "," << c.stat.residual << "," << c.t_setup << "," << c.t_solve << "," << c.rss << "\n";
+        }
+        std::cout << "\nResults written to \"" << CSV_PATH << "\"" << std::endl;
+    }
+
+    return 0;
+}
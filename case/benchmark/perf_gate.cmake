@@ -0,0 +1,39 @@
+# Performance gate, run by the "perf-gate" and "perf-baseline" targets.
+# Runs a fixed sweep of BENCHMARK, single-threaded so that results do not depend on the machine load,
+# then either records it as the baseline or compares it against the baseline with BENCHMARK-COMPARE.
+# Expects BENCHMARK, COMPARE (the two tools), BASELINE (result file of a previous sweep),
+# WORK_DIR (scratch directory) and optionally RECORD (write the baseline instead of comparing).
+
+set(SWEEP --mesh gen:hex:16 --mesh gen:tet:8 --threads 1 --warmup 2 --repeat 10)
+
+if(NOT RECORD AND NOT EXISTS "${BASELINE}")
+	message(FATAL_ERROR "No baseline at \"${BASELINE}\", record one with the \"perf-baseline\" target or set FLM_PERF_BASELINE")
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(current ${WORK_DIR}/current.json)
+if(RECORD)
+	set(current ${BASELINE})
+endif()
+
+execute_process(
+	COMMAND ${BENCHMARK} ${SWEEP} --json ${current}
+	RESULT_VARIABLE rc
+	OUTPUT_FILE ${WORK_DIR}/benchmark.log)
+if(NOT rc EQUAL 0)
+	message(FATAL_ERROR "BENCHMARK failed: ${rc}, see \"${WORK_DIR}/benchmark.log\"")
+endif()
+
+if(RECORD)
+	message(STATUS "Baseline recorded in \"${BASELINE}\"")
+	return()
+endif()
+
+execute_process(
+	COMMAND ${COMPARE} --baseline ${BASELINE} --current ${current} --fail-on-missing
+	RESULT_VARIABLE rc)
+if(rc EQUAL 1)
+	message(FATAL_ERROR "Performance regressed against \"${BASELINE}\"")
+elseif(NOT rc EQUAL 0)
+	message(FATAL_ERROR "BENCHMARK-COMPARE failed: ${rc}")
+endif()
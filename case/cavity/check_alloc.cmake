@@ -0,0 +1,26 @@
+# Heap allocations of the time loop, run by CTest in builds with FLM_ALLOC_TRACKING.
+# CAVITY fails with "--alloc-check" if any iteration after the first allocates.
+# With OUTPUT set, telemetry, monitors and series output are written too, so that their paths are checked as well.
+# Expects CAVITY (the solver) and WORK_DIR (scratch directory).
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(args --mesh gen:hex:8 --iteration 30 --write-interval 5 --tag run --alloc-check --quiet)
+if(OUTPUT)
+	file(WRITE ${WORK_DIR}/monitor.txt "flux qup UP\nflux qdown DOWN\n")
+	list(APPEND args --telemetry telemetry.csv --monitor monitor.txt --output-layout series)
+endif()
+
+execute_process(
+	COMMAND ${CAVITY} ${args}
+	WORKING_DIRECTORY ${WORK_DIR}
+	RESULT_VARIABLE rc
+	OUTPUT_VARIABLE out
+	ERROR_VARIABLE err)
+if(NOT rc EQUAL 0)
+	message(FATAL_ERROR "CAVITY failed: ${rc}\n${err}")
+endif()
+if(OUTPUT AND NOT (EXISTS ${WORK_DIR}/run/monitor.csv AND EXISTS ${WORK_DIR}/telemetry.csv))
+	message(FATAL_ERROR "Monitors or telemetry were not written")
+endif()
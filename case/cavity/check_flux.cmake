@@ -0,0 +1,27 @@
+# Boundary fluxes of the cavity case, run by CTest.
+# UP is held hot and DOWN cold, so heat enters through UP and,
+# once it has crossed the cavity, leaves through DOWN.
+# Expects CAVITY (the solver) and WORK_DIR (scratch directory).
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+file(WRITE ${WORK_DIR}/monitor.txt "flux qup UP\nflux qdown DOWN\n")
+
+execute_process(
+	COMMAND ${CAVITY} --mesh gen:hex:6 --iteration 200 --write-interval 1000 --tag run --monitor monitor.txt --quiet
+	WORKING_DIRECTORY ${WORK_DIR}
+	RESULT_VARIABLE rc
+	OUTPUT_QUIET)
+if(NOT rc EQUAL 0)
+	message(FATAL_ERROR "CAVITY failed: ${rc}")
+endif()
+
+file(STRINGS ${WORK_DIR}/run/monitor.csv lines)
+list(GET lines -1 last)
+string(REPLACE "," ";" cols "${last}")
+list(GET cols 2 qup)
+list(GET cols 3 qdown)
+if(NOT (qup LESS 0 AND qdown GREATER 0))
+	message(FATAL_ERROR "Expected inflow through UP and outflow through DOWN, got UP=${qup}, DOWN=${qdown}")
+endif()
+message(STATUS "UP=${qup}, DOWN=${qdown}")
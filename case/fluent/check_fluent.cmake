@@ -0,0 +1,45 @@
+# FLUENT mesh reader, run by CTest.
+# "box.msh" and "box-binary.msh" describe the same 2x2x2 unit box as "gen:hex:2",
+# in ASCII and binary sections, with a mixed zone ("UP") and a polygonal zone ("DOWN").
+# Counts, patches and total volume must match the generated mesh,
+# and a polygon within a mixed zone must be rejected.
+# Expects CONVERT (MESH-CONVERT), FIXTURE_DIR (this directory) and WORK_DIR (scratch directory).
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+function(summary mesh dst)
+	execute_process(
+		COMMAND ${CONVERT} --mesh ${mesh} --output mesh.bin
+		WORKING_DIRECTORY ${WORK_DIR}
+		RESULT_VARIABLE rc
+		OUTPUT_VARIABLE out
+		ERROR_VARIABLE err)
+	if(NOT rc EQUAL 0)
+		message(FATAL_ERROR "MESH-CONVERT failed on \"${mesh}\": ${rc}\n${err}")
+	endif()
+	string(REGEX MATCHALL "  [^\n]*(cells|faces)[^\n]*" lines "${out}")
+	set(${dst} "${lines}" PARENT_SCOPE)
+endfunction()
+
+summary(gen:hex:2 expected)
+foreach(fixture box.msh box-binary.msh)
+	summary(${FIXTURE_DIR}/${fixture} got)
+	if(NOT got STREQUAL expected)
+		message(FATAL_ERROR "\"${fixture}\" differs from gen:hex:2:\n${got}\nexpected:\n${expected}")
+	endif()
+endforeach()
+message(STATUS "${expected}")
+
+file(READ ${FIXTURE_DIR}/box.msh text)
+string(REPLACE "(13 (3 d 10 3 0)(\n4 " "(13 (3 d 10 3 0)(\n5 " text "${text}")
+file(WRITE ${WORK_DIR}/polygon-in-mixed.msh "${text}")
+execute_process(
+	COMMAND ${CONVERT} --mesh polygon-in-mixed.msh --output mesh.bin
+	WORKING_DIRECTORY ${WORK_DIR}
+	RESULT_VARIABLE rc
+	OUTPUT_QUIET
+	ERROR_VARIABLE err)
+if(rc EQUAL 0 OR NOT err MATCHES "unsupported face type 5 in mixed zone")
+	message(FATAL_ERROR "Polygon within a mixed zone was not rejected: ${rc}\n${err}")
+endif()
@@ -0,0 +1,25 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Running totals of heap allocations.
+ * Frees are not counted, and both totals stay at zero unless built with FLM_ALLOC_TRACKING.
+ */
+struct AllocSample
+{
+    uint64_t count; /// Number of allocations
+    uint64_t bytes; /// Bytes requested
+};
+
+bool alloc_tracking();
+
+void alloc_read(AllocSample &dst);
+
+void alloc_read_all(AllocSample &dst);
+
+bool alloc_exclude_thread(bool on = true);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef BINFILE_H
+#define BINFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "error.h"
+#include "mapped.h"
+
+/**
+ * Common layout of binary files written by the solver:
+ *   char     magic[8]
+ *   uint32_t version
+ *   uint32_t number of sections
+ *   uint64_t count[4]            (file-specific entity counts)
+ *   uint64_t offset, bytes       (one pair per section)
+ *   payload of each section, starting at 8-byte aligned offsets.
+ * All fields are fixed-width and little-endian.
+ */
+constexpr size_t FLM_BINFILE_NUM_OF_COUNT = 4;
+
+bool host_is_little_endian();
+
+bool has_magic(const std::string &path, const char *magic);
+
+void write_at(int fd, const char *buf, size_t n, uint64_t offset, const std::string &path);
+
+void read_at(int fd, char *buf, size_t n, uint64_t offset, const std::string &path);
+
+class SectionWriter
+{
+public:
+    SectionWriter(const char *magic, uint32_t version, size_t n_section);
+
+    void set_count(size_t k, uint64_t n) { count.at(k) = n; }
+
+    template<typename T>
+    void put(size_t k, const T *src, size_t n)
+    {
+        auto &dst = payload.at(k);
+        dst.resize(n * sizeof(T));
+        if (n > 0)
+            std::memcpy(dst.data(), src, n * sizeof(T));
+    }
+
+    template<typename T>
+    void put(size_t k, const std::vector<T> &src)
+    {
+        put(k, src.data(), src.size());
+    }
+
+    void write(const std::string &path) const;
+
+private:
+    char magic[8];
+    uint32_t version;
+    std::vector<uint64_t> count;
+    std::vector<std::vector<char>> payload;
+};
+
+class SectionReader
+{
+public:
+    SectionReader(const std::string &path, const char *magic, uint32_t version, size_t n_section);
+
+    uint64_t get_count(size_t k) const { return count.at(k); }
+
+    /// Number of elements of type "T" stored in section "k".
+    template<typename T>
+    size_t length(size_t k) const
+    {
+        if (bytes.at(k) % sizeof(T))
+            throw invalid_file_format(path, "section " + std::to_string(k) + " has a partial element.");
+        return bytes.at(k) / sizeof(T);
+    }
+
+    /// View of section "k", which is expected to hold exactly "n" elements.
+    template<typename T>
+    const T *get(size_t k, size_t n) const
+    {
+        if (bytes.at(k) != n * sizeof(T))
+            throw invalid_file_format(path, "unexpected size of section " + std::to_string(k) + ".");
+        return reinterpret_cast<const T *>(src.data() + offset.at(k));
+    }
+
+private:
+    std::string path;
+    MappedFile src;
+    std::vector<uint64_t> count;
+    std::vector<uint64_t> offset, bytes;
+};
+
+#endif
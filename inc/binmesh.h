@@ -0,0 +1,23 @@
+#ifndef BINMESH_H
+#define BINMESH_H
+
+#include <cstdint>
+#include <string>
+
+/// Layout versions of the binary meshes, bumped on any incompatible change.
+constexpr uint32_t FLM_BINMESH_VERSION = 1;
+constexpr uint32_t FLM_MINMESH_VERSION = 1;
+
+bool is_binary_mesh(const std::string &path);
+
+void read_mesh_binary(const std::string &path);
+
+void write_mesh_binary(const std::string &path);
+
+bool is_minimal_mesh(const std::string &path);
+
+void read_mesh_minimal(const std::string &path);
+
+void write_mesh_minimal(const std::string &path);
+
+#endif
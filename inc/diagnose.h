@@ -1,6 +1,20 @@
 #ifndef DIAGNOSE_H
 #define DIAGNOSE_H
 
-void diagnose(bool diverged);
+#include "basic.h"
+
+/// Global quantities evaluated by the latest call to "diagnose".
+struct FLM_DIAGNOSIS
+{
+    FLM_SCALAR volume; /// Total volume of the domain
+    FLM_SCALAR T_min, T_max; /// Extrema of cell values
+    FLM_SCALAR T_mean; /// Volume-weighted average
+    FLM_SCALAR T_rms; /// Volume-weighted root mean square
+    FLM_SCALAR heat_flux; /// Net heat flux through all boundary patches with unit conductivity, positive outwards
+};
+
+void diagnose(bool &diverged);
+
+const FLM_DIAGNOSIS &last_diagnosis();
 
 #endif
@@ -98,4 +98,11 @@ struct inconsistent_mesh : public std::runtime_error
     {}
 };
 
+struct invalid_file_format : public std::runtime_error
+{
+    invalid_file_format(const std::string &fn, const std::string &msg) :
+        std::runtime_error("\"" + fn + "\": " + msg)
+    {}
+};
+
 #endif
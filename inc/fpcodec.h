@@ -0,0 +1,24 @@
+#ifndef FPCODEC_H
+#define FPCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "basic.h"
+
+enum class FLM_CODEC : uint32_t
+{
+    Raw = 0,
+    Xor = 1,      /// Lossless, XOR with predecessor
+    Quantized = 2 /// Lossy, error-bounded residual of predecessor
+};
+
+size_t encode_xor(const FLM_SCALAR *src, size_t n, std::vector<char> &dst);
+
+bool decode_xor(const char *src, size_t len, FLM_SCALAR *dst, size_t n);
+
+size_t encode_quantized(const FLM_SCALAR *src, size_t n, FLM_SCALAR tol, std::vector<char> &dst);
+
+bool decode_quantized(const char *src, size_t len, FLM_SCALAR tol, FLM_SCALAR *dst, size_t n);
+
+#endif
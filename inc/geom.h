@@ -1,8 +1,14 @@
 #ifndef GEOM_H
 #define GEOM_H
 
-void calculate_geometric_value();
+#include "noc.h"
+
+void calculate_mesh_metrics();
+
+void calculate_geometric_value(FLM_NOC variant = FLM_NOC::OverRelaxed);
 
 void check_skewness();
 
+void report_skewness();
+
 #endif
@@ -0,0 +1,16 @@
+#ifndef GEOMCACHE_H
+#define GEOMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+/// Layout version of geometry caches, bumped whenever the cached quantities change.
+constexpr uint32_t FLM_GEOMCACHE_VERSION = 1;
+
+uint64_t geometry_key(uint64_t mesh);
+
+bool load_geometry_cache(const std::string &path, uint64_t key);
+
+void save_geometry_cache(const std::string &path, uint64_t key);
+
+#endif
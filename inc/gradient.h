@@ -1,8 +1,23 @@
 #ifndef GRADIENT_H
 #define GRADIENT_H
 
+#include <cstddef>
+#include <vector>
+#include "basic.h"
+
+enum class FLM_GRADIENT : int
+{
+    GG1 = 0, /// Green-Gauss, face values from adjacent cells
+    GG2 = 1, /// Green-Gauss, face values from nodes
+    LSQ = 2  /// Least-Square
+};
+
 void prepare_lsq();
 
-void calculate_cell_gradient();
+void save_lsq(std::vector<FLM_SCALAR> &dst);
+
+bool load_lsq(const FLM_SCALAR *src, size_t n);
+
+void calculate_cell_gradient(FLM_GRADIENT scheme = FLM_GRADIENT::GG2);
 
 #endif
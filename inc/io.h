@@ -3,12 +3,32 @@
 
 #include <istream>
 #include <ostream>
+#include <string>
+#include <cstdint>
 #include "basic.h"
 
 void read_mesh(std::istream &fin);
 
+void write_mesh(std::ostream &fout);
+
+void read_mesh_mapped(const std::string &path);
+
+bool is_fluent_mesh(const std::string &path);
+
+void read_mesh_fluent(const std::string &path);
+
+void load_mesh(const std::string &path);
+
+struct Snapshot;
+
 void write_data(std::ostream &out, size_t iter, FLM_SCALAR t);
 
+void write_data(std::ostream &out, const Snapshot &src);
+
 void read_data(std::istream &in, size_t &iter, FLM_SCALAR &t);
 
+void load_data(const std::string &path, size_t &iter, FLM_SCALAR &t);
+
+uint64_t mesh_hash();
+
 #endif
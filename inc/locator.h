@@ -0,0 +1,47 @@
+#ifndef LOCATOR_H
+#define LOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "element.h"
+
+bool cell_contains(const Cell *c, const FLM_VECTOR &x);
+
+/**
+ * Bounding volume hierarchy over a set of cells.
+ * Each node keeps the box of its cells and the box of their centroids, so the same tree
+ * answers point location, nearest-centroid and box queries in O(log N) on typical meshes.
+ * Cells are split at the median centroid along the widest axis, and the layout of the tree
+ * depends only on the number of cells, so subtrees are built in parallel without locking.
+ */
+class CellLocator
+{
+public:
+    explicit CellLocator(const std::vector<Cell *> &src);
+
+    Cell *locate(const FLM_VECTOR &x) const;
+
+    Cell *nearest(const FLM_VECTOR &x) const;
+
+    void nearest(const FLM_VECTOR &x, size_t k, std::vector<Cell *> &dst) const;
+
+    void query(const FLM_VECTOR &lo, const FLM_VECTOR &hi, std::vector<Cell *> &dst) const;
+
+private:
+    struct Node
+    {
+        FLM_VECTOR lo, hi; /// Box of the cells
+        FLM_VECTOR c_lo, c_hi; /// Box of the centroids
+        uint32_t begin, end; /// Range in "entry"
+        uint32_t right; /// Right child, the left one follows its parent
+    };
+
+    void build(size_t k, size_t begin, size_t end, std::vector<uint32_t> &order, const std::vector<FLM_VECTOR> &ctr);
+
+    std::vector<Cell *> entry;
+    std::vector<FLM_VECTOR> lo, hi; /// Box of each entry
+    std::vector<Node> tree;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file.
+ * Unmapped on destruction.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return ptr; }
+
+    size_t size() const { return len; }
+
+private:
+    const char *ptr;
+    size_t len;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef MESHGEN_H
+#define MESHGEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "basic.h"
+
+enum class FLM_GEN_SHAPE : int
+{
+    Hex = 0,
+    Tet = 1,
+    Prism = 2,
+    Pyramid = 3
+};
+
+/**
+ * Unit box split into "nx * ny * nz" blocks, each filled with cells of one shape:
+ *   Hex      1 hexahedron
+ *   Tet      6 tetrahedra sharing the main diagonal of the block
+ *   Prism    2 wedges, split along the diagonal of the xy plane
+ *   Pyramid  6 pyramids, with apex at the center of the block
+ * Patches are named LEFT/RIGHT (x), FRONT/BACK (y) and DOWN/UP (z).
+ */
+struct FLM_MESH_SPEC
+{
+    FLM_GEN_SHAPE shape;
+    size_t nx, ny, nz;
+
+    /// Largest displacement of interior nodes along each axis, as a fraction of the spacing
+    FLM_SCALAR perturbation;
+    uint64_t seed;
+};
+
+bool is_mesh_spec(const std::string &str);
+
+void parse_mesh_spec(const std::string &str, FLM_MESH_SPEC &dst);
+
+void generate_mesh(const FLM_MESH_SPEC &spec);
+
+#endif
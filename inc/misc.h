@@ -2,11 +2,20 @@
 #define MISC_H
 
 #include <ctime>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
 #include <string>
 #include "basic.h"
 
-FLM_SCALAR duration(const clock_t &startTime, const clock_t &endTime);
+FLM_SCALAR duration(const std::chrono::steady_clock::time_point &startTime, const std::chrono::steady_clock::time_point &endTime);
 
 void runtime_str(std::string &ret);
 
+uint64_t hash64(const void *data, size_t bytes, uint64_t seed = 0);
+
+size_t resident_memory();
+
+size_t peak_resident_memory();
+
 #endif
@@ -0,0 +1,60 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include "element.h"
+#include "locator.h"
+
+/**
+ * Cheap per-step output of a few quantities instead of the whole field.
+ * Configured from a text file, one monitor per line, "#" starting a comment:
+ *   probe NAME x y z         T at a point, from the containing cell and its gradient
+ *   flux NAME PATCH...       Heat flux through the patches with unit conductivity, positive outwards
+ *   average NAME PATCH...    Area-weighted average of T on the patches
+ * Results are appended as CSV, or as binary records if the output ends with ".bin".
+ */
+class Monitor
+{
+public:
+    Monitor(const std::string &config, const std::string &output, bool resume, const CellLocator &locator);
+
+    void record(size_t iter, FLM_SCALAR t);
+
+    void flush();
+
+private:
+    enum class KIND : int
+    {
+        Probe = 0,
+        Flux = 1,
+        Average = 2
+    };
+
+    struct Item
+    {
+        KIND kind;
+        std::string name;
+
+        /// Probe location and its containing cell
+        FLM_VECTOR x;
+        Cell *c;
+
+        /// Faces of the selected patches, in order of global index
+        std::vector<BoundaryFace *> surface;
+        FLM_SCALAR area;
+    };
+
+    void parse(const std::string &config, const CellLocator &locator);
+
+    void open(const std::string &output, bool resume);
+
+    std::vector<Item> item;
+    std::vector<FLM_SCALAR> value;
+    bool binary;
+    std::ofstream out;
+};
+
+#endif
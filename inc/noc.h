@@ -3,6 +3,13 @@
 
 #include "basic.h"
 
-void noc_decompose(const FLM_VECTOR &d, const FLM_VECTOR &S, FLM_VECTOR &E, FLM_VECTOR &T);
+enum class FLM_NOC : int
+{
+    Minimum = 0,
+    Orthogonal = 1,
+    OverRelaxed = 2
+};
+
+void noc_decompose(const FLM_VECTOR &d, const FLM_VECTOR &S, FLM_VECTOR &E, FLM_VECTOR &T, FLM_NOC variant = FLM_NOC::OverRelaxed);
 
 #endif
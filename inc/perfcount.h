@@ -0,0 +1,33 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Hardware events sampled around each timed scope.
+enum : size_t
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS = 1,
+    PERF_LLC_MISSES = 2,
+    PERF_DRAM_BYTES = 3,
+    PERF_NUM = 4
+};
+
+/**
+ * Running totals of the hardware events.
+ * Unavailable events stay at zero.
+ */
+struct PerfSample
+{
+    uint64_t v[PERF_NUM];
+};
+
+bool perf_counters_init(std::string &why);
+
+bool perf_available(size_t event);
+
+void perf_read(PerfSample &dst);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef POISSON_H
+#define POISSON_H
+
+#include <cstddef>
+#include <vector>
+#include "basic.h"
+#include "gradient.h"
+
+/// Convergence history of the latest call to "solve_poisson".
+struct FLM_POISSON_STAT
+{
+    size_t outer; /// Non-Orthogonal correction steps
+    size_t inner; /// Conjugate Gradient iterations, summed over all steps
+    FLM_SCALAR correction; /// Max change of cell values in the last step
+    FLM_SCALAR residual; /// Max deviation of the discrete Laplacian from the source
+};
+
+void prepare_poisson();
+
+void solve_poisson(const std::vector<FLM_SCALAR> &source, FLM_GRADIENT scheme, FLM_SCALAR tol, size_t max_outer, FLM_POISSON_STAT &stat);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstddef>
+#include <atomic>
+#include <ostream>
+#include <string>
+
+size_t profile_region(const char *name);
+
+void profile_enable(bool on);
+
+void profile_report(std::ostream &out, size_t n_item = 0);
+
+bool profile_counters(std::string &why);
+
+void profile_roofline(double bandwidth);
+
+void profile_work(double bytes, double flops);
+
+void profile_thread_name(const char *name);
+
+void trace_enable(size_t capacity);
+
+bool trace_requested();
+
+void trace_dump(const std::string &path);
+
+void profile_begin(size_t region);
+
+void profile_end();
+
+/// Checked on entry of every timed scope, so it is the whole cost when neither profiling nor tracing is on.
+extern std::atomic<bool> flm_profile_on;
+
+/**
+ * Wall time of a scope, on a monotonic clock.
+ * Nested scopes on the same thread form a tree, so a region is reported under each of its callers.
+ * Scopes entered by other threads, such as OpenMP workers or the output thread, start their own tree.
+ * With tracing on, each scope also leaves one event in a ring buffer owned by its thread.
+ */
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(size_t region) :
+        active(flm_profile_on.load(std::memory_order_relaxed))
+    {
+        if (active)
+            profile_begin(region);
+    }
+
+    ~ScopedTimer()
+    {
+        if (active)
+            profile_end();
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    bool active;
+};
+
+#define FLM_PROFILE_CAT2(a, b) a##b
+#define FLM_PROFILE_CAT(a, b) FLM_PROFILE_CAT2(a, b)
+
+/// Time the rest of the enclosing scope as region "name", registered once per call site.
+#define FLM_PROFILE(name)                                                                         \
+    static const size_t FLM_PROFILE_CAT(flm_region_, __LINE__) = profile_region(name);           \
+    ScopedTimer FLM_PROFILE_CAT(flm_timer_, __LINE__)(FLM_PROFILE_CAT(flm_region_, __LINE__))
+
+#endif
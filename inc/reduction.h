@@ -0,0 +1,85 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "basic.h"
+#include "profile.h"
+
+enum class FLM_REDUCTION : int
+{
+    Pairwise = 0,
+    Compensated = 1
+};
+
+/// Number of consecutive terms accumulated sequentially before entering the pairwise tree.
+/// Fixed at compile time, so the association order depends only on the number of terms.
+constexpr size_t FLM_REDUCTION_CHUNK = 1024;
+
+/// Partial sum of one chunk, with the running compensation term.
+struct FLM_PARTIAL
+{
+    FLM_SCALAR s;
+    FLM_SCALAR c;
+};
+
+FLM_SCALAR combine_partials(std::vector<FLM_PARTIAL> &partial, FLM_REDUCTION mode);
+
+std::vector<FLM_PARTIAL> &reduction_scratch(size_t n);
+
+/**
+ * Bitwise reproducible summation of "term(0) + ... + term(n-1)".
+ * Terms are split into chunks of fixed size, each chunk is accumulated in index order,
+ * and chunk partials are combined by a balanced pairwise tree.
+ * Neither step depends on how chunks are scheduled onto threads.
+ * Partials live in per-thread scratch space, so "term" must not start another reduction.
+ * @param n Number of terms.
+ * @param term Callable mapping a 0-based index to its term.
+ * @param mode Plain pairwise or compensated (Neumaier) accumulation.
+ * @return The sum.
+ */
+template<typename F>
+FLM_SCALAR reduce_sum(size_t n, F term, FLM_REDUCTION mode = FLM_REDUCTION::Pairwise)
+{
+    const size_t nChunk = (n + FLM_REDUCTION_CHUNK - 1) / FLM_REDUCTION_CHUNK;
+    auto &partial = reduction_scratch(nChunk);
+
+    /// Timed per thread, so that imbalance shows up in traces
+#pragma omp parallel
+    {
+        FLM_PROFILE("reduce_sum.chunks");
+#pragma omp for schedule(static) nowait
+        for (size_t k = 0; k < nChunk; ++k)
+        {
+            const size_t i0 = k * FLM_REDUCTION_CHUNK;
+            const size_t i1 = std::min(n, i0 + FLM_REDUCTION_CHUNK);
+
+            FLM_SCALAR s = 0.0, c = 0.0;
+            if (mode == FLM_REDUCTION::Compensated)
+            {
+                for (size_t i = i0; i < i1; ++i)
+                {
+                    const FLM_SCALAR x = term(i);
+                    const FLM_SCALAR t = s + x;
+                    if (std::abs(s) >= std::abs(x))
+                        c += (s - t) + x;
+                    else
+                        c += (x - t) + s;
+                    s = t;
+                }
+            }
+            else
+            {
+                for (size_t i = i0; i < i1; ++i)
+                    s += term(i);
+            }
+            partial[k] = {s, c};
+        }
+    }
+
+    return combine_partials(partial, mode);
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <cstddef>
+
+/**
+ * Work models of the kernels count, for each item, every byte touched through the active layout,
+ * as if nothing were reused from cache between items: an upper bound of the memory traffic.
+ * Reading the elements of a "std::vector" first reads its begin and end pointers.
+ */
+constexpr size_t FLM_LIST_BYTES = 2 * sizeof(void *);
+
+/// Reading the type of a face through its virtual table.
+constexpr size_t FLM_VPTR_BYTES = sizeof(void *);
+
+double stream_bandwidth(size_t bytes = size_t(384) << 20);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "snapshot.h"
+
+/// Layout version of time-series containers, bumped on any incompatible change.
+constexpr uint32_t FLM_SERIES_VERSION = 1;
+
+/**
+ * Location of one record in a time-series container.
+ * The side index "<path>.idx" is an array of these behind a fixed header,
+ * so the latest record is found from the size of the index alone.
+ */
+struct SeriesEntry
+{
+    uint64_t iter;
+    double t;
+    uint64_t offset;
+    uint64_t length;
+};
+
+/**
+ * Append-only container of snapshots from one run.
+ * Records are encoded snapshots, see "encode_snapshot".
+ */
+class SeriesWriter
+{
+public:
+    SeriesWriter(const std::string &path, uint64_t mesh, bool resume);
+
+    ~SeriesWriter();
+
+    SeriesWriter(const SeriesWriter &) = delete;
+
+    SeriesWriter &operator=(const SeriesWriter &) = delete;
+
+    void append(const Snapshot &src, FLM_CODEC codec = FLM_CODEC::Raw, FLM_SCALAR tol = 0.0);
+
+private:
+    std::string path, ipath;
+    int fd_data, fd_index;
+    uint64_t n_entry;
+    uint64_t end;
+};
+
+/**
+ * Random access to the records of a container.
+ */
+class SeriesReader
+{
+public:
+    explicit SeriesReader(const std::string &path);
+
+    ~SeriesReader();
+
+    SeriesReader(const SeriesReader &) = delete;
+
+    SeriesReader &operator=(const SeriesReader &) = delete;
+
+    size_t size() const { return index.size(); }
+
+    const SeriesEntry &entry(size_t k) const { return index.at(k); }
+
+    size_t find(size_t iter) const;
+
+    void read(size_t k, Snapshot &dst) const;
+
+private:
+    std::string path;
+    int fd;
+    std::vector<SeriesEntry> index;
+};
+
+bool is_series(const std::string &path);
+
+bool series_latest(const std::string &path, SeriesEntry &dst);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "basic.h"
+#include "fpcodec.h"
+
+/// Layout version of binary snapshots, bumped on any incompatible change.
+constexpr uint32_t FLM_SNAPSHOT_VERSION = 1;
+
+/**
+ * Solution at one instant, detached from the mesh entities.
+ */
+struct Snapshot
+{
+    /// Iteration and physical time
+    size_t iter;
+    FLM_SCALAR t;
+
+    /// Fingerprint of the mesh, see "mesh_hash"
+    uint64_t mesh;
+
+    /// Variables, in order of global index
+    std::vector<FLM_SCALAR> node_T, face_T, cell_T;
+};
+
+void gather_snapshot(Snapshot &dst, size_t iter, FLM_SCALAR t);
+
+void scatter_snapshot(const Snapshot &src);
+
+bool is_binary_snapshot(const std::string &path);
+
+const std::vector<char> &encode_snapshot(const Snapshot &src, FLM_CODEC codec = FLM_CODEC::Raw, FLM_SCALAR tol = 0.0);
+
+void decode_snapshot(const char *data, size_t len, const std::string &path, Snapshot &dst);
+
+void write_snapshot(const std::string &path, const Snapshot &src, FLM_CODEC codec = FLM_CODEC::Raw, FLM_SCALAR tol = 0.0);
+
+void read_snapshot(const std::string &path, Snapshot &dst);
+
+#endif
@@ -1,6 +1,17 @@
 #ifndef SPATIAL_H
 #define SPATIAL_H
 
+#include <vector>
+#include "basic.h"
+
+class BoundaryFace;
+
 void interpolate_nodal_value();
 
+void interpolate_face_value();
+
+void calculate_residual(std::vector<FLM_SCALAR> &dst);
+
+FLM_SCALAR boundary_flux(const BoundaryFace *f);
+
 #endif
@@ -0,0 +1,73 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "basic.h"
+
+/// Wall time of each stage of one step, in s.
+struct FLM_STAGE_TIME
+{
+    double step; /// Time-stepping
+    double check; /// Diagnosis and monitors
+    double output; /// Solution output, zero on steps without any
+};
+
+/**
+ * Machine-readable progress of a run, one JSON object per line:
+ *   {"iter":10,"t":0.001,"dt":0.0001,"res_l2":..,"res_max":..,"T_min":..,"T_max":..,
+ *    "wall":{"step":..,"check":..,"output":..},"rss":..,"dropped":0}
+ * Residual norms are those of the time derivative from the latest step, "res_l2" being volume-weighted.
+ * Records are formatted and written on a background thread, from a fixed number of slots.
+ * When a slow reader keeps all slots taken, new records are dropped and counted in the next one written,
+ * so the solver never waits on the output.
+ * The output may be a named pipe, which is opened once a reader shows up.
+ */
+class Telemetry
+{
+public:
+    Telemetry(const std::string &output, bool resume, size_t depth = 1024);
+
+    ~Telemetry();
+
+    Telemetry(const Telemetry &) = delete;
+
+    Telemetry &operator=(const Telemetry &) = delete;
+
+    void record(size_t iter, FLM_SCALAR t, FLM_SCALAR dt, const FLM_STAGE_TIME &wall);
+
+private:
+    struct Record
+    {
+        size_t iter;
+        FLM_SCALAR t, dt;
+        FLM_SCALAR res_l2, res_max;
+        FLM_SCALAR T_min, T_max;
+        FLM_STAGE_TIME wall;
+        size_t dropped; /// Records lost right before this one
+    };
+
+    void run();
+
+    bool open_output();
+
+    std::string path;
+    bool append;
+    int fd;
+    std::vector<Record> slot; /// Ring buffer
+    size_t head, count;
+    size_t dropped;
+    bool stop;
+    bool failed; /// Set by the background thread, which then discards records
+    bool warned;
+    std::string failure;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+};
+
+#endif
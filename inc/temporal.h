@@ -1,10 +1,13 @@
 #ifndef TEMPORAL_H
 #define TEMPORAL_H
 
+#include <vector>
 #include "basic.h"
 
 void RK3(FLM_SCALAR TimeStep);
 
 void ForwardEuler(FLM_SCALAR TimeStep);
 
+const std::vector<FLM_SCALAR> &last_residual();
+
 #endif
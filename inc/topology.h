@@ -0,0 +1,36 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Face-based description of a mesh, from which all other connectivity is derived.
+ * Arrays are borrowed from the caller.
+ * References are 1-based, and 0 stands for "empty".
+ */
+struct FLM_FACE_MESH
+{
+    size_t NumOfNode, NumOfFace, NumOfCell;
+
+    /// Node coordinates, [3 * NumOfNode]
+    const double *coordinate;
+
+    /// Face to node, in CSR form
+    const uint64_t *face_node_ptr; /// [NumOfFace + 1]
+    const uint32_t *face_node_idx;
+
+    /// Face to cell, c0 and c1 of each face, [2 * NumOfFace]
+    const uint32_t *face_cell;
+
+    /// Patch to face, in CSR form
+    std::vector<std::string> patch_name;
+    const uint64_t *patch_face_ptr; /// [NumOfPatch + 1]
+    const uint32_t *patch_face_idx;
+};
+
+void build_mesh(const FLM_FACE_MESH &src);
+
+#endif
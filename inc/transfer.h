@@ -0,0 +1,8 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <string>
+
+void transfer_solution(const std::string &mesh_path, const std::string &data_path);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef VTK_H
+#define VTK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "basic.h"
+
+/**
+ * Visualization output as VTK XML unstructured grids with appended raw data,
+ * collected in a ParaView data file ("*.pvd") keyed by physical time.
+ * Tetrahedra are written as such, other cells as polyhedra built from their faces,
+ * so no assumption on the node ordering of the input mesh is needed.
+ * Point data: "T". Cell data: "T", "grad_T".
+ */
+class VtuSeries
+{
+public:
+    VtuSeries(const std::string &dir, const std::string &prefix, bool resume);
+
+    void write(size_t iter, FLM_SCALAR t);
+
+private:
+    void encode_topology();
+
+    void write_collection() const;
+
+    std::string dir, prefix;
+
+    /// "Points" and "Cells" elements, with offsets into "topology".
+    std::string topology_xml;
+
+    /// Appended data of points and cells, encoded once.
+    std::vector<char> topology;
+
+    /// Entries of the collection, one per file.
+    std::vector<std::string> record;
+
+    /// Appended data of fields, reused across calls.
+    std::vector<char> field;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include "snapshot.h"
+
+/**
+ * Background solution output.
+ * The solver copies its field into one of a fixed number of buffers and carries on,
+ * while a dedicated thread encodes and writes queued buffers in submission order.
+ * When every buffer is in flight, "submit" blocks until one is released.
+ */
+class AsyncWriter
+{
+public:
+    /// Invoked on the background thread for each snapshot.
+    typedef std::function<void(const Snapshot &)> Sink;
+
+    AsyncWriter(size_t depth, uint64_t mesh, Sink sink);
+
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter &) = delete;
+
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    void submit(size_t iter, FLM_SCALAR t);
+
+    void flush();
+
+private:
+    void run();
+
+    void rethrow();
+
+    Sink sink;
+    std::vector<Snapshot> pool;
+    /// Reserved for the whole pool, so queueing never allocates
+    std::vector<Snapshot *> idle, ready;
+    size_t busy;
+    bool stop;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include <cerrno>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include "../inc/alloctrack.h"
+
+#ifdef FLM_ALLOC_TRACKING
+
+/// Plain thread-local data, so touching it from inside the allocator never allocates
+static thread_local AllocSample mine = {0, 0};
+static thread_local bool excluded = false;
+
+/// Summed over threads not excluded by "alloc_exclude_thread"
+static std::atomic<uint64_t> all_count(0), all_bytes(0);
+
+static inline void record(size_t n)
+{
+    ++mine.count;
+    mine.bytes += n;
+    if (!excluded)
+    {
+        all_count.fetch_add(1, std::memory_order_relaxed);
+        all_bytes.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+#ifdef __GLIBC__
+/**
+ * The C allocator is replaced as well, so that callers of "malloc" are seen.
+ * That covers Eigen, whose "aligned_malloc" calls "std::malloc" directly on this platform.
+ * Requests are forwarded to the entry points glibc keeps for this purpose.
+ */
+extern "C"
+{
+    void *__libc_malloc(size_t n);
+    void *__libc_calloc(size_t k, size_t n);
+    void *__libc_realloc(void *p, size_t n);
+    void *__libc_memalign(size_t align, size_t n);
+    void __libc_free(void *p);
+
+    void *malloc(size_t n) noexcept
+    {
+        record(n);
+        return __libc_malloc(n);
+    }
+
+    void *calloc(size_t k, size_t n) noexcept
+    {
+        record(k * n);
+        return __libc_calloc(k, n);
+    }
+
+    void *realloc(void *p, size_t n) noexcept
+    {
+        if (n > 0)
+            record(n);
+        return __libc_realloc(p, n);
+    }
+
+    void free(void *p) noexcept
+    {
+        __libc_free(p);
+    }
+
+    void *memalign(size_t align, size_t n) noexcept
+    {
+        record(n);
+        return __libc_memalign(align, n);
+    }
+
+    void *aligned_alloc(size_t align, size_t n) noexcept
+    {
+        record(n);
+        return __libc_memalign(align, n);
+    }
+
+    int posix_memalign(void **dst, size_t align, size_t n) noexcept
+    {
+        if (align < sizeof(void *) || (align & (align - 1)) != 0)
+            return EINVAL;
+        record(n);
+        void *p = __libc_memalign(align, n);
+        if (p == nullptr)
+            return ENOMEM;
+        *dst = p;
+        return 0;
+    }
+}
+
+/// Not counted again by the hooks above
+static inline void *raw_alloc(size_t n, size_t align)
+{
+    return align > alignof(std::max_align_t) ? __libc_memalign(align, n) : __libc_malloc(n);
+}
+
+static inline void raw_free(void *p)
+{
+    __libc_free(p);
+}
+#else
+static inline void *raw_alloc(size_t n, size_t align)
+{
+    return align > alignof(std::max_align_t) ? std::aligned_alloc(align, (n + align - 1) / align * align) : std::malloc(n);
+}
+
+static inline void raw_free(void *p)
+{
+    std::free(p);
+}
+#endif
+
+static void *counted_new(size_t n, size_t align)
+{
+    record(n);
+    void *p = raw_alloc(n > 0 ? n : 1, align);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t n)
+{
+    return counted_new(n, 0);
+}
+
+void *operator new[](size_t n)
+{
+    return counted_new(n, 0);
+}
+
+void *operator new(size_t n, std::align_val_t align)
+{
+    return counted_new(n, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t n, std::align_val_t align)
+{
+    return counted_new(n, static_cast<size_t>(align));
+}
+
+void *operator new(size_t n, const std::nothrow_t &) noexcept
+{
+    record(n);
+    return raw_alloc(n > 0 ? n : 1, 0);
+}
+
+void *operator new[](size_t n, const std::nothrow_t &) noexcept
+{
+    record(n);
+    return raw_alloc(n > 0 ? n : 1, 0);
+}
+
+void *operator new(size_t n, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    record(n);
+    return raw_alloc(n > 0 ? n : 1, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t n, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    record(n);
+    return raw_alloc(n > 0 ? n : 1, static_cast<size_t>(align));
+}
+
+void operator delete(void *p) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    raw_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    raw_free(p);
+}
+
+/**
+ * Whether heap allocations are counted, i.e. the build has FLM_ALLOC_TRACKING.
+ */
+bool alloc_tracking()
+{
+    return true;
+}
+
+/**
+ * Allocations made by the calling thread since it started.
+ * @param dst Running totals.
+ */
+void alloc_read(AllocSample &dst)
+{
+    dst = mine;
+}
+
+/**
+ * Allocations made by all threads but the excluded ones since the program started.
+ * @param dst Running totals.
+ */
+void alloc_read_all(AllocSample &dst)
+{
+    dst.count = all_count.load(std::memory_order_relaxed);
+    dst.bytes = all_bytes.load(std::memory_order_relaxed);
+}
+
+/**
+ * Leave allocations of the calling thread out of "alloc_read_all",
+ * for service threads that run alongside the solver, such as the output thread,
+ * or for a while, around one-off bookkeeping.
+ * @param on Whether to exclude the calling thread from now on.
+ * @return Whether it was excluded before.
+ */
+bool alloc_exclude_thread(bool on)
+{
+    const bool was = excluded;
+    excluded = on;
+    return was;
+}
+
+#else
+
+bool alloc_tracking()
+{
+    return false;
+}
+
+void alloc_read(AllocSample &dst)
+{
+    dst = {0, 0};
+}
+
+void alloc_read_all(AllocSample &dst)
+{
+    dst = {0, 0};
+}
+
+bool alloc_exclude_thread(bool)
+{
+    return false;
+}
+
+#endif
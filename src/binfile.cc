@@ -0,0 +1,171 @@
+#include <fstream>
+#include <unistd.h>
+#include "../inc/binfile.h"
+
+static const size_t ALIGNMENT = 8;
+
+static size_t aligned(size_t n)
+{
+    return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static size_t header_size(size_t n_section)
+{
+    return 8 + 2 * sizeof(uint32_t) + FLM_BINFILE_NUM_OF_COUNT * sizeof(uint64_t) + 2 * n_section * sizeof(uint64_t);
+}
+
+bool host_is_little_endian()
+{
+    const uint16_t x = 1;
+    unsigned char b;
+    std::memcpy(&b, &x, 1);
+    return b == 1;
+}
+
+/**
+ * Check the leading bytes of a file without reading the rest.
+ * @param path Path to the file.
+ * @param magic 8-byte identifier.
+ * @return true if the file starts with "magic".
+ */
+bool has_magic(const std::string &path, const char *magic)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (in.fail())
+        return false;
+
+    char buf[8];
+    in.read(buf, 8);
+    return in.gcount() == 8 && std::memcmp(buf, magic, 8) == 0;
+}
+
+/**
+ * Write the whole buffer at "offset", retrying on partial writes.
+ */
+void write_at(int fd, const char *buf, size_t n, uint64_t offset, const std::string &path)
+{
+    size_t done = 0;
+    while (done < n)
+    {
+        const ssize_t ret = pwrite(fd, buf + done, n - done, offset + done);
+        if (ret < 0)
+            throw std::runtime_error("Failed to write \"" + path + "\".");
+        done += ret;
+    }
+}
+
+/**
+ * Read exactly "n" bytes at "offset".
+ */
+void read_at(int fd, char *buf, size_t n, uint64_t offset, const std::string &path)
+{
+    size_t done = 0;
+    while (done < n)
+    {
+        const ssize_t ret = pread(fd, buf + done, n - done, offset + done);
+        if (ret < 0)
+            throw std::runtime_error("Failed to read \"" + path + "\".");
+        if (ret == 0)
+            throw invalid_file_format(path, "unexpected end of file.");
+        done += ret;
+    }
+}
+
+SectionWriter::SectionWriter(const char *magic, uint32_t version, size_t n_section) :
+    version(version),
+    count(FLM_BINFILE_NUM_OF_COUNT, 0),
+    payload(n_section)
+{
+    std::memcpy(this->magic, magic, 8);
+}
+
+/**
+ * Dump header, section table and all payloads in one sequential stream.
+ * @param path Path to the output file.
+ */
+void SectionWriter::write(const std::string &path) const
+{
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary output is only supported on little-endian hosts.");
+
+    const uint32_t n_section = payload.size();
+    std::vector<uint64_t> table(2 * n_section);
+    size_t pos = aligned(header_size(n_section));
+    for (size_t k = 0; k < n_section; ++k)
+    {
+        table[2 * k] = pos;
+        table[2 * k + 1] = payload[k].size();
+        pos = aligned(pos + payload[k].size());
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (out.fail())
+        throw failed_to_open_file(path);
+
+    static const char PADDING[ALIGNMENT] = {0};
+    out.write(magic, 8);
+    out.write(reinterpret_cast<const char *>(&version), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char *>(&n_section), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char *>(count.data()), count.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(uint64_t));
+    out.write(PADDING, aligned(header_size(n_section)) - header_size(n_section));
+    for (const auto &e : payload)
+    {
+        out.write(e.data(), e.size());
+        out.write(PADDING, aligned(e.size()) - e.size());
+    }
+
+    if (out.fail())
+        throw std::runtime_error("Failed to write \"" + path + "\".");
+}
+
+/**
+ * Map a binary file and validate its header and section table.
+ * Payloads are accessed in place, nothing is copied.
+ * @param path Path to the input file.
+ * @param magic Expected 8-byte identifier.
+ * @param version Expected layout version.
+ * @param n_section Expected number of sections.
+ */
+SectionReader::SectionReader(const std::string &path, const char *magic, uint32_t version, size_t n_section) :
+    path(path),
+    src(path),
+    count(FLM_BINFILE_NUM_OF_COUNT),
+    offset(n_section),
+    bytes(n_section)
+{
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary input is only supported on little-endian hosts.");
+
+    if (src.size() < header_size(n_section))
+        throw invalid_file_format(path, "truncated header.");
+
+    const char *p = src.data();
+    if (std::memcmp(p, magic, 8) != 0)
+        throw invalid_file_format(path, "unrecognized identifier.");
+    p += 8;
+
+    uint32_t file_version, file_n_section;
+    std::memcpy(&file_version, p, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+    std::memcpy(&file_n_section, p, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+    if (file_version != version)
+        throw invalid_file_format(path, "version " + std::to_string(file_version) + " is not supported, expecting " + std::to_string(version) + ".");
+    if (file_n_section != n_section)
+        throw invalid_file_format(path, "unexpected number of sections.");
+
+    std::memcpy(count.data(), p, FLM_BINFILE_NUM_OF_COUNT * sizeof(uint64_t));
+    p += FLM_BINFILE_NUM_OF_COUNT * sizeof(uint64_t);
+
+    for (size_t k = 0; k < n_section; ++k)
+    {
+        std::memcpy(&offset[k], p, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+        std::memcpy(&bytes[k], p, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+
+        if (offset[k] % ALIGNMENT || offset[k] > src.size() || bytes[k] > src.size() - offset[k])
+            throw invalid_file_format(path, "section " + std::to_string(k) + " is out of bounds.");
+    }
+}
@@ -0,0 +1,469 @@
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/binfile.h"
+#include "../inc/binmesh.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const char MAGIC[8] = {'D', '3', 'D', 'M', 'E', 'S', 'H', 'B'};
+
+/// Counts stored in the header.
+enum : size_t
+{
+    NUM_OF_NODE = 0,
+    NUM_OF_FACE = 1,
+    NUM_OF_CELL = 2,
+    NUM_OF_PATCH = 3
+};
+
+/// Sections, in file order.
+/// Entity references are 1-based as in the text format, and 0 stands for "empty".
+enum : size_t
+{
+    NODE_FLAG = 0, /// uint8[N]
+    NODE_COORD, /// double[3N]
+    NODE_CELL_PTR, /// uint64[N+1]
+    NODE_CELL_IDX, /// uint32[]
+    FACE_FLAG, /// uint8[F]
+    FACE_CENTROID, /// double[3F]
+    FACE_AREA, /// double[F]
+    FACE_NODE_PTR, /// uint64[F+1]
+    FACE_NODE_IDX, /// uint32[]
+    FACE_CELL, /// uint32[2F], c0 and c1
+    FACE_NORMAL, /// double[6F], n01 and n10
+    CELL_SHAPE, /// uint8[C]
+    CELL_CENTROID, /// double[3C]
+    CELL_VOLUME, /// double[C]
+    CELL_NODE_PTR, /// uint64[C+1]
+    CELL_NODE_IDX, /// uint32[]
+    CELL_FACE_PTR, /// uint64[C+1]
+    CELL_FACE_IDX, /// uint32[]
+    CELL_ADJ_IDX, /// uint32[], shares CELL_FACE_PTR
+    CELL_S, /// double[3 * len(CELL_FACE_IDX)], area-weighted outward normals
+    PATCH_NAME_PTR, /// uint64[P+1]
+    PATCH_NAME_CHAR, /// char[]
+    PATCH_FACE_PTR, /// uint64[P+1]
+    PATCH_FACE_IDX, /// uint32[]
+    PATCH_NODE_PTR, /// uint64[P+1]
+    PATCH_NODE_IDX, /// uint32[]
+    NUM_OF_SECTION
+};
+
+/**
+ * Number of nodes and faces of a cell, following the shape codes of the text format.
+ */
+static bool decode_cell_shape(int shape, int &N1, int &N2)
+{
+    switch (shape)
+    {
+    case 2: /// tet
+        N1 = 4;
+        N2 = 4;
+        return true;
+    case 4: /// hex
+        N1 = 8;
+        N2 = 6;
+        return true;
+    case 5: /// pyr
+        N1 = 5;
+        N2 = 5;
+        return true;
+    case 6: /// wedge
+        N1 = 6;
+        N2 = 5;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static int encode_cell_shape(size_t i, size_t N1, size_t N2)
+{
+    for (int shape : {2, 4, 5, 6})
+    {
+        int n1, n2;
+        decode_cell_shape(shape, n1, n2);
+        if (N1 == static_cast<size_t>(n1) && N2 == static_cast<size_t>(n2))
+            return shape;
+    }
+    throw unsupported_shape("cell", i, static_cast<int>(N1));
+}
+
+bool is_binary_mesh(const std::string &path)
+{
+    return has_magic(path, MAGIC);
+}
+
+/**
+ * Check a CSR pointer array.
+ * @return true if it starts from 0, never decreases and ends at "n_idx".
+ */
+static bool valid_csr(const uint64_t *ptr, size_t n, size_t n_idx)
+{
+    if (ptr[0] != 0 || ptr[n] != n_idx)
+        return false;
+
+    for (size_t i = 0; i < n; ++i)
+        if (ptr[i] > ptr[i + 1])
+            return false;
+
+    return true;
+}
+
+/**
+ * Check that every reference lies within [lo, hi].
+ */
+static bool valid_idx(const uint32_t *idx, size_t n, uint32_t lo, uint64_t hi)
+{
+    bool ok = true;
+
+#pragma omp parallel for reduction(&&:ok)
+    for (size_t i = 0; i < n; ++i)
+        ok = ok && idx[i] >= lo && idx[i] <= hi;
+
+    return ok;
+}
+
+/**
+ * Load computation mesh in binary format.
+ * The file is mapped into memory and entities are filled directly from the mapped sections.
+ * All references are validated before any entity is filled, so the filling loops can run in parallel.
+ * @param path Path to the binary mesh file.
+ */
+void read_mesh_binary(const std::string &path)
+{
+    FLM_PROFILE("read_mesh_binary");
+    SectionReader src(path, MAGIC, FLM_BINMESH_VERSION, NUM_OF_SECTION);
+
+    const size_t NumOfNode = src.get_count(NUM_OF_NODE);
+    const size_t NumOfFace = src.get_count(NUM_OF_FACE);
+    const size_t NumOfCell = src.get_count(NUM_OF_CELL);
+    const size_t NumOfPatch = src.get_count(NUM_OF_PATCH);
+
+    /// Views of all sections
+    auto node_flag = src.get<uint8_t>(NODE_FLAG, NumOfNode);
+    auto node_coord = src.get<double>(NODE_COORD, 3 * NumOfNode);
+    auto node_cell_ptr = src.get<uint64_t>(NODE_CELL_PTR, NumOfNode + 1);
+    auto node_cell_idx = src.get<uint32_t>(NODE_CELL_IDX, src.length<uint32_t>(NODE_CELL_IDX));
+
+    auto face_flag = src.get<uint8_t>(FACE_FLAG, NumOfFace);
+    auto face_centroid = src.get<double>(FACE_CENTROID, 3 * NumOfFace);
+    auto face_area = src.get<double>(FACE_AREA, NumOfFace);
+    auto face_node_ptr = src.get<uint64_t>(FACE_NODE_PTR, NumOfFace + 1);
+    auto face_node_idx = src.get<uint32_t>(FACE_NODE_IDX, src.length<uint32_t>(FACE_NODE_IDX));
+    auto face_cell = src.get<uint32_t>(FACE_CELL, 2 * NumOfFace);
+    auto face_normal = src.get<double>(FACE_NORMAL, 6 * NumOfFace);
+
+    auto cell_shape = src.get<uint8_t>(CELL_SHAPE, NumOfCell);
+    auto cell_centroid = src.get<double>(CELL_CENTROID, 3 * NumOfCell);
+    auto cell_volume = src.get<double>(CELL_VOLUME, NumOfCell);
+    auto cell_node_ptr = src.get<uint64_t>(CELL_NODE_PTR, NumOfCell + 1);
+    auto cell_node_idx = src.get<uint32_t>(CELL_NODE_IDX, src.length<uint32_t>(CELL_NODE_IDX));
+    auto cell_face_ptr = src.get<uint64_t>(CELL_FACE_PTR, NumOfCell + 1);
+    const size_t n_cell_face = src.length<uint32_t>(CELL_FACE_IDX);
+    auto cell_face_idx = src.get<uint32_t>(CELL_FACE_IDX, n_cell_face);
+    auto cell_adj_idx = src.get<uint32_t>(CELL_ADJ_IDX, n_cell_face);
+    auto cell_S = src.get<double>(CELL_S, 3 * n_cell_face);
+
+    auto patch_name_ptr = src.get<uint64_t>(PATCH_NAME_PTR, NumOfPatch + 1);
+    auto patch_name_char = src.get<char>(PATCH_NAME_CHAR, src.length<char>(PATCH_NAME_CHAR));
+    auto patch_face_ptr = src.get<uint64_t>(PATCH_FACE_PTR, NumOfPatch + 1);
+    auto patch_face_idx = src.get<uint32_t>(PATCH_FACE_IDX, src.length<uint32_t>(PATCH_FACE_IDX));
+    auto patch_node_ptr = src.get<uint64_t>(PATCH_NODE_PTR, NumOfPatch + 1);
+    auto patch_node_idx = src.get<uint32_t>(PATCH_NODE_IDX, src.length<uint32_t>(PATCH_NODE_IDX));
+
+    /// Structural checks
+    if (!valid_csr(node_cell_ptr, NumOfNode, src.length<uint32_t>(NODE_CELL_IDX)) ||
+        !valid_csr(face_node_ptr, NumOfFace, src.length<uint32_t>(FACE_NODE_IDX)) ||
+        !valid_csr(cell_node_ptr, NumOfCell, src.length<uint32_t>(CELL_NODE_IDX)) ||
+        !valid_csr(cell_face_ptr, NumOfCell, n_cell_face) ||
+        !valid_csr(patch_name_ptr, NumOfPatch, src.length<char>(PATCH_NAME_CHAR)) ||
+        !valid_csr(patch_face_ptr, NumOfPatch, src.length<uint32_t>(PATCH_FACE_IDX)) ||
+        !valid_csr(patch_node_ptr, NumOfPatch, src.length<uint32_t>(PATCH_NODE_IDX)))
+        throw invalid_file_format(path, "corrupted connectivity offsets.");
+
+    if (!valid_idx(node_cell_idx, src.length<uint32_t>(NODE_CELL_IDX), 1, NumOfCell) ||
+        !valid_idx(face_node_idx, src.length<uint32_t>(FACE_NODE_IDX), 1, NumOfNode) ||
+        !valid_idx(face_cell, 2 * NumOfFace, 0, NumOfCell) ||
+        !valid_idx(cell_node_idx, src.length<uint32_t>(CELL_NODE_IDX), 1, NumOfNode) ||
+        !valid_idx(cell_face_idx, n_cell_face, 1, NumOfFace) ||
+        !valid_idx(cell_adj_idx, n_cell_face, 0, NumOfCell) ||
+        !valid_idx(patch_face_idx, src.length<uint32_t>(PATCH_FACE_IDX), 1, NumOfFace) ||
+        !valid_idx(patch_node_idx, src.length<uint32_t>(PATCH_NODE_IDX), 1, NumOfNode))
+        throw invalid_file_format(path, "entity reference out of range.");
+
+    for (size_t i = 0; i < NumOfNode; ++i)
+        if (node_flag[i] > 1)
+            throw invalid_boundary_flag("node", i + 1, node_flag[i]);
+
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        if (face_flag[i] > 1)
+            throw invalid_boundary_flag("face", i + 1, face_flag[i]);
+
+        const auto shape = face_node_ptr[i + 1] - face_node_ptr[i];
+        if (shape != 3 && shape != 4)
+            throw unsupported_shape("face", i + 1, static_cast<int>(shape));
+    }
+
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        int N1, N2;
+        if (!decode_cell_shape(cell_shape[i], N1, N2))
+            throw unsupported_shape("cell", i + 1, cell_shape[i]);
+        if (cell_node_ptr[i + 1] - cell_node_ptr[i] != static_cast<uint64_t>(N1) ||
+            cell_face_ptr[i + 1] - cell_face_ptr[i] != static_cast<uint64_t>(N2))
+            throw inconsistent_connectivity("Shape of cell " + std::to_string(i + 1) + " does not match its connectivity.");
+    }
+
+    /// Allocate memory for geom entities.
+    node.resize(NumOfNode);
+    face.resize(NumOfFace);
+    cell.resize(NumOfCell);
+    patch.resize(NumOfPatch);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
+        node[i] = new Node();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        cell[i] = new Cell();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        if (face_flag[i])
+            face[i] = new BoundaryFace();
+        else
+            face[i] = new InternalFace();
+    }
+
+    /// Update nodal information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
+    {
+        auto n_dst = node[i];
+        n_dst->index = i + 1;
+        n_dst->at_boundary = node_flag[i] == 1;
+        n_dst->coordinate << node_coord[3 * i], node_coord[3 * i + 1], node_coord[3 * i + 2];
+
+        const size_t j0 = node_cell_ptr[i], N = node_cell_ptr[i + 1] - j0;
+        n_dst->cell_dependency.resize(N);
+        for (size_t j = 0; j < N; ++j)
+            n_dst->cell_dependency[j] = cell[node_cell_idx[j0 + j] - 1];
+
+        n_dst->cell_weighting1.resize(N);
+        n_dst->cell_weighting2.resize(N);
+        n_dst->cell_weighting3.resize(N);
+        n_dst->cell_weighting4.resize(N);
+    }
+
+    /// Update face information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        auto f_dst = face[i];
+        f_dst->parent = nullptr;
+        f_dst->index = i + 1;
+        f_dst->centroid << face_centroid[3 * i], face_centroid[3 * i + 1], face_centroid[3 * i + 2];
+        f_dst->area = face_area[i];
+
+        const size_t j0 = face_node_ptr[i], N = face_node_ptr[i + 1] - j0;
+        f_dst->vertex.resize(N);
+        for (size_t j = 0; j < N; ++j)
+            f_dst->vertex[j] = node[face_node_idx[j0 + j] - 1];
+
+        const auto c0 = face_cell[2 * i], c1 = face_cell[2 * i + 1];
+        f_dst->c0 = (c0 == 0) ? nullptr : cell[c0 - 1];
+        f_dst->c1 = (c1 == 0) ? nullptr : cell[c1 - 1];
+
+        const double *n = face_normal + 6 * i;
+        f_dst->n01 << n[0], n[1], n[2];
+        f_dst->n10 << n[3], n[4], n[5];
+    }
+
+    /// Update cell information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c_dst = cell[i];
+        c_dst->index = i + 1;
+        c_dst->centroid << cell_centroid[3 * i], cell_centroid[3 * i + 1], cell_centroid[3 * i + 2];
+        c_dst->volume = cell_volume[i];
+
+        const size_t k0 = cell_node_ptr[i], N1 = cell_node_ptr[i + 1] - k0;
+        c_dst->vertex.resize(N1);
+        for (size_t j = 0; j < N1; ++j)
+            c_dst->vertex[j] = node[cell_node_idx[k0 + j] - 1];
+
+        const size_t j0 = cell_face_ptr[i], N2 = cell_face_ptr[i + 1] - j0;
+        c_dst->surface.resize(N2);
+        c_dst->cell_adjacency.resize(N2);
+        c_dst->S.resize(N2);
+        for (size_t j = 0; j < N2; ++j)
+        {
+            c_dst->surface[j] = face[cell_face_idx[j0 + j] - 1];
+            const auto adj = cell_adj_idx[j0 + j];
+            c_dst->cell_adjacency[j] = (adj == 0) ? nullptr : cell[adj - 1];
+            const double *S = cell_S + 3 * (j0 + j);
+            c_dst->S[j] << S[0], S[1], S[2];
+        }
+
+        c_dst->d.resize(N2);
+        c_dst->S_E.resize(N2);
+        c_dst->S_T.resize(N2);
+    }
+
+    /// Update boundary patch information.
+    for (size_t i = 0; i < NumOfPatch; ++i)
+    {
+        auto p_dst = patch[i] = new Patch();
+        p_dst->name.assign(patch_name_char + patch_name_ptr[i], patch_name_ptr[i + 1] - patch_name_ptr[i]);
+
+        const size_t j0 = patch_face_ptr[i], n_face = patch_face_ptr[i + 1] - j0;
+        p_dst->surface.resize(n_face);
+        for (size_t j = 0; j < n_face; ++j)
+        {
+            const auto idx = patch_face_idx[j0 + j];
+            auto f_b = dynamic_cast<BoundaryFace *>(face[idx - 1]);
+            if (f_b == nullptr)
+                throw wrong_face(idx);
+
+            p_dst->surface[j] = f_b;
+            f_b->parent = p_dst;
+        }
+
+        const size_t k0 = patch_node_ptr[i], n_node = patch_node_ptr[i + 1] - k0;
+        p_dst->vertex.resize(n_node);
+        for (size_t j = 0; j < n_node; ++j)
+            p_dst->vertex[j] = node[patch_node_idx[k0 + j] - 1];
+    }
+}
+
+/**
+ * Append one list of references to a CSR pair.
+ */
+template<typename T, typename F>
+static void append_csr(std::vector<uint64_t> &ptr, std::vector<uint32_t> &idx, const std::vector<T *> &src, F to_idx)
+{
+    for (auto e : src)
+        idx.push_back(to_idx(e));
+    ptr.push_back(idx.size());
+}
+
+/**
+ * Dump the loaded mesh in binary format.
+ * @param path Path to the output file.
+ */
+void write_mesh_binary(const std::string &path)
+{
+    FLM_PROFILE("write_mesh_binary");
+    if (std::max({node.size(), face.size(), cell.size()}) > UINT32_MAX)
+        throw std::overflow_error("Too many entities for 32-bit references.");
+
+    SectionWriter dst(MAGIC, FLM_BINMESH_VERSION, NUM_OF_SECTION);
+    dst.set_count(NUM_OF_NODE, node.size());
+    dst.set_count(NUM_OF_FACE, face.size());
+    dst.set_count(NUM_OF_CELL, cell.size());
+    dst.set_count(NUM_OF_PATCH, patch.size());
+
+    auto cell_ref = [](const Cell *c) { return c == nullptr ? uint32_t(0) : uint32_t(c->index); };
+    auto node_ref = [](const Node *n) { return uint32_t(n->index); };
+    auto face_ref = [](const Face *f) { return uint32_t(f->index); };
+
+    {
+        std::vector<uint8_t> flag;
+        std::vector<double> coord;
+        std::vector<uint64_t> ptr{0};
+        std::vector<uint32_t> idx;
+        for (auto n : node)
+        {
+            flag.push_back(n->at_boundary ? 1 : 0);
+            coord.insert(coord.end(), n->coordinate.data(), n->coordinate.data() + 3);
+            append_csr(ptr, idx, n->cell_dependency, cell_ref);
+        }
+        dst.put(NODE_FLAG, flag);
+        dst.put(NODE_COORD, coord);
+        dst.put(NODE_CELL_PTR, ptr);
+        dst.put(NODE_CELL_IDX, idx);
+    }
+
+    {
+        std::vector<uint8_t> flag;
+        std::vector<double> centroid, area, normal;
+        std::vector<uint64_t> ptr{0};
+        std::vector<uint32_t> idx, adj;
+        for (auto f : face)
+        {
+            flag.push_back(f->at_boundary() ? 1 : 0);
+            centroid.insert(centroid.end(), f->centroid.data(), f->centroid.data() + 3);
+            area.push_back(f->area);
+            append_csr(ptr, idx, f->vertex, node_ref);
+            adj.push_back(cell_ref(f->c0));
+            adj.push_back(cell_ref(f->c1));
+            normal.insert(normal.end(), f->n01.data(), f->n01.data() + 3);
+            normal.insert(normal.end(), f->n10.data(), f->n10.data() + 3);
+        }
+        dst.put(FACE_FLAG, flag);
+        dst.put(FACE_CENTROID, centroid);
+        dst.put(FACE_AREA, area);
+        dst.put(FACE_NODE_PTR, ptr);
+        dst.put(FACE_NODE_IDX, idx);
+        dst.put(FACE_CELL, adj);
+        dst.put(FACE_NORMAL, normal);
+    }
+
+    {
+        std::vector<uint8_t> shape;
+        std::vector<double> centroid, volume, S;
+        std::vector<uint64_t> node_ptr{0}, face_ptr{0};
+        std::vector<uint32_t> node_idx, face_idx, adj_idx;
+        for (auto c : cell)
+        {
+            shape.push_back(encode_cell_shape(c->index, c->vertex.size(), c->surface.size()));
+            centroid.insert(centroid.end(), c->centroid.data(), c->centroid.data() + 3);
+            volume.push_back(c->volume);
+            append_csr(node_ptr, node_idx, c->vertex, node_ref);
+            append_csr(face_ptr, face_idx, c->surface, face_ref);
+            for (auto e : c->cell_adjacency)
+                adj_idx.push_back(cell_ref(e));
+            for (const auto &e : c->S)
+                S.insert(S.end(), e.data(), e.data() + 3);
+        }
+        dst.put(CELL_SHAPE, shape);
+        dst.put(CELL_CENTROID, centroid);
+        dst.put(CELL_VOLUME, volume);
+        dst.put(CELL_NODE_PTR, node_ptr);
+        dst.put(CELL_NODE_IDX, node_idx);
+        dst.put(CELL_FACE_PTR, face_ptr);
+        dst.put(CELL_FACE_IDX, face_idx);
+        dst.put(CELL_ADJ_IDX, adj_idx);
+        dst.put(CELL_S, S);
+    }
+
+    {
+        std::vector<uint64_t> name_ptr{0}, face_ptr{0}, node_ptr{0};
+        std::vector<char> name;
+        std::vector<uint32_t> face_idx, node_idx;
+        for (auto p : patch)
+        {
+            name.insert(name.end(), p->name.begin(), p->name.end());
+            name_ptr.push_back(name.size());
+            append_csr(face_ptr, face_idx, p->surface, face_ref);
+            append_csr(node_ptr, node_idx, p->vertex, node_ref);
+        }
+        dst.put(PATCH_NAME_PTR, name_ptr);
+        dst.put(PATCH_NAME_CHAR, name);
+        dst.put(PATCH_FACE_PTR, face_ptr);
+        dst.put(PATCH_FACE_IDX, face_idx);
+        dst.put(PATCH_NODE_PTR, node_ptr);
+        dst.put(PATCH_NODE_IDX, node_idx);
+    }
+
+    dst.write(path);
+}
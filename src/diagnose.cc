@@ -1,12 +1,61 @@
+#include <cmath>
+#include <limits>
 #include "../inc/element.h"
+#include "../inc/reduction.h"
 #include "../inc/diagnose.h"
+#include "../inc/spatial.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
 extern std::vector<Face *> face;
 extern std::vector<Cell *> cell;
 
-void diagnose(bool diverged)
+static FLM_DIAGNOSIS record;
+
+/**
+ * Evaluate global quantities of the current field.
+ * All sums go through "reduce_sum", so results are reproducible regardless of thread count.
+ * @param diverged Set to true if any global quantity is NOT finite.
+ */
+void diagnose(bool &diverged)
+{
+    FLM_PROFILE("diagnose");
+    const size_t NumOfCell = cell.size();
+
+    FLM_SCALAR T_min = std::numeric_limits<FLM_SCALAR>::max();
+    FLM_SCALAR T_max = std::numeric_limits<FLM_SCALAR>::lowest();
+#pragma omp parallel reduction(min:T_min) reduction(max:T_max)
+    {
+        FLM_PROFILE("diagnose.range");
+#pragma omp for nowait
+        for (size_t i = 0; i < NumOfCell; ++i)
+        {
+            T_min = std::min(T_min, cell[i]->T);
+            T_max = std::max(T_max, cell[i]->T);
+        }
+    }
+    record.T_min = T_min;
+    record.T_max = T_max;
+
+    record.volume = reduce_sum(NumOfCell, [](size_t i) { return cell[i]->volume; });
+    const FLM_SCALAR T_int = reduce_sum(NumOfCell, [](size_t i) { return cell[i]->volume * cell[i]->T; });
+    const FLM_SCALAR T2_int = reduce_sum(NumOfCell, [](size_t i) { return cell[i]->volume * cell[i]->T * cell[i]->T; });
+    record.T_mean = T_int / record.volume;
+    record.T_rms = std::sqrt(T2_int / record.volume);
+
+    /// Boundary faces are visited in global order, so the result does not depend on patch layout.
+    record.heat_flux = reduce_sum(face.size(), [](size_t i) {
+        auto f = face[i];
+        if (!f->at_boundary())
+            return 0.0;
+        return boundary_flux(static_cast<BoundaryFace *>(f));
+    }, FLM_REDUCTION::Compensated);
+
+    diverged = !std::isfinite(record.T_mean) || !std::isfinite(record.T_rms) || !std::isfinite(record.heat_flux);
+}
+
+const FLM_DIAGNOSIS &last_diagnosis()
 {
-    /// TODO
-}
\ No newline at end of file
+    return record;
+}
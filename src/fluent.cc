@@ -0,0 +1,437 @@
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/mapped.h"
+#include "../inc/binfile.h"
+#include "../inc/topology.h"
+#include "../inc/io.h"
+#include "../inc/profile.h"
+
+/// Section indices, see the "Mesh File Format" chapter of the FLUENT User's Guide.
+enum : int
+{
+    FLUENT_COMMENT = 0,
+    FLUENT_HEADER = 1,
+    FLUENT_DIMENSION = 2,
+    FLUENT_NODE = 10,
+    FLUENT_CELL = 12,
+    FLUENT_FACE = 13,
+    FLUENT_ZONE = 39,
+    FLUENT_ZONE_NAME = 45,
+    FLUENT_SINGLE = 2000, /// Offset of binary sections in single precision
+    FLUENT_DOUBLE = 3000 /// Offset of binary sections in double precision
+};
+
+/// Face zones of this type are internal, all others become patches.
+static const int FLUENT_INTERIOR = 2;
+
+/// Face shapes; in mixed zones each face leads with its own, triangles and quadrilaterals
+/// being coded by their number of nodes
+static const int FLUENT_MIXED = 0;
+static const int FLUENT_TRIANGLE = 3;
+static const int FLUENT_QUADRILATERAL = 4;
+static const int FLUENT_POLYGON = 5;
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * Sequential scan over the S-expression-like sections of a FLUENT mesh.
+ * Integers in headers and ASCII connectivity are hexadecimal, except the section index
+ * and the zone names in sections 39 and 45.
+ * Binary payloads are little-endian and start right after the opening parenthesis.
+ */
+class FluentScanner
+{
+public:
+    FluentScanner(const char *begin, const char *end, const std::string &fn) :
+        pos(begin),
+        begin(begin),
+        end(end),
+        fn(fn)
+    {}
+
+    bool exhausted()
+    {
+        skip_space();
+        return pos == end;
+    }
+
+    void expect(char c)
+    {
+        skip_space();
+        if (pos == end || *pos != c)
+            fail(std::string("expecting '") + c + "'");
+        ++pos;
+    }
+
+    /// Consume "c" if it is the next non-blank character.
+    bool accept(char c)
+    {
+        skip_space();
+        if (pos < end && *pos == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    T get(int base)
+    {
+        skip_space();
+        T ret;
+        const auto res = std::from_chars(pos, end, ret, base);
+        if (res.ec != std::errc())
+            fail("invalid integer");
+        pos = res.ptr;
+        return ret;
+    }
+
+    double get_real()
+    {
+        skip_space();
+        double ret;
+        const auto res = std::from_chars(pos, end, ret);
+        if (res.ec != std::errc())
+            fail("invalid real number");
+        pos = res.ptr;
+        return ret;
+    }
+
+    std::string get_token()
+    {
+        skip_space();
+        const char *b = pos;
+        while (pos < end && !is_space(*pos) && *pos != '(' && *pos != ')')
+            ++pos;
+        return std::string(b, pos);
+    }
+
+    /// Raw little-endian value within a binary payload.
+    template<typename T>
+    T get_binary()
+    {
+        if (static_cast<size_t>(end - pos) < sizeof(T))
+            fail("truncated binary section");
+        T ret;
+        std::memcpy(&ret, pos, sizeof(T));
+        pos += sizeof(T);
+        return ret;
+    }
+
+    /**
+     * Skip to the parenthesis closing the current level, honoring nested groups and strings.
+     * Not valid within binary payloads.
+     */
+    void close()
+    {
+        int depth = 0;
+        while (pos < end)
+        {
+            const char c = *pos++;
+            if (c == '"')
+            {
+                while (pos < end && *pos != '"')
+                    ++pos;
+                if (pos < end)
+                    ++pos;
+            }
+            else if (c == '(')
+                ++depth;
+            else if (c == ')')
+            {
+                if (depth == 0)
+                    return;
+                --depth;
+            }
+        }
+        fail("unbalanced parenthesis");
+    }
+
+    /**
+     * Skip the rest of a binary section of index "id", whose payload is of unknown size,
+     * by searching for its trailer "End of Binary Section <id>)".
+     */
+    void close_binary(int id)
+    {
+        static const char TRAILER[] = "End of Binary Section";
+        const std::string idx = std::to_string(id);
+        while (true)
+        {
+            const char *hit = std::search(pos, end, TRAILER, TRAILER + sizeof(TRAILER) - 1);
+            if (hit == end)
+                fail("missing end of binary section " + idx);
+            pos = hit + sizeof(TRAILER) - 1;
+            if (get_token() == idx && accept(')'))
+                return;
+        }
+    }
+
+    [[noreturn]] void fail(const std::string &msg) const
+    {
+        throw invalid_file_format(fn, msg + " at byte " + std::to_string(pos - begin) + ".");
+    }
+
+private:
+    void skip_space()
+    {
+        while (pos < end && is_space(*pos))
+            ++pos;
+    }
+
+    const char *pos;
+    const char *begin;
+    const char *end;
+    const std::string &fn;
+};
+
+/// Faces of one section, kept until all sections are known.
+struct FluentFaceBlock
+{
+    size_t first, last;
+    std::vector<uint32_t> n_vertex;
+    std::vector<uint32_t> vertex;
+};
+
+/// Face zone, becoming a patch unless interior.
+struct FluentFaceZone
+{
+    int type;
+    size_t first, last;
+};
+
+bool is_fluent_mesh(const std::string &path)
+{
+    MappedFile src(path);
+    const char *p = src.data(), *end = p + src.size();
+    while (p < end && is_space(*p))
+        ++p;
+    return p < end && *p == '(';
+}
+
+/**
+ * Load computation mesh directly from a FLUENT mesh file (".msh"), ASCII or binary.
+ * Nodes (10), cells (12), faces (13) and zone names (39, 45) are used; other sections are skipped.
+ * The face-based description is handed to "build_mesh", which derives the remaining connectivity
+ * and the geometric quantities in memory.
+ * Only 3D meshes are supported.
+ * @param path Path to the FLUENT mesh file.
+ */
+void read_mesh_fluent(const std::string &path)
+{
+    FLM_PROFILE("read_mesh_fluent");
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary input is only supported on little-endian hosts.");
+
+    MappedFile src(path);
+    FluentScanner in(src.data(), src.data() + src.size(), path);
+
+    std::vector<double> coordinate;
+    size_t NumOfNode = 0, NumOfCell = 0;
+    std::vector<FluentFaceBlock> block;
+    std::vector<uint32_t> face_cell;
+    std::map<int, FluentFaceZone> face_zone;
+    std::map<int, std::string> zone_name;
+
+    while (!in.exhausted())
+    {
+        in.expect('(');
+        const int id = in.get<int>(10);
+        const int base = id % 1000;
+        const bool binary = id >= FLUENT_SINGLE;
+        const bool single = binary && id < FLUENT_DOUBLE;
+
+        if (id == FLUENT_DIMENSION)
+        {
+            const int dim = in.get<int>(10);
+            if (dim != 3)
+                in.fail("only 3D meshes are supported");
+            in.close();
+        }
+        else if (base == FLUENT_NODE)
+        {
+            in.expect('(');
+            const int zone = in.get<int>(16);
+            const size_t first = in.get<size_t>(16), last = in.get<size_t>(16);
+            in.get<int>(16);
+            int nd = 3;
+            if (!in.accept(')'))
+            {
+                nd = in.get<int>(16);
+                in.expect(')');
+            }
+            if (nd != 3)
+                in.fail("only 3D meshes are supported");
+
+            NumOfNode = std::max(NumOfNode, last);
+            if (in.accept(')'))
+                continue; /// Declaration of the total number, or an empty zone
+            if (zone == 0 || first == 0 || last < first)
+                in.fail("invalid node range");
+
+            coordinate.resize(3 * NumOfNode);
+            in.expect('(');
+            for (size_t i = first - 1; i < last; ++i)
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (!binary)
+                        coordinate[3 * i + k] = in.get_real();
+                    else if (single)
+                        coordinate[3 * i + k] = in.get_binary<float>();
+                    else
+                        coordinate[3 * i + k] = in.get_binary<double>();
+                }
+            in.expect(')');
+            if (binary)
+                in.close_binary(id);
+            else
+                in.expect(')');
+        }
+        else if (base == FLUENT_CELL)
+        {
+            in.expect('(');
+            in.get<int>(16);
+            in.get<size_t>(16);
+            const size_t last = in.get<size_t>(16);
+            NumOfCell = std::max(NumOfCell, last);
+
+            /// Cell shapes are implied by the faces
+            in.close();
+            if (in.accept(')'))
+                continue;
+            if (binary)
+                in.close_binary(id);
+            else
+                in.close();
+        }
+        else if (base == FLUENT_FACE)
+        {
+            in.expect('(');
+            const int zone = in.get<int>(16);
+            const size_t first = in.get<size_t>(16), last = in.get<size_t>(16);
+            const int bc = in.get<int>(16);
+            int shape = FLUENT_MIXED;
+            if (!in.accept(')'))
+            {
+                shape = in.get<int>(16);
+                in.expect(')');
+            }
+
+            if (in.accept(')'))
+                continue; /// Declaration of the total number, or an empty zone
+            if (zone == 0 || first == 0 || last < first)
+                in.fail("invalid face range");
+            if (shape != FLUENT_MIXED && shape != FLUENT_POLYGON && shape != FLUENT_TRIANGLE && shape != FLUENT_QUADRILATERAL)
+                in.fail("unsupported face shape " + std::to_string(shape));
+
+            face_zone[zone] = {bc, first, last};
+            face_cell.resize(std::max(face_cell.size(), 2 * last));
+
+            auto get_index = [&in, binary]() -> uint32_t {
+                return binary ? in.get_binary<uint32_t>() : in.get<uint32_t>(16);
+            };
+
+            block.push_back({first, last, {}, {}});
+            auto &dst = block.back();
+            dst.n_vertex.resize(last - first + 1);
+            dst.vertex.reserve(4 * (last - first + 1));
+            in.expect('(');
+            for (size_t i = first - 1; i < last; ++i)
+            {
+                uint32_t N = shape;
+                if (shape == FLUENT_POLYGON)
+                    N = get_index();
+                else if (shape == FLUENT_MIXED)
+                {
+                    /// Polygons would be ambiguous with a node count of 5, lines are not faces in 3D
+                    N = get_index();
+                    if (N != FLUENT_TRIANGLE && N != FLUENT_QUADRILATERAL)
+                        in.fail("unsupported face type " + std::to_string(N) + " in mixed zone");
+                }
+                dst.n_vertex[i - (first - 1)] = N;
+                for (uint32_t j = 0; j < N; ++j)
+                    dst.vertex.push_back(get_index());
+                face_cell[2 * i] = get_index();
+                face_cell[2 * i + 1] = get_index();
+            }
+            in.expect(')');
+            if (binary)
+                in.close_binary(id);
+            else
+                in.expect(')');
+        }
+        else if (id == FLUENT_ZONE || id == FLUENT_ZONE_NAME)
+        {
+            in.expect('(');
+            const int zone = in.get<int>(10);
+            in.get_token(); /// Zone type, already known from the face section
+            zone_name[zone] = in.get_token();
+            in.close();
+            in.close();
+        }
+        else if (binary)
+            in.close_binary(id);
+        else
+            in.close();
+    }
+
+    /// Faces in order of global index
+    std::sort(block.begin(), block.end(), [](const FluentFaceBlock &a, const FluentFaceBlock &b) {
+        return a.first < b.first;
+    });
+    size_t NumOfFace = 0;
+    for (const auto &e : block)
+    {
+        if (e.first != NumOfFace + 1)
+            throw invalid_file_format(path, "faces " + std::to_string(NumOfFace + 1) + " to " + std::to_string(e.first - 1) + " are missing or duplicated.");
+        NumOfFace = e.last;
+    }
+
+    std::vector<uint64_t> face_node_ptr(NumOfFace + 1, 0);
+    std::vector<uint32_t> face_node_idx;
+    for (const auto &e : block)
+    {
+        for (size_t i = e.first - 1; i < e.last; ++i)
+            face_node_ptr[i + 1] = face_node_ptr[i] + e.n_vertex[i - (e.first - 1)];
+        face_node_idx.insert(face_node_idx.end(), e.vertex.begin(), e.vertex.end());
+    }
+    block.clear();
+
+    for (size_t i = 0; i < 2 * NumOfFace; ++i)
+        NumOfCell = std::max<size_t>(NumOfCell, face_cell[i]);
+    if (coordinate.size() != 3 * NumOfNode)
+        throw invalid_file_format(path, "node coordinates are missing.");
+
+    /// Patches in order of zone index
+    FLM_FACE_MESH desc;
+    std::vector<uint64_t> patch_face_ptr(1, 0);
+    std::vector<uint32_t> patch_face_idx;
+    for (const auto &e : face_zone)
+    {
+        if (e.second.type == FLUENT_INTERIOR)
+            continue;
+
+        auto it = zone_name.find(e.first);
+        desc.patch_name.push_back(it == zone_name.end() ? "zone-" + std::to_string(e.first) : it->second);
+        for (size_t i = e.second.first; i <= e.second.last; ++i)
+            patch_face_idx.push_back(i);
+        patch_face_ptr.push_back(patch_face_idx.size());
+    }
+
+    desc.NumOfNode = NumOfNode;
+    desc.NumOfFace = NumOfFace;
+    desc.NumOfCell = NumOfCell;
+    desc.coordinate = coordinate.data();
+    desc.face_node_ptr = face_node_ptr.data();
+    desc.face_node_idx = face_node_idx.data();
+    desc.face_cell = face_cell.data();
+    desc.patch_face_ptr = patch_face_ptr.data();
+    desc.patch_face_idx = patch_face_idx.data();
+    build_mesh(desc);
+}
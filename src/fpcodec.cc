@@ -0,0 +1,190 @@
+#include <cstring>
+#include <cmath>
+#include "../inc/fpcodec.h"
+
+static_assert(sizeof(FLM_SCALAR) == sizeof(uint64_t), "Floating-point codecs assume 64-bit scalars.");
+
+static inline uint64_t to_bits(FLM_SCALAR x)
+{
+    uint64_t ret;
+    std::memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+static inline FLM_SCALAR from_bits(uint64_t x)
+{
+    FLM_SCALAR ret;
+    std::memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+/**
+ * Lossless encoding in the spirit of Gorilla, aligned to bytes.
+ * Each value is XOR-ed with its predecessor; neighbouring values of a smooth field share
+ * sign, exponent and leading mantissa bits, so the result has long runs of zero bytes at the top
+ * and, for "round" values, at the bottom.
+ * Per value, one control byte holds the number of leading (high nibble) and trailing (low nibble)
+ * zero bytes, followed by the remaining bytes in little-endian order.
+ * @param src Values to be encoded.
+ * @param n Number of values.
+ * @param dst Output buffer, appended to.
+ * @return Number of bytes appended.
+ */
+size_t encode_xor(const FLM_SCALAR *src, size_t n, std::vector<char> &dst)
+{
+    const size_t start = dst.size();
+    dst.resize(start + 9 * n);
+    char *p = dst.data() + start;
+
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint64_t cur = to_bits(src[i]);
+        const uint64_t x = cur ^ prev;
+        prev = cur;
+
+        if (x == 0)
+        {
+            *p++ = static_cast<char>(0x80);
+            continue;
+        }
+        const int lz = __builtin_clzll(x) / 8;
+        const int tz = __builtin_ctzll(x) / 8;
+        *p++ = static_cast<char>(lz << 4 | tz);
+        for (int k = tz; k < 8 - lz; ++k)
+            *p++ = static_cast<char>(x >> (8 * k));
+    }
+
+    dst.resize(p - dst.data());
+    return dst.size() - start;
+}
+
+/**
+ * Inverse of "encode_xor".
+ * @return "false" if "src" does not hold exactly "n" values.
+ */
+bool decode_xor(const char *src, size_t len, FLM_SCALAR *dst, size_t n)
+{
+    const char *p = src, *end = src + len;
+
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (p == end)
+            return false;
+        const int ctrl = static_cast<unsigned char>(*p++);
+        const int lz = ctrl >> 4, tz = ctrl & 0xF;
+        if (lz + tz > 8 || end - p < 8 - lz - tz)
+            return false;
+
+        uint64_t x = 0;
+        for (int k = tz; k < 8 - lz; ++k)
+            x |= uint64_t(static_cast<unsigned char>(*p++)) << (8 * k);
+        prev ^= x;
+        dst[i] = from_bits(prev);
+    }
+    return p == end;
+}
+
+/// Largest quantization index encoded as a residual, beyond which the value is stored verbatim.
+static const FLM_SCALAR MAX_INDEX = std::ldexp(1.0, 62);
+
+/**
+ * Lossy encoding with bounded point-wise error.
+ * Each value is predicted by the reconstruction of its predecessor, and the residual is
+ * quantized with a step of "2*tol", so the error never accumulates along the sequence.
+ * Indices are zigzag mapped and written as LEB128 varints shifted by one; index 0 escapes to
+ * a verbatim value, used for non-finite input, huge jumps and the rare case where rounding
+ * would push the reconstruction past the bound.
+ * @param src Values to be encoded.
+ * @param n Number of values.
+ * @param tol Maximum absolute error, positive.
+ * @param dst Output buffer, appended to.
+ * @return Number of bytes appended.
+ */
+size_t encode_quantized(const FLM_SCALAR *src, size_t n, FLM_SCALAR tol, std::vector<char> &dst)
+{
+    const FLM_SCALAR step = 2 * tol;
+
+    const size_t start = dst.size();
+    dst.resize(start + 10 * n);
+    char *p = dst.data() + start;
+
+    FLM_SCALAR prev = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const FLM_SCALAR v = src[i];
+        const FLM_SCALAR q = std::nearbyint((v - prev) / step);
+        const FLM_SCALAR r = prev + q * step;
+
+        uint64_t code = 0;
+        const bool verbatim = !(std::isfinite(v) && std::fabs(q) < MAX_INDEX && std::fabs(v - r) <= tol);
+        if (!verbatim)
+        {
+            const int64_t k = static_cast<int64_t>(q);
+            code = ((static_cast<uint64_t>(k) << 1) ^ static_cast<uint64_t>(k >> 63)) + 1;
+            prev = r;
+        }
+        else
+            prev = v;
+
+        do
+        {
+            const char b = static_cast<char>(code & 0x7F);
+            code >>= 7;
+            *p++ = code ? static_cast<char>(b | 0x80) : b;
+        } while (code);
+
+        if (verbatim)
+        {
+            std::memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        }
+    }
+
+    dst.resize(p - dst.data());
+    return dst.size() - start;
+}
+
+/**
+ * Inverse of "encode_quantized".
+ * @return "false" if "src" does not hold exactly "n" values.
+ */
+bool decode_quantized(const char *src, size_t len, FLM_SCALAR tol, FLM_SCALAR *dst, size_t n)
+{
+    const FLM_SCALAR step = 2 * tol;
+    const char *p = src, *end = src + len;
+
+    FLM_SCALAR prev = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t code = 0;
+        int shift = 0;
+        while (true)
+        {
+            if (p == end || shift > 63)
+                return false;
+            const unsigned char b = *p++;
+            code |= uint64_t(b & 0x7F) << shift;
+            shift += 7;
+            if (!(b & 0x80))
+                break;
+        }
+
+        if (code == 0)
+        {
+            if (end - p < static_cast<ptrdiff_t>(sizeof(FLM_SCALAR)))
+                return false;
+            std::memcpy(&prev, p, sizeof(prev));
+            p += sizeof(prev);
+        }
+        else
+        {
+            --code;
+            const int64_t k = static_cast<int64_t>(code >> 1) ^ -static_cast<int64_t>(code & 1);
+            prev += static_cast<FLM_SCALAR>(k) * step;
+        }
+        dst[i] = prev;
+    }
+    return p == end;
+}
@@ -3,7 +3,9 @@
 #include <cmath>
 #include "../inc/element.h"
 #include "../inc/noc.h"
+#include "../inc/reduction.h"
 #include "../inc/geom.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
@@ -12,61 +14,83 @@ extern std::vector<Cell *> cell;
 
 /**
  * Cell-to-Node interpolation coefficients.
+ * Storage is allocated when connectivity is loaded.
  */
-static void helper1()
+static void node_pass()
 {
-    for (auto n_dst : node)
+    FLM_PROFILE("node_pass");
+    const size_t NumOfNode = node.size();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
     {
+        auto n_dst = node[i];
         const size_t N = n_dst->cell_dependency.size();
 
-        /// Allocate storage
-        n_dst->cell_weighting1.resize(N);
-        n_dst->cell_weighting2.resize(N);
-        n_dst->cell_weighting3.resize(N);
-        n_dst->cell_weighting4.resize(N);
-
         /// Weighting1: 1/||r||
         /// Weighting2: 1/||r||^2
+        /// Weighting3: 1/V
         FLM_SCALAR s1 = 0.0;
         FLM_SCALAR s2 = 0.0;
+        FLM_SCALAR s3 = 0.0;
         for (size_t j = 0; j < N; ++j)
         {
-            auto curAdjCell = n_dst->cell_dependency.at(j);
+            auto curAdjCell = n_dst->cell_dependency[j];
             const FLM_SCALAR w = 1.0 / (n_dst->coordinate - curAdjCell->centroid).norm();
-            n_dst->cell_weighting1.at(j) = w;
-            n_dst->cell_weighting2.at(j) = w * w;
+            const FLM_SCALAR v = 1.0 / curAdjCell->volume;
+            n_dst->cell_weighting1[j] = w;
+            n_dst->cell_weighting2[j] = w * w;
+            n_dst->cell_weighting3[j] = v;
             s1 += w;
-            s2 += n_dst->cell_weighting2.at(j);
+            s2 += w * w;
+            s3 += v;
         }
-        for (auto &val : n_dst->cell_weighting1)
-            val /= s1;
-        for (auto &val : n_dst->cell_weighting2)
-            val /= s2;
-
-        /// Weighting3: 1/V
-        FLM_SCALAR s3 = 0.0;
         for (size_t j = 0; j < N; ++j)
         {
-            auto curAdjCell = n_dst->cell_dependency.at(j);
-            const FLM_SCALAR w = 1.0 / curAdjCell->volume;
-            n_dst->cell_weighting3.at(j) = w;
-            s3 += w;
+            n_dst->cell_weighting1[j] /= s1;
+            n_dst->cell_weighting2[j] /= s2;
+            n_dst->cell_weighting3[j] /= s3;
         }
-        for (auto &val : n_dst->cell_weighting3)
-            val /= s3;
 
         /// Weighting4: Linear preserving
-        /// TODO
+        /// Value at the node of the linear field fitted to dependent cells, weighted by 1/||r||^2,
+        /// so that "sum(w) = 1" and "sum(w * r) = 0".
+        /// Falls back to Weighting1 if the centroids do not span 3D, e.g. at corners.
+        Eigen::Matrix<FLM_SCALAR, 4, 4> A = Eigen::Matrix<FLM_SCALAR, 4, 4>::Zero();
+        for (size_t j = 0; j < N; ++j)
+        {
+            const FLM_VECTOR r = n_dst->cell_dependency[j]->centroid - n_dst->coordinate;
+            const Eigen::Matrix<FLM_SCALAR, 4, 1> row(1.0, r.x(), r.y(), r.z());
+            A.noalias() += row * row.transpose() / r.squaredNorm();
+        }
+        const Eigen::FullPivLU<Eigen::Matrix<FLM_SCALAR, 4, 4>> lu(A);
+        if (lu.isInvertible())
+        {
+            const Eigen::Matrix<FLM_SCALAR, 4, 1> e0 = lu.solve(Eigen::Matrix<FLM_SCALAR, 4, 1>::UnitX());
+            for (size_t j = 0; j < N; ++j)
+            {
+                const FLM_VECTOR r = n_dst->cell_dependency[j]->centroid - n_dst->coordinate;
+                n_dst->cell_weighting4[j] = (e0[0] + e0.tail<3>().dot(r)) / r.squaredNorm();
+            }
+        }
+        else
+            n_dst->cell_weighting4 = n_dst->cell_weighting1;
     }
 }
 
 /**
  * Cell centroid to face centroid vectors and ratios.
  */
-static void helper2()
+static void face_pass()
 {
-    for (auto f_dst : face)
+    FLM_PROFILE("face_pass");
+    const size_t NumOfFace = face.size();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
     {
+        auto f_dst = face[i];
+
         /// Displacement vector
         if (f_dst->c0 == nullptr)
             f_dst->r0.setZero();
@@ -103,8 +127,8 @@ static void helper2()
             f_dst->cell_weighting1 = {rl0 / s1, rl1 / s1};
 
             /// Weighting2: 1/||r||^2
-            const FLM_SCALAR rll0 = 1.0 / std::pow(f_dst->r0.norm(), 2);
-            const FLM_SCALAR rll1 = 1.0 / std::pow(f_dst->r1.norm(), 2);
+            const FLM_SCALAR rll0 = rl0 * rl0;
+            const FLM_SCALAR rll1 = rl1 * rl1;
             const FLM_SCALAR s2 = rll0 + rll1;
             f_dst->cell_weighting2 = {rll0 / s2, rll1 / s2};
 
@@ -118,58 +142,152 @@ static void helper2()
 }
 
 /**
- * Displacement vectors within each cell.
+ * Displacement vectors within each cell, and
+ * their decomposition for Non-Orthogonal correction.
+ * @param variant Decomposition of the surface vectors.
  */
-static void helper3()
+static void cell_pass(FLM_NOC variant)
 {
-    for (auto c : cell)
+    FLM_PROFILE("cell_pass");
+    const size_t NumOfCell = cell.size();
+    bool inconsistent = false;
+
+#pragma omp parallel for schedule(static) reduction(||:inconsistent)
+    for (size_t i = 0; i < NumOfCell; ++i)
     {
+        auto c = cell[i];
         const size_t Nf = c->surface.size();
-        if (c->cell_adjacency.size() != Nf)
-            throw std::runtime_error("Inconsistency detected!");
-
-        /// Allocate storage
-        c->d.resize(Nf);
+        if (c->cell_adjacency.size() != Nf || c->d.size() != Nf)
+        {
+            inconsistent = true;
+            continue;
+        }
 
-        /// Vector d
         for (size_t j = 0; j < Nf; ++j)
         {
-            auto cur_face = c->surface.at(j);
-            auto cur_adj_cell = c->cell_adjacency.at(j);
+            auto cur_face = c->surface[j];
+            auto cur_adj_cell = c->cell_adjacency[j];
 
+            /// Vector d
             if (cur_adj_cell == nullptr)
-                c->d.at(j) = cur_face->centroid - c->centroid;
+                c->d[j] = cur_face->centroid - c->centroid;
             else
-                c->d.at(j) = cur_adj_cell->centroid - c->centroid;
+                c->d[j] = cur_adj_cell->centroid - c->centroid;
+
+            /// Vector S_E, S_T
+            noc_decompose(c->d[j], c->S[j], c->S_E[j], c->S_T[j], variant);
         }
     }
+
+    if (inconsistent)
+        throw std::runtime_error("Inconsistency detected!");
 }
 
 /**
- * Decomposition for Non-Orthogonal correction.
+ * Centroid, area and unit normal of each face, and
+ * centroid, volume and surface outward normal vectors of each cell,
+ * evaluated from node coordinates for meshes that do not provide them.
+ * Faces are split into triangles around their vertex average,
+ * cells into pyramids with apex at their vertex average.
  */
-static void helper4()
+void calculate_mesh_metrics()
 {
-    for (auto c : cell)
+    FLM_PROFILE("calculate_mesh_metrics");
+    const size_t NumOfFace = face.size();
+    const size_t NumOfCell = cell.size();
+
+    /// Area vectors following the node ordering of each face.
+    std::vector<FLM_VECTOR> A(NumOfFace);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
     {
+        auto f = face[i];
+        const size_t N = f->vertex.size();
+
+        FLM_VECTOR c = FLM_VECTOR::Zero();
+        for (auto n : f->vertex)
+            c += n->coordinate;
+        c /= N;
+
+        A[i].setZero();
+        for (size_t j = 0; j < N; ++j)
+        {
+            const auto &p0 = f->vertex[j]->coordinate;
+            const auto &p1 = f->vertex[(j + 1) % N]->coordinate;
+            A[i] += 0.5 * (p0 - c).cross(p1 - c);
+        }
+
+        f->area = A[i].norm();
+        const FLM_VECTOR n = A[i] / f->area;
+
+        /// Triangles weighted by their area projected onto the face normal.
+        FLM_SCALAR w = 0.0;
+        f->centroid.setZero();
+        for (size_t j = 0; j < N; ++j)
+        {
+            const auto &p0 = f->vertex[j]->coordinate;
+            const auto &p1 = f->vertex[(j + 1) % N]->coordinate;
+            const FLM_SCALAR wj = 0.5 * (p0 - c).cross(p1 - c).dot(n);
+            f->centroid += wj * (c + p0 + p1) / 3.0;
+            w += wj;
+        }
+        f->centroid /= w;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c = cell[i];
         const size_t Nf = c->surface.size();
 
-        /// Allocate storage
-        c->S_E.resize(Nf);
-        c->S_T.resize(Nf);
+        FLM_VECTOR x = FLM_VECTOR::Zero();
+        for (auto n : c->vertex)
+            x += n->coordinate;
+        x /= c->vertex.size();
 
-        /// Vector S_E, S_T
+        c->volume = 0.0;
+        c->centroid.setZero();
         for (size_t j = 0; j < Nf; ++j)
-            noc_decompose(c->d.at(j), c->S.at(j), c->S_E.at(j), c->S_T.at(j));
+        {
+            auto f = c->surface[j];
+            const FLM_VECTOR &Af = A[f->index - 1];
+
+            /// Orient outward by the side of the vertex average.
+            c->S[j] = (f->centroid - x).dot(Af) < 0.0 ? FLM_VECTOR(-Af) : Af;
+
+            const FLM_SCALAR v = (f->centroid - x).dot(c->S[j]) / 3.0;
+            c->volume += v;
+            c->centroid += v * (0.75 * f->centroid + 0.25 * x);
+        }
+        c->centroid /= c->volume;
+    }
+
+    /// "n01" is the outward normal of "c0", or the inward normal of "c1" if "c0" is empty.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        auto f = face[i];
+        const FLM_VECTOR n = A[i] / f->area;
+
+        const Cell *c = f->c0 ? f->c0 : f->c1;
+        const FLM_SCALAR sgn = (f->centroid - c->centroid).dot(n) < 0.0 ? -1.0 : 1.0;
+        f->n01 = f->c0 ? FLM_VECTOR(sgn * n) : FLM_VECTOR(-sgn * n);
+        f->n10 = -f->n01;
     }
 }
 
-void calculate_geometric_value()
+/**
+ * Node, face and cell quantities only depend on loaded data,
+ * so each entity type is swept exactly once.
+ * @param variant Decomposition of the surface vectors for Non-Orthogonal correction.
+ */
+void calculate_geometric_value(FLM_NOC variant)
 {
-    helper1();
-    helper2();
-    helper3();
-    helper4();
+    FLM_PROFILE("calculate_geometric_value");
+    node_pass();
+    face_pass();
+    cell_pass(variant);
 }
 
 static FLM_SCALAR to_degree(const FLM_SCALAR &x)
@@ -180,10 +298,13 @@ static FLM_SCALAR to_degree(const FLM_SCALAR &x)
 
 void check_skewness()
 {
-    std::vector<size_t> stat(91, 0);
+    FLM_PROFILE("check_skewness");
+    const size_t N = face.size();
 
-    for (auto f : face)
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; ++i)
     {
+        auto f = face[i];
         FLM_SCALAR ct;
         if (f->at_boundary())
         {
@@ -198,12 +319,37 @@ void check_skewness()
             ct = d01.dot(f->n01) / d01.norm();
         }
         f->alpha = 1.0 / ct;
-        const FLM_SCALAR ang = to_degree(std::acos(ct));
-        const auto tag = std::lround(ang + 0.5);
-        ++stat[tag];
     }
 
-    const auto N = face.size();
+    report_skewness();
+}
+
+/**
+ * Histogram of the angle between "d" and the face normal, recovered from the skewness factor.
+ */
+void report_skewness()
+{
+    const size_t N = face.size();
+    std::vector<long> tag(N);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; ++i)
+    {
+        /// Round-off may push the cosine slightly beyond 1, degenerate faces give NaN
+        const FLM_SCALAR ang = to_degree(std::acos(std::min(std::max(1.0 / face[i]->alpha, -1.0), 1.0)));
+        tag[i] = std::isnan(ang) ? 90 : std::min(std::max(std::lround(ang + 0.5), 0L), 90L);
+    }
+
+    std::vector<size_t> stat(91, 0);
+    for (auto e : tag)
+        ++stat[e];
+
+    /// Statistics of the skewness factor, reproducible regardless of thread count.
+    const FLM_SCALAR alpha_mean = reduce_sum(N, [](size_t i) { return face[i]->alpha; }) / N;
+    FLM_SCALAR alpha_max = 0.0;
+#pragma omp parallel for reduction(max:alpha_max)
+    for (size_t i = 0; i < N; ++i)
+        alpha_max = std::max(alpha_max, face[i]->alpha);
 
     std::cout << "==============================" << std::endl;
     std::cout << "| theta |  count  | ratio(%) |" << std::endl;
@@ -220,4 +366,5 @@ void check_skewness()
         std::cout << "|" << std::endl;
     }
     std::cout << "==============================" << std::endl;
+    std::cout << "Mean alpha: " << alpha_mean << ", Max alpha: " << alpha_max << std::endl;
 }
@@ -0,0 +1,228 @@
+#include <cstdio>
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/binfile.h"
+#include "../inc/gradient.h"
+#include "../inc/misc.h"
+#include "../inc/geomcache.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const char MAGIC[8] = {'D', '3', 'D', 'G', 'E', 'O', 'M', 'C'};
+
+/// Counts stored in the header.
+enum : size_t
+{
+    NUM_OF_NODE = 0,
+    NUM_OF_FACE = 1,
+    NUM_OF_CELL = 2,
+    CACHE_KEY = 3
+};
+
+/// Sections, in file order.
+/// Per-node and per-cell lists are concatenated in order of index.
+enum : size_t
+{
+    NODE_W1 = 0, /// double[], 1/||r||
+    NODE_W2, /// double[], 1/||r||^2
+    NODE_W3, /// double[], 1/V
+    FACE_R0, /// double[3F]
+    FACE_R1, /// double[3F]
+    FACE_W, /// double[6F], the 3 weighting pairs
+    FACE_ALPHA, /// double[F]
+    CELL_D, /// double[]
+    CELL_SE, /// double[]
+    CELL_ST, /// double[]
+    LSQ, /// double[], column-major per cell
+    NUM_OF_SECTION
+};
+
+/**
+ * Identify everything the cached quantities depend on:
+ * the mesh, the B.C. type of each patch, the cache layout and the scalar type.
+ * @param mesh Fingerprint of the mesh, see "mesh_hash".
+ */
+uint64_t geometry_key(uint64_t mesh)
+{
+    const uint64_t tag[3] = {mesh, FLM_GEOMCACHE_VERSION, sizeof(FLM_SCALAR)};
+    uint64_t h = hash64(tag, sizeof(tag));
+    for (auto p : patch)
+    {
+        const int32_t bc[2] = {static_cast<int32_t>(p->BC), static_cast<int32_t>(p->T)};
+        h = hash64(p->name.data(), p->name.size(), h);
+        h = hash64(bc, sizeof(bc), h);
+    }
+    return h;
+}
+
+/**
+ * Offsets of per-entity variable-length lists, as in CSR storage.
+ */
+template<typename T, typename F>
+static std::vector<size_t> list_ptr(const std::vector<T *> &entity, F len)
+{
+    std::vector<size_t> ptr(entity.size() + 1, 0);
+    for (size_t i = 0; i < entity.size(); ++i)
+        ptr[i + 1] = ptr[i] + len(entity[i]);
+    return ptr;
+}
+
+/**
+ * Load node weighting, face displacement/weighting/skewness, cell decomposition
+ * and Least-Square coefficients from a previous run.
+ * The file is memory-mapped and copied into the entities in parallel.
+ * @param path Path to the cache file.
+ * @param key Expected key, see "geometry_key".
+ * @return "false" if the cache does not exist, or belongs to a different mesh, B.C. layout or version.
+ */
+bool load_geometry_cache(const std::string &path, uint64_t key)
+{
+    FLM_PROFILE("load_geometry_cache");
+    if (!has_magic(path, MAGIC))
+        return false;
+
+    try
+    {
+        SectionReader src(path, MAGIC, FLM_GEOMCACHE_VERSION, NUM_OF_SECTION);
+        if (src.get_count(NUM_OF_NODE) != node.size() || src.get_count(NUM_OF_FACE) != face.size() || src.get_count(NUM_OF_CELL) != cell.size() || src.get_count(CACHE_KEY) != key)
+            return false;
+
+        const auto n_ptr = list_ptr(node, [](Node *n) { return n->cell_dependency.size(); });
+        const auto c_ptr = list_ptr(cell, [](Cell *c) { return c->surface.size(); });
+        const size_t NumOfNode = node.size(), NumOfFace = face.size(), NumOfCell = cell.size();
+
+        const FLM_SCALAR *n_w1 = src.get<FLM_SCALAR>(NODE_W1, n_ptr.back());
+        const FLM_SCALAR *n_w2 = src.get<FLM_SCALAR>(NODE_W2, n_ptr.back());
+        const FLM_SCALAR *n_w3 = src.get<FLM_SCALAR>(NODE_W3, n_ptr.back());
+        const FLM_SCALAR *f_r0 = src.get<FLM_SCALAR>(FACE_R0, 3 * NumOfFace);
+        const FLM_SCALAR *f_r1 = src.get<FLM_SCALAR>(FACE_R1, 3 * NumOfFace);
+        const FLM_SCALAR *f_w = src.get<FLM_SCALAR>(FACE_W, 6 * NumOfFace);
+        const FLM_SCALAR *f_alpha = src.get<FLM_SCALAR>(FACE_ALPHA, NumOfFace);
+        const FLM_SCALAR *c_d = src.get<FLM_SCALAR>(CELL_D, 3 * c_ptr.back());
+        const FLM_SCALAR *c_se = src.get<FLM_SCALAR>(CELL_SE, 3 * c_ptr.back());
+        const FLM_SCALAR *c_st = src.get<FLM_SCALAR>(CELL_ST, 3 * c_ptr.back());
+        if (!load_lsq(src.get<FLM_SCALAR>(LSQ, src.length<FLM_SCALAR>(LSQ)), src.length<FLM_SCALAR>(LSQ)))
+            return false;
+
+#pragma omp parallel
+        {
+#pragma omp for schedule(static) nowait
+            for (size_t i = 0; i < NumOfNode; ++i)
+            {
+                auto n = node[i];
+                const size_t j0 = n_ptr[i], N = n_ptr[i + 1] - j0;
+                n->cell_weighting1.assign(n_w1 + j0, n_w1 + j0 + N);
+                n->cell_weighting2.assign(n_w2 + j0, n_w2 + j0 + N);
+                n->cell_weighting3.assign(n_w3 + j0, n_w3 + j0 + N);
+            }
+#pragma omp for schedule(static) nowait
+            for (size_t i = 0; i < NumOfFace; ++i)
+            {
+                auto f = face[i];
+                f->r0 = Eigen::Map<const FLM_VECTOR>(f_r0 + 3 * i);
+                f->r1 = Eigen::Map<const FLM_VECTOR>(f_r1 + 3 * i);
+                f->cell_weighting1 = {f_w[6 * i], f_w[6 * i + 1]};
+                f->cell_weighting2 = {f_w[6 * i + 2], f_w[6 * i + 3]};
+                f->cell_weighting3 = {f_w[6 * i + 4], f_w[6 * i + 5]};
+                f->alpha = f_alpha[i];
+            }
+#pragma omp for schedule(static) nowait
+            for (size_t i = 0; i < NumOfCell; ++i)
+            {
+                auto c = cell[i];
+                const size_t j0 = c_ptr[i], N = c_ptr[i + 1] - j0;
+                c->d.resize(N);
+                c->S_E.resize(N);
+                c->S_T.resize(N);
+                for (size_t j = 0; j < N; ++j)
+                {
+                    c->d[j] = Eigen::Map<const FLM_VECTOR>(c_d + 3 * (j0 + j));
+                    c->S_E[j] = Eigen::Map<const FLM_VECTOR>(c_se + 3 * (j0 + j));
+                    c->S_T[j] = Eigen::Map<const FLM_VECTOR>(c_st + 3 * (j0 + j));
+                }
+            }
+        }
+    }
+    catch (const invalid_file_format &)
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Record the quantities restored by "load_geometry_cache".
+ * Written into a temporary file first, so concurrent runs never see a partial cache.
+ * @param path Path to the cache file.
+ * @param key Key of the current mesh and B.C. layout, see "geometry_key".
+ */
+void save_geometry_cache(const std::string &path, uint64_t key)
+{
+    FLM_PROFILE("save_geometry_cache");
+    const auto n_ptr = list_ptr(node, [](Node *n) { return n->cell_dependency.size(); });
+    const auto c_ptr = list_ptr(cell, [](Cell *c) { return c->surface.size(); });
+
+    std::vector<FLM_SCALAR> n_w1(n_ptr.back()), n_w2(n_ptr.back()), n_w3(n_ptr.back());
+    std::vector<FLM_SCALAR> f_r0(3 * face.size()), f_r1(3 * face.size()), f_w(6 * face.size()), f_alpha(face.size());
+    std::vector<FLM_SCALAR> c_d(3 * c_ptr.back()), c_se(3 * c_ptr.back()), c_st(3 * c_ptr.back());
+
+    for (size_t i = 0; i < node.size(); ++i)
+    {
+        auto n = node[i];
+        std::copy(n->cell_weighting1.begin(), n->cell_weighting1.end(), n_w1.begin() + n_ptr[i]);
+        std::copy(n->cell_weighting2.begin(), n->cell_weighting2.end(), n_w2.begin() + n_ptr[i]);
+        std::copy(n->cell_weighting3.begin(), n->cell_weighting3.end(), n_w3.begin() + n_ptr[i]);
+    }
+    for (size_t i = 0; i < face.size(); ++i)
+    {
+        auto f = face[i];
+        FLM_VECTOR::Map(&f_r0[3 * i]) = f->r0;
+        FLM_VECTOR::Map(&f_r1[3 * i]) = f->r1;
+        for (int k = 0; k < 2; ++k)
+        {
+            f_w[6 * i + k] = f->cell_weighting1[k];
+            f_w[6 * i + 2 + k] = f->cell_weighting2[k];
+            f_w[6 * i + 4 + k] = f->cell_weighting3[k];
+        }
+        f_alpha[i] = f->alpha;
+    }
+    for (size_t i = 0; i < cell.size(); ++i)
+    {
+        auto c = cell[i];
+        for (size_t j = 0; j < c->surface.size(); ++j)
+        {
+            const size_t k = 3 * (c_ptr[i] + j);
+            FLM_VECTOR::Map(&c_d[k]) = c->d[j];
+            FLM_VECTOR::Map(&c_se[k]) = c->S_E[j];
+            FLM_VECTOR::Map(&c_st[k]) = c->S_T[j];
+        }
+    }
+    std::vector<FLM_SCALAR> lsq;
+    save_lsq(lsq);
+
+    SectionWriter dst(MAGIC, FLM_GEOMCACHE_VERSION, NUM_OF_SECTION);
+    dst.set_count(NUM_OF_NODE, node.size());
+    dst.set_count(NUM_OF_FACE, face.size());
+    dst.set_count(NUM_OF_CELL, cell.size());
+    dst.set_count(CACHE_KEY, key);
+    dst.put(NODE_W1, n_w1);
+    dst.put(NODE_W2, n_w2);
+    dst.put(NODE_W3, n_w3);
+    dst.put(FACE_R0, f_r0);
+    dst.put(FACE_R1, f_r1);
+    dst.put(FACE_W, f_w);
+    dst.put(FACE_ALPHA, f_alpha);
+    dst.put(CELL_D, c_d);
+    dst.put(CELL_SE, c_se);
+    dst.put(CELL_ST, c_st);
+    dst.put(LSQ, lsq);
+
+    const std::string tmp = path + ".part";
+    dst.write(tmp);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Failed to replace \"" + path + "\".");
+}
@@ -1,5 +1,7 @@
 #include "../inc/element.h"
 #include "../inc/gradient.h"
+#include "../inc/roofline.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
@@ -8,72 +10,139 @@ extern std::vector<Cell *> cell;
 
 typedef Eigen::Matrix<FLM_SCALAR, Eigen::Dynamic, 3> MatX3;
 typedef Eigen::Matrix<FLM_SCALAR, 3, Eigen::Dynamic> Mat3X;
-typedef Eigen::Matrix<FLM_SCALAR, Eigen::Dynamic, Eigen::Dynamic> MatXX;
+
+/// Cells with up to this many faces, which covers all standard shapes, are factorized on the stack
+static const int LSQ_MAX_FACE = 12;
+typedef Eigen::Matrix<FLM_SCALAR, Eigen::Dynamic, 3, Eigen::ColMajor, LSQ_MAX_FACE, 3> MatN3;
 
 /// Coefficient matrix
 static std::vector<Mat3X> J_INV_T;
 
 /**
  * Convert Eigen's intrinsic QR decomposition matrix into R^-1 * Q^T
+ * Only the leading 3 columns of Q are formed, in storage of the same kind as the input.
  * @param J The coefficient matrix to be factorized.
  * @param J_INV The general inverse of input matrix using QR decomposition.
  */
-static void qr_inv(const MatX3 &J, Mat3X &J_INV)
+template<typename MatJ>
+static void qr_inv(const MatJ &J, Mat3X &J_INV)
 {
-    auto QR = J.householderQr();
-    const MatXX Q = QR.householderQ();
-    const MatXX R = QR.matrixQR().triangularView<Eigen::Upper>();
-
-    const MatXX Q0 = Q.block(0, 0, J.rows(), 3);
-    const MatXX R0 = R.block<3, 3>(0, 0);
+    const Eigen::HouseholderQR<MatJ> QR(J);
+    MatJ Q0 = MatJ::Identity(J.rows(), 3);
+    Q0.applyOnTheLeft(QR.householderQ());
+    const FLM_TENSOR R0 = QR.matrixQR().template topLeftCorner<3, 3>().template triangularView<Eigen::Upper>();
 
     J_INV = R0.inverse() * Q0.transpose();
 }
 
+/**
+ * Fill the least-square coefficients of one cell, one row per face.
+ * @param c The cell.
+ * @param J_T Coefficient matrix, resized to the number of faces.
+ */
+template<typename MatJ>
+static void lsq_matrix(const Cell *c, MatJ &J_T)
+{
+    const size_t nF = c->surface.size();
+    J_T.resize(nF, Eigen::NoChange);
+
+    for (size_t j = 0; j < nF; ++j)
+    {
+        /// Possible coefficients for current face
+        auto curFace = c->surface.at(j);
+        const auto &d = c->d.at(j);
+        const auto w = 1.0 / c->d.at(j).norm();
+        if (curFace->at_boundary())
+        {
+            auto ptc = curFace->parent;
+            const auto n = c->S.at(j) / curFace->area;
+
+            switch (ptc->T) /// Temperature
+            {
+            case FLM_BC_MATH::Dirichlet:
+                J_T.row(j) << w * d.x(), w * d.y(), w * d.z();
+                break;
+            case FLM_BC_MATH::Neumann:
+                J_T.row(j) << n.x(), n.y(), n.z();
+                break;
+            default:
+                throw unsupported_boundary_condition(ptc->T);
+            }
+        }
+        else
+        {
+            J_T.row(j) << w * d.x(), w * d.y(), w * d.z(); /// Temperature
+        }
+    }
+}
+
 void prepare_lsq()
 {
-    MatX3 J_T;
+    FLM_PROFILE("prepare_lsq");
+    MatN3 J_T;
+    MatX3 J_T_large; /// Only for cells with more than "LSQ_MAX_FACE" faces
 
     /// Allocate storage for coefficient matrix
     J_INV_T.resize(cell.size());
 
     for (auto c : cell)
     {
-        const size_t nF = c->surface.size();
+        auto &J_INV = J_INV_T.at(c->index - 1);
+        if (c->surface.size() <= size_t(LSQ_MAX_FACE))
+        {
+            lsq_matrix(c, J_T);
+            qr_inv(J_T, J_INV); /// Temperature
+        }
+        else
+        {
+            lsq_matrix(c, J_T_large);
+            qr_inv(J_T_large, J_INV); /// Temperature
+        }
+    }
+}
 
-        J_T.resize(nF, Eigen::NoChange);
+/**
+ * Flatten the coefficient matrices, column-major, in order of cell index.
+ * @param dst Coefficients, 3 per face of each cell.
+ */
+void save_lsq(std::vector<FLM_SCALAR> &dst)
+{
+    size_t n = 0;
+    for (const auto &e : J_INV_T)
+        n += e.size();
+    dst.resize(n);
 
-        for (size_t j = 0; j < nF; ++j)
-        {
-            /// Possible coefficients for current face
-            auto curFace = c->surface.at(j);
-            const auto &d = c->d.at(j);
-            const auto w = 1.0 / c->d.at(j).norm();
-            if (curFace->at_boundary())
-            {
-                auto ptc = curFace->parent;
-                const auto n = c->S.at(j) / curFace->area;
+    FLM_SCALAR *p = dst.data();
+    for (const auto &e : J_INV_T)
+    {
+        Eigen::Map<Mat3X>(p, 3, e.cols()) = e;
+        p += e.size();
+    }
+}
 
-                switch (ptc->T) /// Temperature
-                {
-                case FLM_BC_MATH::Dirichlet:
-                    J_T.row(j) << w * d.x(), w * d.y(), w * d.z();
-                    break;
-                case FLM_BC_MATH::Neumann:
-                    J_T.row(j) << n.x(), n.y(), n.z();
-                    break;
-                default:
-                    throw unsupported_boundary_condition(ptc->T);
-                }
-            }
-            else
-            {
-                J_T.row(j) << w * d.x(), w * d.y(), w * d.z(); /// Temperature
-            }
-        }
+/**
+ * Restore the coefficient matrices from the layout of "save_lsq".
+ * Shapes follow the number of faces of each cell.
+ * @param src Coefficients, 3 per face of each cell.
+ * @param n Number of coefficients, checked against the mesh.
+ * @return "false" if "n" does not match.
+ */
+bool load_lsq(const FLM_SCALAR *src, size_t n)
+{
+    size_t expected = 0;
+    for (auto c : cell)
+        expected += 3 * c->surface.size();
+    if (n != expected)
+        return false;
 
-        qr_inv(J_T, J_INV_T.at(c->index-1)); /// Temperature
+    J_INV_T.resize(cell.size());
+    for (auto c : cell)
+    {
+        const size_t nF = c->surface.size();
+        J_INV_T[c->index - 1] = Eigen::Map<const Mat3X>(src, 3, nF);
+        src += 3 * nF;
     }
+    return true;
 }
 
 /**
@@ -88,7 +157,56 @@ void prepare_lsq()
  */
 static void lsq()
 {
-    /// TODO
+    const size_t NumOfCell = cell.size();
+    size_t nInternal = 0, nDirichlet = 0, nNeumann = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nInternal, nDirichlet, nNeumann)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c = cell[i];
+        const auto &J_INV = J_INV_T[i];
+        const size_t nF = c->surface.size();
+
+        c->grad_T.setZero();
+        for (size_t j = 0; j < nF; ++j)
+        {
+            /// Right-hand side in the same row order as "prepare_lsq"
+            auto curFace = c->surface[j];
+            FLM_SCALAR b;
+            if (curFace->at_boundary())
+            {
+                if (curFace->parent->T == FLM_BC_MATH::Neumann)
+                {
+                    ++nNeumann;
+                    b = static_cast<BoundaryFace *>(curFace)->sn_grad_T;
+                }
+                else
+                {
+                    ++nDirichlet;
+                    b = (curFace->T - c->T) / c->d[j].norm();
+                }
+            }
+            else
+            {
+                ++nInternal;
+                b = (c->cell_adjacency[j]->T - c->T) / c->d[j].norm();
+            }
+
+            c->grad_T += b * J_INV.col(j);
+        }
+    }
+
+    /// Per cell: entity, coefficients, 3 lists, value and the result;
+    /// per face: face and type, column of coefficients;
+    /// internal: neighbour and its value, "d"; Dirichlet: patch and B.C. type, face value, "d";
+    /// Neumann: patch and B.C. type, gradient
+    const size_t nVisit = nInternal + nDirichlet + nNeumann;
+    const double bytes = NumOfCell * (sizeof(Cell *) + sizeof(Mat3X) + 3 * FLM_LIST_BYTES + sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR)) +
+                         nVisit * (sizeof(Face *) + FLM_VPTR_BYTES + sizeof(FLM_VECTOR)) +
+                         nInternal * (sizeof(Cell *) + sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR)) +
+                         nDirichlet * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR)) +
+                         nNeumann * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + sizeof(FLM_SCALAR));
+    profile_work(bytes, 6.0 * nVisit + 8.0 * (nInternal + nDirichlet));
 }
 
 /**
@@ -99,25 +217,119 @@ static void lsq()
  */
 static void gg1()
 {
+    const size_t NumOfCell = cell.size();
+    size_t nInternal = 0, nDirichlet = 0, nNeumann = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nInternal, nDirichlet, nNeumann)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c = cell[i];
+        const size_t nF = c->surface.size();
 
+        FLM_VECTOR s = FLM_VECTOR::Zero();
+        for (size_t j = 0; j < nF; ++j)
+        {
+            /// Face value weighted by inverse distance to the centroids on both sides
+            auto curFace = c->surface[j];
+            FLM_SCALAR T_f;
+            if (curFace->at_boundary())
+            {
+                if (curFace->parent->T == FLM_BC_MATH::Neumann)
+                {
+                    ++nNeumann;
+                    T_f = c->T + static_cast<BoundaryFace *>(curFace)->sn_grad_T * c->d[j].dot(c->S[j]) / curFace->area;
+                }
+                else
+                {
+                    ++nDirichlet;
+                    T_f = curFace->T;
+                }
+            }
+            else
+            {
+                ++nInternal;
+                const auto &w = curFace->cell_weighting1;
+                T_f = w[0] * curFace->c0->T + w[1] * curFace->c1->T;
+            }
+            s += T_f * c->S[j];
+        }
+        c->grad_T = s / c->volume;
+    }
+
+    /// Per cell: entity, 3 lists, value, volume and the result;
+    /// per face: face and type, "S";
+    /// internal: 2 weights, 2 cells and their values; Dirichlet: patch and B.C. type, face value;
+    /// Neumann: patch and B.C. type, gradient, "d" and area
+    const size_t nVisit = nInternal + nDirichlet + nNeumann;
+    const double bytes = NumOfCell * (sizeof(Cell *) + 3 * FLM_LIST_BYTES + 2 * sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR)) +
+                         nVisit * (sizeof(Face *) + FLM_VPTR_BYTES + sizeof(FLM_VECTOR)) +
+                         nInternal * (2 * sizeof(FLM_SCALAR) + 2 * sizeof(Cell *) + 2 * sizeof(FLM_SCALAR)) +
+                         nDirichlet * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + sizeof(FLM_SCALAR)) +
+                         nNeumann * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + 2 * sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR));
+    profile_work(bytes, 3.0 * NumOfCell + 6.0 * nVisit + 3.0 * nInternal + 8.0 * nNeumann);
 }
 
 /**
  * Calculate gradient on cell centroid.
  * Nodal-based.
  * Robust for highly-skewed mesh.
+ * Face values are averaged from vertices everywhere, boundary nodes carry the B.C.
+ * Prescribed values on Dirichlet faces are not used directly: the averaging error on the opposite face
+ * would remain uncancelled, leaving an O(h) error on the first layer of cells.
  * Before call to this function, all nodal values should be updated.
  */
 static void gg2()
 {
-    for(auto f : face)
+    const size_t NumOfCell = cell.size();
+    size_t nVisit = 0, nVertex = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nVisit, nVertex)
+    for (size_t i = 0; i < NumOfCell; ++i)
     {
+        auto c = cell[i];
+        const size_t nF = c->surface.size();
 
+        FLM_VECTOR s = FLM_VECTOR::Zero();
+        for (size_t j = 0; j < nF; ++j)
+        {
+            /// Face value averaged from its vertices
+            auto curFace = c->surface[j];
+            FLM_SCALAR T_f = 0.0;
+            for (auto n : curFace->vertex)
+                T_f += n->T;
+            T_f /= curFace->vertex.size();
+            s += T_f * c->S[j];
+            ++nVisit;
+            nVertex += curFace->vertex.size();
+        }
+        c->grad_T = s / c->volume;
     }
-}
 
+    /// Per cell: entity, 2 lists, volume and the result;
+    /// per face: face, list of vertices and "S"; per vertex: vertex and its value
+    const double bytes = NumOfCell * (sizeof(Cell *) + 2 * FLM_LIST_BYTES + sizeof(FLM_SCALAR) + sizeof(FLM_VECTOR)) +
+                         nVisit * (sizeof(Face *) + FLM_LIST_BYTES + sizeof(FLM_VECTOR)) +
+                         nVertex * (sizeof(Node *) + sizeof(FLM_SCALAR));
+    profile_work(bytes, 3.0 * NumOfCell + 7.0 * nVisit + nVertex);
+}
 
-void calculate_cell_gradient()
+/**
+ * Calculate gradient of temperature on each cell.
+ * @param scheme Gradient reconstruction scheme.
+ */
+void calculate_cell_gradient(FLM_GRADIENT scheme)
 {
-    gg2();
+    FLM_PROFILE("calculate_cell_gradient");
+    switch (scheme)
+    {
+    case FLM_GRADIENT::GG1:
+        gg1();
+        break;
+    case FLM_GRADIENT::GG2:
+        gg2();
+        break;
+    case FLM_GRADIENT::LSQ:
+        lsq();
+        break;
+    }
 }
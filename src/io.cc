@@ -1,11 +1,102 @@
+#include <fstream>
+#include <limits>
 #include "../inc/element.h"
+#include "../inc/misc.h"
+#include "../inc/snapshot.h"
+#include "../inc/series.h"
+#include "../inc/binmesh.h"
+#include "../inc/meshgen.h"
 #include "../inc/io.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
 extern std::vector<Face *> face;
 extern std::vector<Cell *> cell;
 
+/**
+ * Dump the loaded mesh in the text format read by "read_mesh".
+ * Adjacent nodes and dependent faces of each node are not used by the reader and written as empty.
+ * @param fout Destination.
+ */
+void write_mesh(std::ostream &fout)
+{
+    FLM_PROFILE("write_mesh");
+    static const char SEP = ' ';
+    static const char EOL = '\n';
+
+    /// Round-trip precision, so that geometric quantities are preserved exactly.
+    fout.precision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+
+    fout << node.size() << SEP << face.size() << SEP << cell.size() << SEP << patch.size() << EOL;
+
+    for (auto n : node)
+    {
+        fout << (n->at_boundary ? 1 : 0) << SEP;
+        fout << n->coordinate.x() << SEP << n->coordinate.y() << SEP << n->coordinate.z() << SEP;
+        fout << 0 << SEP << 0 << SEP << n->cell_dependency.size();
+        for (auto c : n->cell_dependency)
+            fout << SEP << c->index;
+        fout << EOL;
+    }
+
+    for (auto f : face)
+    {
+        if (f->vertex.size() != 3 && f->vertex.size() != 4)
+            throw unsupported_shape("face", f->index, static_cast<int>(f->vertex.size()));
+
+        fout << (f->at_boundary() ? 1 : 0) << SEP << f->vertex.size() << SEP;
+        fout << f->centroid.x() << SEP << f->centroid.y() << SEP << f->centroid.z() << SEP << f->area;
+        for (auto n : f->vertex)
+            fout << SEP << n->index;
+        fout << SEP << (f->c0 ? f->c0->index : 0) << SEP << (f->c1 ? f->c1->index : 0);
+        fout << SEP << f->n01.x() << SEP << f->n01.y() << SEP << f->n01.z();
+        fout << SEP << f->n10.x() << SEP << f->n10.y() << SEP << f->n10.z() << EOL;
+    }
+
+    for (auto c : cell)
+    {
+        /// Shape code from the numbers of nodes and faces
+        const size_t N1 = c->vertex.size(), N2 = c->surface.size();
+        int shape;
+        if (N1 == 4 && N2 == 4)
+            shape = 2;
+        else if (N1 == 8 && N2 == 6)
+            shape = 4;
+        else if (N1 == 5 && N2 == 5)
+            shape = 5;
+        else if (N1 == 6 && N2 == 5)
+            shape = 6;
+        else
+            throw unsupported_shape("cell", c->index, static_cast<int>(N1));
+
+        fout << shape << SEP << c->centroid.x() << SEP << c->centroid.y() << SEP << c->centroid.z() << SEP << c->volume;
+        for (auto n : c->vertex)
+            fout << SEP << n->index;
+        for (auto f : c->surface)
+            fout << SEP << f->index;
+        for (auto e : c->cell_adjacency)
+            fout << SEP << (e ? e->index : 0);
+        for (size_t j = 0; j < N2; ++j)
+        {
+            const FLM_VECTOR n = c->S[j] / c->surface[j]->area;
+            fout << SEP << n.x() << SEP << n.y() << SEP << n.z();
+        }
+        fout << EOL;
+    }
+
+    for (auto p : patch)
+    {
+        fout << p->name << SEP << p->surface.size() << SEP << p->vertex.size() << EOL;
+        for (size_t j = 0; j < p->surface.size(); ++j)
+            fout << (j ? " " : "") << p->surface[j]->index;
+        fout << EOL;
+        for (size_t j = 0; j < p->vertex.size(); ++j)
+            fout << (j ? " " : "") << p->vertex[j]->index;
+        fout << EOL;
+    }
+}
+
 /**
  * Load computation mesh in custom format, which is converted from FLUENT "msh" file.
  * @param fin Input stream of the converted mesh file.
@@ -72,6 +163,10 @@ void read_mesh(std::istream &fin)
         size_t n_dep_cell;
         fin >> n_dep_cell;
         n_dst->cell_dependency.resize(n_dep_cell);
+        n_dst->cell_weighting1.resize(n_dep_cell);
+        n_dst->cell_weighting2.resize(n_dep_cell);
+        n_dst->cell_weighting3.resize(n_dep_cell);
+        n_dst->cell_weighting4.resize(n_dep_cell);
         for (size_t j = 0; j < n_dep_cell; ++j)
         {
             size_t tmp;
@@ -210,6 +305,11 @@ void read_mesh(std::istream &fin)
             fin >> tmp.x() >> tmp.y() >> tmp.z();
             tmp *= c_dst->surface.at(j)->area;
         }
+
+        /// Storage for derived geometric quantities
+        c_dst->d.resize(N2);
+        c_dst->S_E.resize(N2);
+        c_dst->S_T.resize(N2);
     }
 
     /// Update boundary patch information.
@@ -250,28 +350,73 @@ void read_mesh(std::istream &fin)
     }
 }
 
+/**
+ * Load computation mesh, detecting its format from the leading bytes of the file.
+ * A specification such as "gen:hex:32" builds a synthetic mesh instead, see "parse_mesh_spec".
+ * @param path Path to the mesh file.
+ */
+void load_mesh(const std::string &path)
+{
+    FLM_PROFILE("load_mesh");
+    if (is_mesh_spec(path))
+    {
+        FLM_MESH_SPEC spec;
+        parse_mesh_spec(path, spec);
+        generate_mesh(spec);
+    }
+    else if (is_binary_mesh(path))
+        read_mesh_binary(path);
+    else if (is_minimal_mesh(path))
+        read_mesh_minimal(path);
+    else if (is_fluent_mesh(path))
+        read_mesh_fluent(path);
+    else
+        read_mesh_mapped(path);
+}
+
 void write_data(std::ostream &out, size_t iter, FLM_SCALAR t)
 {
     static const char SEP = ' ';
+    static const char EOL = '\n';
 
-    out << iter << SEP << t << std::endl;
-    out << node.size() << SEP << face.size() << SEP << cell.size() << std::endl;
+    /// Round-trip precision, so that restart is exact.
+    out.precision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+
+    out << iter << SEP << t << EOL;
+    out << node.size() << SEP << face.size() << SEP << cell.size() << EOL;
 
     for (auto e : node)
     {
-        out << e->T << std::endl;
+        out << e->T << EOL;
     }
 
     for (auto e : face)
     {
-        out << e->T << std::endl;
+        out << e->T << EOL;
     }
 
     for (auto e : cell)
     {
-        out << e->T << std::endl;
+        out << e->T << EOL;
     }
 }
+/**
+ * Text output of a detached solution, in the same layout as above.
+ */
+void write_data(std::ostream &out, const Snapshot &src)
+{
+    static const char SEP = ' ';
+    static const char EOL = '\n';
+
+    out.precision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+
+    out << src.iter << SEP << src.t << EOL;
+    out << src.node_T.size() << SEP << src.face_T.size() << SEP << src.cell_T.size() << EOL;
+
+    for (auto e : {&src.node_T, &src.face_T, &src.cell_T})
+        for (auto val : *e)
+            out << val << EOL;
+}
 
 void read_data(std::istream &in, size_t &iter, FLM_SCALAR &t)
 {
@@ -298,3 +443,68 @@ void read_data(std::istream &in, size_t &iter, FLM_SCALAR &t)
         in >> e->T;
     }
 }
+
+/**
+ * Load solution, detecting text or binary snapshot from the leading bytes of the file.
+ * For a time-series container, the latest record is used.
+ * @param path Path to the data file.
+ * @param iter Iteration of the solution.
+ * @param t Physical time of the solution.
+ */
+void load_data(const std::string &path, size_t &iter, FLM_SCALAR &t)
+{
+    FLM_PROFILE("load_data");
+    const bool container = is_series(path);
+    if (container || is_binary_snapshot(path))
+    {
+        Snapshot src;
+        if (container)
+        {
+            SeriesReader in(path);
+            if (in.size() == 0)
+                throw invalid_file_format(path, "no record.");
+            in.read(in.size() - 1, src);
+        }
+        else
+            read_snapshot(path, src);
+        if (src.mesh != mesh_hash())
+            throw inconsistent_mesh();
+        scatter_snapshot(src);
+        iter = src.iter;
+        t = src.t;
+    }
+    else
+    {
+        std::ifstream in(path);
+        if (in.fail())
+            throw failed_to_open_file(path);
+        read_data(in, iter, t);
+    }
+}
+
+/**
+ * Fingerprint of the mesh topology and node locations.
+ * @return Hash over entity counts, node coordinates, face vertices and face-to-cell connectivity.
+ */
+uint64_t mesh_hash()
+{
+    FLM_PROFILE("mesh_hash");
+    const uint64_t cnt[4] = {node.size(), face.size(), cell.size(), patch.size()};
+    uint64_t h = hash64(cnt, sizeof(cnt));
+
+    for (auto n : node)
+        h = hash64(n->coordinate.data(), 3 * sizeof(FLM_SCALAR), h);
+
+    std::vector<uint64_t> buf;
+    for (auto f : face)
+    {
+        buf.clear();
+        for (auto n : f->vertex)
+            buf.push_back(n->index);
+        buf.push_back(f->c0 ? f->c0->index : 0);
+        buf.push_back(f->c1 ? f->c1->index : 0);
+        h = hash64(buf.data(), buf.size() * sizeof(uint64_t), h);
+    }
+
+    return h;
+}
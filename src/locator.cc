@@ -0,0 +1,296 @@
+#include <limits>
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <cmath>
+#include <stdexcept>
+#include "../inc/locator.h"
+#include "../inc/profile.h"
+
+/// Maximum number of cells in a leaf.
+static const size_t LEAF = 8;
+
+/// Ranges below this size are built by the thread that reached them.
+static const size_t TASK_GRAIN = 4096;
+
+/**
+ * Number of nodes of a tree over "n" cells.
+ */
+static size_t tree_size(size_t n)
+{
+    return n <= LEAF ? 1 : 1 + tree_size(n / 2) + tree_size(n - n / 2);
+}
+
+/**
+ * Test whether "x" lies inside "c", assuming it is convex:
+ * "x" must be behind every face, as seen along the outward normal.
+ */
+bool cell_contains(const Cell *c, const FLM_VECTOR &x)
+{
+    const FLM_SCALAR tol = 1e-10 * std::cbrt(c->volume);
+    for (size_t j = 0; j < c->surface.size(); ++j)
+        if ((x - c->surface[j]->centroid).dot(c->S[j]) > tol * c->S[j].norm())
+            return false;
+    return true;
+}
+
+static FLM_SCALAR box_distance2(const FLM_VECTOR &lo, const FLM_VECTOR &hi, const FLM_VECTOR &x)
+{
+    const FLM_VECTOR d = (lo - x).cwiseMax(x - hi).cwiseMax(FLM_VECTOR::Zero());
+    return d.squaredNorm();
+}
+
+static bool box_contains(const FLM_VECTOR &lo, const FLM_VECTOR &hi, const FLM_VECTOR &x)
+{
+    return (x.array() >= lo.array()).all() && (x.array() <= hi.array()).all();
+}
+
+static bool box_overlaps(const FLM_VECTOR &lo0, const FLM_VECTOR &hi0, const FLM_VECTOR &lo1, const FLM_VECTOR &hi1)
+{
+    return (lo0.array() <= hi1.array()).all() && (lo1.array() <= hi0.array()).all();
+}
+
+/**
+ * Build the hierarchy.
+ * Cells are referenced, not copied, so they must outlive the locator.
+ * Geometric quantities of the cells should be ready.
+ * @param src Cells to be indexed.
+ */
+CellLocator::CellLocator(const std::vector<Cell *> &src) :
+    entry(src),
+    lo(src.size()),
+    hi(src.size())
+{
+    FLM_PROFILE("CellLocator::build");
+    if (src.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many cells for the spatial index.");
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < entry.size(); ++i)
+    {
+        lo[i] = hi[i] = entry[i]->centroid;
+        for (auto n : entry[i]->vertex)
+        {
+            lo[i] = lo[i].cwiseMin(n->coordinate);
+            hi[i] = hi[i].cwiseMax(n->coordinate);
+        }
+    }
+
+    tree.resize(entry.empty() ? 0 : tree_size(entry.size()));
+    if (entry.empty())
+        return;
+
+    /// Centroids are copied for locality during the splits
+    std::vector<FLM_VECTOR> ctr(entry.size());
+    std::vector<uint32_t> order(entry.size());
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < entry.size(); ++i)
+    {
+        ctr[i] = entry[i]->centroid;
+        order[i] = i;
+    }
+
+#pragma omp parallel
+#pragma omp single
+    build(0, 0, entry.size(), order, ctr);
+
+    /// Leaves refer to contiguous ranges of the final order
+    std::vector<Cell *> e(entry.size());
+    std::vector<FLM_VECTOR> l(entry.size()), h(entry.size());
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < entry.size(); ++i)
+    {
+        e[i] = entry[order[i]];
+        l[i] = lo[order[i]];
+        h[i] = hi[order[i]];
+    }
+    entry.swap(e);
+    lo.swap(l);
+    hi.swap(h);
+}
+
+/**
+ * Build node "k" over [begin, end) of "order", which is reordered in place.
+ */
+void CellLocator::build(size_t k, size_t begin, size_t end, std::vector<uint32_t> &order, const std::vector<FLM_VECTOR> &ctr)
+{
+    Node &dst = tree[k];
+    dst.begin = begin;
+    dst.end = end;
+    dst.right = 0;
+
+    dst.c_lo = dst.c_hi = ctr[order[begin]];
+    for (size_t i = begin + 1; i < end; ++i)
+    {
+        dst.c_lo = dst.c_lo.cwiseMin(ctr[order[i]]);
+        dst.c_hi = dst.c_hi.cwiseMax(ctr[order[i]]);
+    }
+
+    const size_t n = end - begin;
+    if (n > LEAF)
+    {
+        int axis;
+        (dst.c_hi - dst.c_lo).maxCoeff(&axis);
+
+        /// Split at the median, ties broken by position in the input
+        const size_t mid = n / 2;
+        std::nth_element(order.begin() + begin, order.begin() + begin + mid, order.begin() + end, [&ctr, axis](uint32_t a, uint32_t b) {
+            return ctr[a](axis) < ctr[b](axis) || (ctr[a](axis) == ctr[b](axis) && a < b);
+        });
+
+        const size_t left = k + 1, right = k + 1 + tree_size(mid);
+        dst.right = right;
+#pragma omp task if (n > TASK_GRAIN) shared(order, ctr)
+        build(left, begin, begin + mid, order, ctr);
+#pragma omp task if (n > TASK_GRAIN) shared(order, ctr)
+        build(right, begin + mid, end, order, ctr);
+#pragma omp taskwait
+        dst.lo = tree[left].lo.cwiseMin(tree[right].lo);
+        dst.hi = tree[left].hi.cwiseMax(tree[right].hi);
+    }
+    else
+    {
+        dst.lo = lo[order[begin]];
+        dst.hi = hi[order[begin]];
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            dst.lo = dst.lo.cwiseMin(lo[order[i]]);
+            dst.hi = dst.hi.cwiseMax(hi[order[i]]);
+        }
+    }
+}
+
+/**
+ * Cell containing "x", assuming convex cells.
+ * On shared faces and nodes, the cell with the lowest index wins.
+ * @return "nullptr" if "x" is outside the mesh.
+ */
+Cell *CellLocator::locate(const FLM_VECTOR &x) const
+{
+    Cell *ret = nullptr;
+    if (tree.empty())
+        return ret;
+
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        const Node &cur = tree[stack.back()];
+        const size_t k = stack.back();
+        stack.pop_back();
+        if (!box_contains(cur.lo, cur.hi, x))
+            continue;
+
+        if (cur.right == 0)
+        {
+            for (size_t i = cur.begin; i < cur.end; ++i)
+                if (box_contains(lo[i], hi[i], x) && cell_contains(entry[i], x))
+                    if (ret == nullptr || entry[i]->index < ret->index)
+                        ret = entry[i];
+        }
+        else
+        {
+            stack.push_back(cur.right);
+            stack.push_back(k + 1);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Cell with the nearest centroid.
+ */
+Cell *CellLocator::nearest(const FLM_VECTOR &x) const
+{
+    std::vector<Cell *> ret;
+    nearest(x, 1, ret);
+    return ret.empty() ? nullptr : ret.front();
+}
+
+/**
+ * The "k" cells with the nearest centroids, by increasing distance.
+ * Ties are broken by index.
+ * Nodes are visited best-first on the distance to their centroid box.
+ * @param x Query point.
+ * @param k Number of cells requested.
+ * @param dst Result, with less than "k" cells only if the locator holds fewer.
+ */
+void CellLocator::nearest(const FLM_VECTOR &x, size_t k, std::vector<Cell *> &dst) const
+{
+    dst.clear();
+    if (tree.empty() || k == 0)
+        return;
+
+    typedef std::tuple<FLM_SCALAR, size_t, Cell *> Candidate; /// (distance^2, index, cell)
+    std::priority_queue<Candidate> best; /// Worst on top
+    std::priority_queue<std::pair<FLM_SCALAR, uint32_t>, std::vector<std::pair<FLM_SCALAR, uint32_t>>, std::greater<>> open;
+    open.emplace(box_distance2(tree[0].c_lo, tree[0].c_hi, x), 0);
+
+    while (!open.empty())
+    {
+        const auto cur = open.top();
+        open.pop();
+        if (best.size() == k && cur.first > std::get<0>(best.top()))
+            break;
+
+        const Node &nd = tree[cur.second];
+        if (nd.right == 0)
+        {
+            for (size_t i = nd.begin; i < nd.end; ++i)
+            {
+                const Candidate c((entry[i]->centroid - x).squaredNorm(), entry[i]->index, entry[i]);
+                if (best.size() < k)
+                    best.push(c);
+                else if (c < best.top())
+                {
+                    best.pop();
+                    best.push(c);
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t child : {cur.second + 1, nd.right})
+                open.emplace(box_distance2(tree[child].c_lo, tree[child].c_hi, x), child);
+        }
+    }
+
+    dst.resize(best.size());
+    for (size_t i = best.size(); i > 0; --i)
+    {
+        dst[i - 1] = std::get<2>(best.top());
+        best.pop();
+    }
+}
+
+/**
+ * Cells whose bounding boxes overlap [lo, hi], in order of index.
+ */
+void CellLocator::query(const FLM_VECTOR &q_lo, const FLM_VECTOR &q_hi, std::vector<Cell *> &dst) const
+{
+    dst.clear();
+    if (tree.empty())
+        return;
+
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        const uint32_t k = stack.back();
+        const Node &cur = tree[k];
+        stack.pop_back();
+        if (!box_overlaps(cur.lo, cur.hi, q_lo, q_hi))
+            continue;
+
+        if (cur.right == 0)
+        {
+            for (size_t i = cur.begin; i < cur.end; ++i)
+                if (box_overlaps(lo[i], hi[i], q_lo, q_hi))
+                    dst.push_back(entry[i]);
+        }
+        else
+        {
+            stack.push_back(cur.right);
+            stack.push_back(k + 1);
+        }
+    }
+    std::sort(dst.begin(), dst.end(), [](const Cell *a, const Cell *b) { return a->index < b->index; });
+}
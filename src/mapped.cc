@@ -0,0 +1,45 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../inc/error.h"
+#include "../inc/mapped.h"
+
+MappedFile::MappedFile(const std::string &path) :
+    ptr(nullptr),
+    len(0)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw failed_to_open_file(path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw failed_to_open_file(path);
+    }
+
+    len = static_cast<size_t>(st.st_size);
+    if (len > 0)
+    {
+        void *addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            throw failed_to_open_file(path);
+        }
+        madvise(addr, len, MADV_SEQUENTIAL);
+        madvise(addr, len, MADV_WILLNEED);
+        ptr = static_cast<const char *>(addr);
+    }
+
+    /// The mapping stays valid after closing the descriptor.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (ptr != nullptr)
+        munmap(const_cast<char *>(ptr), len);
+}
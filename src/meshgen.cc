@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "../inc/element.h"
+#include "../inc/misc.h"
+#include "../inc/topology.h"
+#include "../inc/meshgen.h"
+#include "../inc/profile.h"
+
+/// Local nodes of a block: corner "b" sits at (b & 1, (b >> 1) & 1, (b >> 2) & 1), 8 is the center.
+static const int CENTER = 8;
+
+/// Faces of the unit cube, on sides -x, +x, -y, +y, -z, +z.
+static const std::array<std::array<int, 4>, 6> CUBE_FACE = {{{0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6}}};
+
+/**
+ * Subdivision of one block.
+ * Blocks are translated copies of each other, so sub-faces on opposite sides of a block,
+ * listed in the same order, coincide across neighbouring blocks.
+ */
+struct BlockTemplate
+{
+    struct LocalFace
+    {
+        std::vector<int> node;
+        int c0, c1; /// Local cells, "c1" unused on sides
+    };
+
+    size_t n_cell;
+    bool center;
+    std::vector<LocalFace> internal;
+    std::vector<LocalFace> side[6];
+};
+
+/**
+ * Pair the faces of all sub-cells: faces lying on a side of the block go to that side,
+ * the others are shared by exactly two sub-cells.
+ */
+static void classify(const std::vector<std::vector<std::vector<int>>> &sub, BlockTemplate &dst)
+{
+    dst.n_cell = sub.size();
+    dst.center = false;
+
+    std::map<std::vector<int>, size_t> open;
+    for (size_t c = 0; c < sub.size(); ++c)
+    {
+        for (const auto &f : sub[c])
+        {
+            int on_side = -1;
+            for (int s = 0; s < 6 && on_side < 0; ++s)
+            {
+                const int bit = 1 << (s / 2), val = s % 2 ? bit : 0;
+                if (std::all_of(f.begin(), f.end(), [bit, val](int n) { return n != CENTER && (n & bit) == val; }))
+                    on_side = s;
+            }
+            for (auto n : f)
+                dst.center |= n == CENTER;
+
+            if (on_side >= 0)
+            {
+                dst.side[on_side].push_back({f, static_cast<int>(c), -1});
+                continue;
+            }
+
+            std::vector<int> key(f);
+            std::sort(key.begin(), key.end());
+            auto it = open.find(key);
+            if (it == open.end())
+            {
+                open[key] = dst.internal.size();
+                dst.internal.push_back({f, static_cast<int>(c), -1});
+            }
+            else
+            {
+                dst.internal[it->second].c1 = c;
+                open.erase(it);
+            }
+        }
+    }
+    if (!open.empty())
+        throw inconsistent_connectivity("Block subdivision is not closed.");
+
+    /// Match opposite sides by their nodes projected onto the side
+    for (int s = 0; s < 6; ++s)
+    {
+        const int bit = 1 << (s / 2);
+        std::sort(dst.side[s].begin(), dst.side[s].end(), [bit](const BlockTemplate::LocalFace &a, const BlockTemplate::LocalFace &b) {
+            std::vector<int> ka, kb;
+            for (auto n : a.node)
+                ka.push_back(n & ~bit);
+            for (auto n : b.node)
+                kb.push_back(n & ~bit);
+            std::sort(ka.begin(), ka.end());
+            std::sort(kb.begin(), kb.end());
+            return ka < kb;
+        });
+    }
+}
+
+static void make_template(FLM_GEN_SHAPE shape, BlockTemplate &dst)
+{
+    std::vector<std::vector<std::vector<int>>> sub;
+    switch (shape)
+    {
+    case FLM_GEN_SHAPE::Hex:
+    {
+        sub.emplace_back();
+        for (const auto &q : CUBE_FACE)
+            sub.back().emplace_back(q.begin(), q.end());
+        break;
+    }
+    case FLM_GEN_SHAPE::Tet:
+    {
+        /// Paths from corner 0 to corner 7 along the edges, one tetrahedron each
+        int axis[3] = {1, 2, 4};
+        do
+        {
+            const int v[4] = {0, axis[0], axis[0] | axis[1], 7};
+            sub.push_back({{v[0], v[1], v[2]}, {v[0], v[1], v[3]}, {v[0], v[2], v[3]}, {v[1], v[2], v[3]}});
+        } while (std::next_permutation(axis, axis + 3));
+        break;
+    }
+    case FLM_GEN_SHAPE::Prism:
+    {
+        for (const auto &t : {std::array<int, 3>{0, 1, 3}, std::array<int, 3>{0, 3, 2}})
+        {
+            sub.push_back({{t[0], t[1], t[2]}, {t[0] + 4, t[1] + 4, t[2] + 4}});
+            for (int j = 0; j < 3; ++j)
+                sub.back().push_back({t[j], t[(j + 1) % 3], t[(j + 1) % 3] + 4, t[j] + 4});
+        }
+        break;
+    }
+    case FLM_GEN_SHAPE::Pyramid:
+    {
+        for (const auto &q : CUBE_FACE)
+        {
+            sub.push_back({{q[0], q[1], q[2], q[3]}});
+            for (int j = 0; j < 4; ++j)
+                sub.back().push_back({q[j], q[(j + 1) % 4], CENTER});
+        }
+        break;
+    }
+    default:
+        throw std::invalid_argument("Unknown cell shape.");
+    }
+    classify(sub, dst);
+}
+
+bool is_mesh_spec(const std::string &str)
+{
+    return str.compare(0, 4, "gen:") == 0;
+}
+
+/**
+ * Parse "gen:SHAPE:N" or "gen:SHAPE:NXxNYxNZ", optionally followed by ":PERTURBATION" and ":SEED".
+ * SHAPE is one of "hex", "tet", "prism" and "pyramid".
+ */
+void parse_mesh_spec(const std::string &str, FLM_MESH_SPEC &dst)
+{
+    if (!is_mesh_spec(str))
+        throw std::invalid_argument("Not a mesh specification: \"" + str + "\".");
+
+    std::vector<std::string> part;
+    std::istringstream ss(str.substr(4));
+    for (std::string e; std::getline(ss, e, ':');)
+        part.push_back(e);
+    if (part.size() < 2 || part.size() > 4)
+        throw std::invalid_argument("Invalid mesh specification: \"" + str + "\".");
+
+    if (part[0] == "hex")
+        dst.shape = FLM_GEN_SHAPE::Hex;
+    else if (part[0] == "tet")
+        dst.shape = FLM_GEN_SHAPE::Tet;
+    else if (part[0] == "prism")
+        dst.shape = FLM_GEN_SHAPE::Prism;
+    else if (part[0] == "pyramid")
+        dst.shape = FLM_GEN_SHAPE::Pyramid;
+    else
+        throw std::invalid_argument("Unknown cell shape: \"" + part[0] + "\".");
+
+    char sep1 = 0, sep2 = 0;
+    unsigned long long n[3] = {0, 0, 0};
+    const int cnt = std::sscanf(part[1].c_str(), "%llu%c%llu%c%llu", &n[0], &sep1, &n[1], &sep2, &n[2]);
+    if (cnt == 1)
+        n[1] = n[2] = n[0];
+    else if (cnt != 5 || sep1 != 'x' || sep2 != 'x')
+        throw std::invalid_argument("Invalid block counts: \"" + part[1] + "\".");
+    if (n[0] == 0 || n[1] == 0 || n[2] == 0)
+        throw std::invalid_argument("Block counts must be positive.");
+    dst.nx = n[0];
+    dst.ny = n[1];
+    dst.nz = n[2];
+
+    dst.perturbation = part.size() > 2 ? std::stod(part[2]) : 0.0;
+    dst.seed = part.size() > 3 ? std::stoull(part[3]) : 0;
+    if (!(dst.perturbation >= 0.0 && dst.perturbation < 0.5))
+        throw std::invalid_argument("Perturbation must be in [0, 0.5).");
+}
+
+/**
+ * Uniform in [-0.5, 0.5), depending only on the seed, the node and the axis,
+ * so the mesh is identical regardless of thread count.
+ */
+static FLM_SCALAR jitter(uint64_t seed, uint64_t idx, int axis)
+{
+    const uint64_t key[2] = {idx, static_cast<uint64_t>(axis)};
+    return static_cast<FLM_SCALAR>(hash64(key, sizeof(key), seed) >> 11) * 0x1.0p-53 - 0.5;
+}
+
+/**
+ * Build a synthetic mesh in memory, replacing the global containers.
+ * Geometric quantities are evaluated as for any face-based mesh, see "build_mesh".
+ * @param spec Shape, resolution and perturbation.
+ */
+void generate_mesh(const FLM_MESH_SPEC &spec)
+{
+    FLM_PROFILE("generate_mesh");
+
+    BlockTemplate tpl;
+    make_template(spec.shape, tpl);
+
+    const size_t nx = spec.nx, ny = spec.ny, nz = spec.nz;
+    const size_t NumOfBlock = nx * ny * nz;
+    const size_t NumOfLattice = (nx + 1) * (ny + 1) * (nz + 1);
+    const size_t NumOfNode = NumOfLattice + (tpl.center ? NumOfBlock : 0);
+    const size_t NumOfCell = NumOfBlock * tpl.n_cell;
+    if (NumOfNode > UINT32_MAX || NumOfCell > UINT32_MAX)
+        throw std::invalid_argument("Too many entities for 32-bit indices.");
+
+    auto lattice = [nx, ny](size_t i, size_t j, size_t k) { return i + (nx + 1) * (j + (ny + 1) * k); };
+    auto block = [nx, ny](size_t i, size_t j, size_t k) { return i + nx * (j + ny * k); };
+
+    /// Nodes, with interior lattice nodes perturbed and centers at the average of their corners
+    std::vector<double> coordinate(3 * NumOfNode);
+    const FLM_SCALAR h[3] = {1.0 / nx, 1.0 / ny, 1.0 / nz};
+#pragma omp parallel for schedule(static)
+    for (size_t k = 0; k <= nz; ++k)
+        for (size_t j = 0; j <= ny; ++j)
+            for (size_t i = 0; i <= nx; ++i)
+            {
+                const size_t n = lattice(i, j, k);
+                const size_t ijk[3] = {i, j, k}, len[3] = {nx, ny, nz};
+                const bool interior = i > 0 && i < nx && j > 0 && j < ny && k > 0 && k < nz;
+                for (int d = 0; d < 3; ++d)
+                {
+                    coordinate[3 * n + d] = ijk[d] == len[d] ? 1.0 : ijk[d] * h[d];
+                    if (interior && spec.perturbation > 0.0)
+                        coordinate[3 * n + d] += 2.0 * spec.perturbation * h[d] * jitter(spec.seed, n, d);
+                }
+            }
+    if (tpl.center)
+    {
+#pragma omp parallel for schedule(static)
+        for (size_t k = 0; k < nz; ++k)
+            for (size_t j = 0; j < ny; ++j)
+                for (size_t i = 0; i < nx; ++i)
+                {
+                    const size_t n = NumOfLattice + block(i, j, k);
+                    for (int d = 0; d < 3; ++d)
+                    {
+                        double s = 0.0;
+                        for (int b = 0; b < 8; ++b)
+                            s += coordinate[3 * lattice(i + (b & 1), j + ((b >> 1) & 1), k + ((b >> 2) & 1)) + d];
+                        coordinate[3 * n + d] = s / 8;
+                    }
+                }
+    }
+
+    /// Faces: inside each block first, then on the x, y and z lattice planes
+    std::vector<uint64_t> fn_ptr(1, 0);
+    std::vector<uint32_t> fn_idx, fc;
+    std::vector<std::vector<uint32_t>> pf(6);
+    auto add_face = [&](size_t i, size_t j, size_t k, const std::vector<int> &local, size_t c0, size_t c1) {
+        for (auto b : local)
+        {
+            const size_t n = b == CENTER ? NumOfLattice + block(i, j, k) : lattice(i + (b & 1), j + ((b >> 1) & 1), k + ((b >> 2) & 1));
+            fn_idx.push_back(n + 1);
+        }
+        fn_ptr.push_back(fn_idx.size());
+        fc.push_back(c0);
+        fc.push_back(c1);
+        return fc.size() / 2;
+    };
+    auto cell_of = [&tpl, &block](size_t i, size_t j, size_t k, int local) { return block(i, j, k) * tpl.n_cell + local + 1; };
+
+    for (size_t k = 0; k < nz; ++k)
+        for (size_t j = 0; j < ny; ++j)
+            for (size_t i = 0; i < nx; ++i)
+                for (const auto &f : tpl.internal)
+                    add_face(i, j, k, f.node, cell_of(i, j, k, f.c0), cell_of(i, j, k, f.c1));
+
+    /// Side "2 * axis" of a block coincides with side "2 * axis + 1" of its predecessor along "axis"
+    const size_t len[3] = {nx, ny, nz};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const auto &lo_side = tpl.side[2 * axis], &hi_side = tpl.side[2 * axis + 1];
+        size_t idx[3];
+        for (idx[2] = 0; idx[2] < nz + (axis == 2); ++idx[2])
+            for (idx[1] = 0; idx[1] < ny + (axis == 1); ++idx[1])
+                for (idx[0] = 0; idx[0] < nx + (axis == 0); ++idx[0])
+                {
+                    const bool has_prev = idx[axis] > 0, has_next = idx[axis] < len[axis];
+                    size_t prev[3] = {idx[0], idx[1], idx[2]};
+                    if (has_prev)
+                        --prev[axis];
+                    for (size_t m = 0; m < lo_side.size(); ++m)
+                    {
+                        const size_t c0 = has_prev ? cell_of(prev[0], prev[1], prev[2], hi_side[m].c0) : 0;
+                        const size_t c1 = has_next ? cell_of(idx[0], idx[1], idx[2], lo_side[m].c0) : 0;
+                        const size_t f = has_prev ? add_face(prev[0], prev[1], prev[2], hi_side[m].node, c0, c1)
+                                                  : add_face(idx[0], idx[1], idx[2], lo_side[m].node, c0, c1);
+                        if (!has_prev)
+                            pf[2 * axis].push_back(f);
+                        else if (!has_next)
+                            pf[2 * axis + 1].push_back(f);
+                    }
+                }
+    }
+
+    /// Patches, in the order of "case/cavity"
+    static const char *NAME[6] = {"LEFT", "RIGHT", "FRONT", "BACK", "DOWN", "UP"};
+    static const int ORDER[6] = {5, 4, 0, 1, 2, 3};
+    std::vector<uint64_t> pf_ptr(1, 0);
+    std::vector<uint32_t> pf_idx;
+    FLM_FACE_MESH src;
+    for (auto s : ORDER)
+    {
+        src.patch_name.emplace_back(NAME[s]);
+        pf_idx.insert(pf_idx.end(), pf[s].begin(), pf[s].end());
+        pf_ptr.push_back(pf_idx.size());
+    }
+
+    if (fc.size() / 2 > UINT32_MAX)
+        throw std::invalid_argument("Too many entities for 32-bit indices.");
+
+    src.NumOfNode = NumOfNode;
+    src.NumOfFace = fc.size() / 2;
+    src.NumOfCell = NumOfCell;
+    src.coordinate = coordinate.data();
+    src.face_node_ptr = fn_ptr.data();
+    src.face_node_idx = fn_idx.data();
+    src.face_cell = fc.data();
+    src.patch_face_ptr = pf_ptr.data();
+    src.patch_face_idx = pf_idx.data();
+    build_mesh(src);
+}
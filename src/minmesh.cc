@@ -0,0 +1,144 @@
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/binfile.h"
+#include "../inc/topology.h"
+#include "../inc/binmesh.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const char MAGIC[8] = {'D', '3', 'D', 'M', 'E', 'S', 'H', 'M'};
+
+/// Counts stored in the header.
+enum : size_t
+{
+    NUM_OF_NODE = 0,
+    NUM_OF_FACE = 1,
+    NUM_OF_CELL = 2,
+    NUM_OF_PATCH = 3
+};
+
+/// Sections, in file order.
+/// Only what cannot be derived is stored, see "build_mesh".
+enum : size_t
+{
+    NODE_COORD = 0, /// double[3N]
+    FACE_NODE_PTR, /// uint64[F+1]
+    FACE_NODE_IDX, /// uint32[]
+    FACE_CELL, /// uint32[2F], c0 and c1
+    PATCH_NAME_PTR, /// uint64[P+1]
+    PATCH_NAME_CHAR, /// char[]
+    PATCH_FACE_PTR, /// uint64[P+1]
+    PATCH_FACE_IDX, /// uint32[]
+    NUM_OF_SECTION
+};
+
+bool is_minimal_mesh(const std::string &path)
+{
+    return has_magic(path, MAGIC);
+}
+
+/**
+ * Load computation mesh in minimal binary format.
+ * Connectivity and geometric quantities absent from the file are rebuilt in memory.
+ * @param path Path to the minimal mesh file.
+ */
+void read_mesh_minimal(const std::string &path)
+{
+    FLM_PROFILE("read_mesh_minimal");
+    SectionReader src(path, MAGIC, FLM_MINMESH_VERSION, NUM_OF_SECTION);
+
+    FLM_FACE_MESH desc;
+    desc.NumOfNode = src.get_count(NUM_OF_NODE);
+    desc.NumOfFace = src.get_count(NUM_OF_FACE);
+    desc.NumOfCell = src.get_count(NUM_OF_CELL);
+    const size_t NumOfPatch = src.get_count(NUM_OF_PATCH);
+
+    desc.coordinate = src.get<double>(NODE_COORD, 3 * desc.NumOfNode);
+    desc.face_node_ptr = src.get<uint64_t>(FACE_NODE_PTR, desc.NumOfFace + 1);
+    desc.face_node_idx = src.get<uint32_t>(FACE_NODE_IDX, src.length<uint32_t>(FACE_NODE_IDX));
+    desc.face_cell = src.get<uint32_t>(FACE_CELL, 2 * desc.NumOfFace);
+
+    auto name_ptr = src.get<uint64_t>(PATCH_NAME_PTR, NumOfPatch + 1);
+    auto name_char = src.get<char>(PATCH_NAME_CHAR, src.length<char>(PATCH_NAME_CHAR));
+    desc.patch_face_ptr = src.get<uint64_t>(PATCH_FACE_PTR, NumOfPatch + 1);
+    desc.patch_face_idx = src.get<uint32_t>(PATCH_FACE_IDX, src.length<uint32_t>(PATCH_FACE_IDX));
+
+    /// Offsets are trusted by "build_mesh" once their ends are checked.
+    if (desc.face_node_ptr[desc.NumOfFace] != src.length<uint32_t>(FACE_NODE_IDX) ||
+        !std::is_sorted(desc.face_node_ptr, desc.face_node_ptr + desc.NumOfFace + 1) ||
+        desc.patch_face_ptr[NumOfPatch] != src.length<uint32_t>(PATCH_FACE_IDX) ||
+        !std::is_sorted(desc.patch_face_ptr, desc.patch_face_ptr + NumOfPatch + 1) ||
+        name_ptr[NumOfPatch] != src.length<char>(PATCH_NAME_CHAR) ||
+        !std::is_sorted(name_ptr, name_ptr + NumOfPatch + 1))
+        throw invalid_file_format(path, "corrupted connectivity offsets.");
+
+    for (size_t i = 0; i < NumOfPatch; ++i)
+        desc.patch_name.emplace_back(name_char + name_ptr[i], name_ptr[i + 1] - name_ptr[i]);
+
+    build_mesh(desc);
+}
+
+/**
+ * Dump the loaded mesh in minimal binary format.
+ * @param path Path to the output file.
+ */
+void write_mesh_minimal(const std::string &path)
+{
+    FLM_PROFILE("write_mesh_minimal");
+    if (std::max({node.size(), face.size(), cell.size()}) > UINT32_MAX)
+        throw std::overflow_error("Too many entities for 32-bit references.");
+
+    SectionWriter dst(MAGIC, FLM_MINMESH_VERSION, NUM_OF_SECTION);
+    dst.set_count(NUM_OF_NODE, node.size());
+    dst.set_count(NUM_OF_FACE, face.size());
+    dst.set_count(NUM_OF_CELL, cell.size());
+    dst.set_count(NUM_OF_PATCH, patch.size());
+
+    {
+        std::vector<double> coord;
+        coord.reserve(3 * node.size());
+        for (auto n : node)
+            coord.insert(coord.end(), n->coordinate.data(), n->coordinate.data() + 3);
+        dst.put(NODE_COORD, coord);
+    }
+
+    {
+        std::vector<uint64_t> ptr{0};
+        std::vector<uint32_t> idx, adj;
+        for (auto f : face)
+        {
+            for (auto n : f->vertex)
+                idx.push_back(n->index);
+            ptr.push_back(idx.size());
+            adj.push_back(f->c0 ? f->c0->index : 0);
+            adj.push_back(f->c1 ? f->c1->index : 0);
+        }
+        dst.put(FACE_NODE_PTR, ptr);
+        dst.put(FACE_NODE_IDX, idx);
+        dst.put(FACE_CELL, adj);
+    }
+
+    {
+        std::vector<uint64_t> name_ptr{0}, face_ptr{0};
+        std::vector<char> name;
+        std::vector<uint32_t> face_idx;
+        for (auto p : patch)
+        {
+            name.insert(name.end(), p->name.begin(), p->name.end());
+            name_ptr.push_back(name.size());
+            for (auto f : p->surface)
+                face_idx.push_back(f->index);
+            face_ptr.push_back(face_idx.size());
+        }
+        dst.put(PATCH_NAME_PTR, name_ptr);
+        dst.put(PATCH_NAME_CHAR, name);
+        dst.put(PATCH_FACE_PTR, face_ptr);
+        dst.put(PATCH_FACE_IDX, face_idx);
+    }
+
+    dst.write(path);
+}
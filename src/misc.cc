@@ -1,11 +1,15 @@
 #include <chrono>
 #include <sstream>
 #include <iomanip>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <sys/resource.h>
 #include "../inc/misc.h"
 
-FLM_SCALAR duration(const clock_t &startTime, const clock_t &endTime)
+FLM_SCALAR duration(const std::chrono::steady_clock::time_point &startTime, const std::chrono::steady_clock::time_point &endTime)
 {
-    return static_cast<FLM_SCALAR>(endTime - startTime) / CLOCKS_PER_SEC;
+    return std::chrono::duration<FLM_SCALAR>(endTime - startTime).count();
 }
 
 void runtime_str(std::string &ret)
@@ -15,3 +19,59 @@ void runtime_str(std::string &ret)
     ss << std::put_time(std::localtime(&tt), "%Y%m%d-%H%M%S");
     ret = ss.str();
 }
+
+/**
+ * Non-cryptographic 64-bit hash, processing 8 bytes per step.
+ * Chain calls through "seed" to hash non-contiguous data.
+ * @param data Start of the data.
+ * @param bytes Length of the data.
+ * @param seed Result of a previous call, or 0.
+ * @return The hash value.
+ */
+uint64_t hash64(const void *data, size_t bytes, uint64_t seed)
+{
+    static const uint64_t PRIME = 0x100000001b3ULL;
+    uint64_t h = seed ^ 0xcbf29ce484222325ULL;
+
+    auto p = static_cast<const unsigned char *>(data);
+    for (; bytes >= 8; bytes -= 8, p += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ w) * PRIME;
+        h ^= h >> 29;
+    }
+    for (; bytes > 0; --bytes, ++p)
+        h = (h ^ *p) * PRIME;
+
+    /// Final avalanche
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Resident set size of the current process.
+ * @return Bytes, or 0 if not available.
+ */
+size_t resident_memory()
+{
+    std::ifstream in("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(in >> pages >> resident))
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Peak resident set size of the current process since it started.
+ * @return Bytes.
+ */
+size_t peak_resident_memory()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include "../inc/reduction.h"
+#include "../inc/locator.h"
+#include "../inc/monitor.h"
+#include "../inc/spatial.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const char MAGIC[8] = {'D', '3', 'D', 'M', 'O', 'N', 'I', 'T'};
+
+/**
+ * Prepare all monitors and the output.
+ * Probes are located once here, which requires geometric quantities to be ready.
+ * @param config Path to the configuration.
+ * @param output Path to the output.
+ * @param resume Append to an existing output instead of replacing it.
+ * @param locator Spatial index over all cells.
+ */
+Monitor::Monitor(const std::string &config, const std::string &output, bool resume, const CellLocator &locator) :
+    binary(std::filesystem::path(output).extension() == ".bin")
+{
+    parse(config, locator);
+    value.resize(item.size());
+    open(output, resume);
+}
+
+void Monitor::parse(const std::string &config, const CellLocator &locator)
+{
+    std::ifstream in(config);
+    if (in.fail())
+        throw failed_to_open_file(config);
+
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line))
+    {
+        ++line_no;
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string kind;
+        if (!(ss >> kind))
+            continue;
+
+        Item dst;
+        if (!(ss >> dst.name))
+            throw invalid_file_format(config, "missing name on line " + std::to_string(line_no) + ".");
+        for (const auto &e : item)
+            if (e.name == dst.name)
+                throw invalid_file_format(config, "duplicated name \"" + dst.name + "\" on line " + std::to_string(line_no) + ".");
+
+        if (kind == "probe")
+        {
+            dst.kind = KIND::Probe;
+            if (!(ss >> dst.x.x() >> dst.x.y() >> dst.x.z()))
+                throw invalid_file_format(config, "missing coordinates on line " + std::to_string(line_no) + ".");
+            dst.c = locator.locate(dst.x);
+            dst.area = 0.0;
+            if (dst.c == nullptr)
+            {
+                dst.c = locator.nearest(dst.x);
+                std::cout << "\nWarning: probe \"" << dst.name << "\" is outside the mesh, using nearest cell " << dst.c->index << "." << std::endl;
+            }
+        }
+        else if (kind == "flux" || kind == "average")
+        {
+            dst.kind = kind == "flux" ? KIND::Flux : KIND::Average;
+            dst.c = nullptr;
+            std::string name;
+            while (ss >> name)
+            {
+                auto it = std::find_if(patch.begin(), patch.end(), [&name](const Patch *p) { return p->name == name; });
+                if (it == patch.end())
+                    throw invalid_file_format(config, "unknown patch \"" + name + "\" on line " + std::to_string(line_no) + ".");
+                dst.surface.insert(dst.surface.end(), (*it)->surface.begin(), (*it)->surface.end());
+            }
+            if (dst.surface.empty())
+                throw invalid_file_format(config, "no patch on line " + std::to_string(line_no) + ".");
+
+            std::sort(dst.surface.begin(), dst.surface.end(), [](const BoundaryFace *a, const BoundaryFace *b) { return a->index < b->index; });
+            dst.surface.erase(std::unique(dst.surface.begin(), dst.surface.end()), dst.surface.end());
+            const auto &s = dst.surface;
+            dst.area = reduce_sum(s.size(), [&s](size_t i) { return s[i]->area; });
+        }
+        else
+            throw invalid_file_format(config, "unknown monitor \"" + kind + "\" on line " + std::to_string(line_no) + ".");
+
+        item.push_back(std::move(dst));
+    }
+}
+
+/**
+ * A new output starts with the column names:
+ * a CSV header, or the magic, the number of columns and the null-terminated names.
+ * Binary records are "uint64 iter, double t" followed by one double per monitor.
+ */
+void Monitor::open(const std::string &output, bool resume)
+{
+    const bool append = resume && std::filesystem::exists(output);
+    std::ios::openmode mode = std::ios::out | (append ? std::ios::app : std::ios::trunc);
+    if (binary)
+        mode |= std::ios::binary;
+    out.open(output, mode);
+    if (out.fail())
+        throw failed_to_open_file(output);
+    if (append)
+        return;
+
+    if (binary)
+    {
+        const uint64_t n = item.size();
+        out.write(MAGIC, 8);
+        out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        for (const auto &e : item)
+            out.write(e.name.c_str(), e.name.size() + 1);
+    }
+    else
+    {
+        out << "iter,t";
+        for (const auto &e : item)
+            out << ',' << e.name;
+        out << '\n';
+    }
+}
+
+/**
+ * Evaluate all monitors on the current field and append one record.
+ * Patch sums go through "reduce_sum", so results are reproducible regardless of thread count.
+ */
+void Monitor::record(size_t iter, FLM_SCALAR t)
+{
+    FLM_PROFILE("Monitor::record");
+    for (size_t k = 0; k < item.size(); ++k)
+    {
+        const auto &e = item[k];
+        const auto &s = e.surface;
+        switch (e.kind)
+        {
+        case KIND::Probe:
+            value[k] = e.c->T + e.c->grad_T.dot(e.x - e.c->centroid);
+            break;
+        case KIND::Flux:
+            value[k] = reduce_sum(s.size(), [&s](size_t i) { return boundary_flux(s[i]); }, FLM_REDUCTION::Compensated);
+            break;
+        case KIND::Average:
+            value[k] = reduce_sum(s.size(), [&s](size_t i) { return s[i]->T * s[i]->area; }) / e.area;
+            break;
+        }
+    }
+
+    if (binary)
+    {
+        const uint64_t i = iter;
+        const double tt = t;
+        out.write(reinterpret_cast<const char *>(&i), sizeof(i));
+        out.write(reinterpret_cast<const char *>(&tt), sizeof(tt));
+        out.write(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(FLM_SCALAR));
+    }
+    else
+    {
+        out.precision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+        out << iter << ',' << t;
+        for (auto v : value)
+            out << ',' << v;
+        out << '\n';
+    }
+}
+
+void Monitor::flush()
+{
+    out.flush();
+}
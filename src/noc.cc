@@ -21,9 +21,21 @@ static inline void OverRelaxed(const FLM_VECTOR &d, const FLM_VECTOR &S, FLM_VEC
  * @param S Local surface outward normal vector.
  * @param E Orthogonal part after decomposing "S".
  * @param T Non-Orthogonal part after decomposing "S", satisfying "S = E + T".
+ * @param variant How the magnitude of "E" is chosen.
  */
-void noc_decompose(const FLM_VECTOR &d, const FLM_VECTOR &S, FLM_VECTOR &E, FLM_VECTOR &T)
+void noc_decompose(const FLM_VECTOR &d, const FLM_VECTOR &S, FLM_VECTOR &E, FLM_VECTOR &T, FLM_NOC variant)
 {
-    OverRelaxed(d, S, E);
+    switch (variant)
+    {
+    case FLM_NOC::Minimum:
+        Minimum(d, S, E);
+        break;
+    case FLM_NOC::Orthogonal:
+        Orthogonal(d, S, E);
+        break;
+    case FLM_NOC::OverRelaxed:
+        OverRelaxed(d, S, E);
+        break;
+    }
     T = S - E;
 }
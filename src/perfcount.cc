@@ -0,0 +1,204 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../inc/perfcount.h"
+
+/// Events of the calling thread, user space only so that the default paranoia level is enough.
+static const uint64_t HW_EVENT[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+
+/// Set once by "perf_counters_init", read-only afterwards.
+static bool hw_ok[3] = {false, false, false};
+static std::vector<int> dram_fd;
+static std::vector<double> dram_scale; /// Bytes per count
+
+static int open_event(perf_event_attr &attr, pid_t pid, int cpu, int group)
+{
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, cpu, group, 0UL));
+}
+
+/**
+ * Counters of one thread, read in a single call as a group.
+ * "slot" maps each event to its position in the group, or -1 if it could not be opened.
+ */
+struct ThreadCounters
+{
+    bool opened = false;
+    int leader = -1;
+    std::vector<int> fd;
+    int slot[3] = {-1, -1, -1};
+
+    void open()
+    {
+        opened = true;
+        for (int k = 0; k < 3; ++k)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = HW_EVENT[k];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            const int e = open_event(attr, 0, -1, leader);
+            if (e < 0)
+            {
+                if (leader < 0)
+                    return;
+                continue;
+            }
+            if (leader < 0)
+                leader = e;
+            slot[k] = fd.size();
+            fd.push_back(e);
+        }
+    }
+
+    ~ThreadCounters()
+    {
+        for (auto e : fd)
+            close(e);
+    }
+};
+
+static thread_local ThreadCounters mine;
+
+static std::string read_line(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string ret;
+    std::getline(in, ret);
+    return ret;
+}
+
+/**
+ * Encode "event=0x04,umask=0x03" of an uncore event into "perf_event_attr::config",
+ * following the bit ranges published in the "format" directory of the PMU.
+ */
+static bool parse_event(const std::string &pmu, const std::string &spec, uint64_t &config)
+{
+    config = 0;
+    size_t pos = 0;
+    while (pos < spec.size())
+    {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos)
+            end = spec.size();
+        const std::string term = spec.substr(pos, end - pos);
+        pos = end + 1;
+
+        const size_t eq = term.find('=');
+        const std::string name = term.substr(0, eq);
+        const uint64_t val = eq == std::string::npos ? 1 : std::stoull(term.substr(eq + 1), nullptr, 0);
+
+        const std::string fmt = read_line(pmu + "/format/" + name);
+        unsigned lo, hi;
+        const int n = std::sscanf(fmt.c_str(), "config:%u-%u", &lo, &hi);
+        if (n < 1)
+            return false;
+        config |= val << lo;
+    }
+    return true;
+}
+
+/**
+ * Memory controller traffic, counted system-wide on the integrated memory controllers.
+ * Needs "perf_event_paranoid" at most 0, so failing here is expected on most machines.
+ */
+static void open_dram()
+{
+    for (int i = 0;; ++i)
+    {
+        const std::string pmu = "/sys/bus/event_source/devices/uncore_imc_" + std::to_string(i);
+        const std::string type = read_line(pmu + "/type");
+        if (type.empty())
+            break;
+        const int cpu = std::atoi(read_line(pmu + "/cpumask").c_str());
+
+        for (const char *ev : {"cas_count_read", "cas_count_write"})
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = std::stoul(type);
+            uint64_t config;
+            if (!parse_event(pmu, read_line(pmu + "/events/" + ev), config))
+                continue;
+            attr.config = config;
+
+            const int e = open_event(attr, -1, cpu, -1);
+            if (e < 0)
+                continue;
+            double scale = std::atof(read_line(pmu + "/events/" + ev + ".scale").c_str());
+            if (read_line(pmu + "/events/" + ev + ".unit") == "MiB")
+                scale *= 1024.0 * 1024.0;
+            dram_fd.push_back(e);
+            dram_scale.push_back(scale > 0.0 ? scale : 64.0);
+        }
+    }
+}
+
+/**
+ * Probe hardware counters from the calling thread.
+ * Other threads open their own counters on first use.
+ * @param why Reason of the failure, if any.
+ * @return Whether cycles could be counted, the other events being optional.
+ */
+bool perf_counters_init(std::string &why)
+{
+    mine.open();
+    if (mine.leader < 0)
+    {
+        why = std::strerror(errno);
+        if (errno == EACCES || errno == EPERM)
+            why += ", see /proc/sys/kernel/perf_event_paranoid";
+        else if (errno == ENOENT || errno == EOPNOTSUPP)
+            why += ", no hardware PMU exposed to this system";
+        return false;
+    }
+    for (int k = 0; k < 3; ++k)
+        hw_ok[k] = mine.slot[k] >= 0;
+    open_dram();
+    return true;
+}
+
+bool perf_available(size_t event)
+{
+    return event == PERF_DRAM_BYTES ? !dram_fd.empty() : hw_ok[event];
+}
+
+/**
+ * Current totals for the calling thread, and system-wide DRAM traffic.
+ */
+void perf_read(PerfSample &dst)
+{
+    std::memset(dst.v, 0, sizeof(dst.v));
+
+    if (!mine.opened)
+        mine.open();
+    if (mine.leader >= 0)
+    {
+        uint64_t buf[1 + 3];
+        if (read(mine.leader, buf, sizeof(buf)) > 0)
+            for (int k = 0; k < 3; ++k)
+                if (mine.slot[k] >= 0 && static_cast<uint64_t>(mine.slot[k]) < buf[0])
+                    dst.v[k] = buf[1 + mine.slot[k]];
+    }
+
+    double bytes = 0.0;
+    for (size_t i = 0; i < dram_fd.size(); ++i)
+    {
+        uint64_t cnt;
+        if (read(dram_fd[i], &cnt, sizeof(cnt)) == sizeof(cnt))
+            bytes += dram_scale[i] * cnt;
+    }
+    dst.v[PERF_DRAM_BYTES] = static_cast<uint64_t>(std::llround(bytes));
+}
@@ -0,0 +1,160 @@
+#include <cmath>
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/poisson.h"
+#include "../inc/spatial.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+typedef Eigen::SparseMatrix<FLM_SCALAR, Eigen::RowMajor> SpMat;
+typedef Eigen::Matrix<FLM_SCALAR, Eigen::Dynamic, 1> VecX;
+
+/// Orthogonal part of the negative Laplacian, symmetric positive definite if any Dirichlet boundary exists
+static SpMat A;
+
+/// Row-major storage with both triangles lets Eigen run the product in parallel
+static Eigen::ConjugateGradient<SpMat, Eigen::Lower | Eigen::Upper> cg;
+
+/**
+ * Assemble the implicit part of the steady diffusion equation, with unit conductivity.
+ * Only the orthogonal part "S_E" of each face is implicit,
+ * the Non-Orthogonal part is deferred to the right-hand side.
+ * B.C. types must be set, B.C. values are NOT required.
+ */
+void prepare_poisson()
+{
+    FLM_PROFILE("prepare_poisson");
+    const size_t NumOfCell = cell.size();
+
+    std::vector<Eigen::Triplet<FLM_SCALAR>> coef;
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c = cell[i];
+        const size_t nF = c->surface.size();
+
+        FLM_SCALAR diag = 0.0;
+        for (size_t j = 0; j < nF; ++j)
+        {
+            auto curFace = c->surface[j];
+            const FLM_SCALAR E = c->S_E[j].norm() / c->d[j].norm();
+            if (curFace->at_boundary())
+            {
+                switch (curFace->parent->T)
+                {
+                case FLM_BC_MATH::Dirichlet:
+                    diag += E;
+                    break;
+                case FLM_BC_MATH::Neumann:
+                    break;
+                default:
+                    throw unsupported_boundary_condition(curFace->parent->T);
+                }
+            }
+            else
+            {
+                diag += E;
+                coef.emplace_back(i, c->cell_adjacency[j]->index - 1, -E);
+            }
+        }
+        coef.emplace_back(i, i, diag);
+    }
+
+    A.resize(NumOfCell, NumOfCell);
+    A.setFromTriplets(coef.begin(), coef.end());
+    cg.compute(A);
+}
+
+/**
+ * Solve the steady diffusion equation "div(grad(T)) = source" on cells,
+ * with deferred Non-Orthogonal correction.
+ * Each step recovers cell gradients from the latest field, moves their contribution to the right-hand side,
+ * and solves the orthogonal part by Conjugate Gradient, starting from the latest field.
+ * Before call to this function:
+ *   "prepare_poisson" should be called;
+ *   Dirichlet values and Neumann surface normal gradients should be updated;
+ *   Cell values are taken as the initial guess.
+ * @param source Source term per unit volume, in order of cell index.
+ * @param scheme Gradient reconstruction scheme used for the correction.
+ * @param tol Steps stop when no cell value changes by more than "tol" relative to the largest magnitude.
+ * @param max_outer Maximum number of correction steps.
+ * @param stat Convergence history.
+ */
+void solve_poisson(const std::vector<FLM_SCALAR> &source, FLM_GRADIENT scheme, FLM_SCALAR tol, size_t max_outer, FLM_POISSON_STAT &stat)
+{
+    FLM_PROFILE("solve_poisson");
+    const size_t NumOfCell = cell.size();
+
+    VecX x(NumOfCell), b(NumOfCell);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        x[i] = cell[i]->T;
+    interpolate_face_value();
+    interpolate_nodal_value();
+
+    cg.setTolerance(tol);
+    stat.outer = 0;
+    stat.inner = 0;
+    stat.correction = 0.0;
+    while (stat.outer < max_outer)
+    {
+        ++stat.outer;
+        calculate_cell_gradient(scheme);
+
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < NumOfCell; ++i)
+        {
+            auto c = cell[i];
+            const size_t nF = c->surface.size();
+
+            FLM_SCALAR rhs = -source[i] * c->volume;
+            for (size_t j = 0; j < nF; ++j)
+            {
+                auto curFace = c->surface[j];
+                if (curFace->at_boundary())
+                {
+                    if (curFace->parent->T == FLM_BC_MATH::Neumann)
+                        rhs += static_cast<BoundaryFace *>(curFace)->sn_grad_T * curFace->area;
+                    else
+                        rhs += c->S_E[j].norm() / c->d[j].norm() * curFace->T + c->grad_T.dot(c->S_T[j]);
+                }
+                else
+                {
+                    const auto &w = curFace->cell_weighting1;
+                    const FLM_VECTOR grad_f = w[0] * curFace->c0->grad_T + w[1] * curFace->c1->grad_T;
+                    rhs += grad_f.dot(c->S_T[j]);
+                }
+            }
+            b[i] = rhs;
+        }
+
+        x = cg.solveWithGuess(b, x);
+        stat.inner += cg.iterations();
+
+        FLM_SCALAR change = 0.0, scale = 0.0;
+#pragma omp parallel for schedule(static) reduction(max:change, scale)
+        for (size_t i = 0; i < NumOfCell; ++i)
+        {
+            change = std::max(change, std::abs(x[i] - cell[i]->T));
+            scale = std::max(scale, std::abs(x[i]));
+            cell[i]->T = x[i];
+        }
+        interpolate_face_value();
+        interpolate_nodal_value();
+
+        stat.correction = change;
+        if (!std::isfinite(change) || change <= tol * std::max(scale, FLM_SCALAR(1.0)))
+            break;
+    }
+
+    /// Consistency with the explicit operator used by time-stepping
+    std::vector<FLM_SCALAR> R;
+    calculate_cell_gradient(scheme);
+    calculate_residual(R);
+    stat.residual = 0.0;
+    for (size_t i = 0; i < NumOfCell; ++i)
+        stat.residual = std::max(stat.residual, std::abs(R[i] - source[i]));
+}
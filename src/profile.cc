@@ -0,0 +1,490 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../inc/profile.h"
+#include "../inc/perfcount.h"
+#include "../inc/alloctrack.h"
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic<bool> flm_profile_on(false);
+
+/**
+ * One completed scope.
+ * Times are in ns since tracing was turned on.
+ */
+struct TraceEvent
+{
+    uint32_t region;
+    uint32_t depth;
+    int64_t begin, dur;
+};
+
+/**
+ * Latest events of one thread, oldest overwritten first.
+ * Only the owning thread writes, so appending is a plain store followed by a release of "head".
+ */
+struct TraceRing
+{
+    std::vector<TraceEvent> buf;
+    std::atomic<uint64_t> head{0}; /// Number of events ever written
+};
+
+/**
+ * Call tree of one thread.
+ * "node[0]" is the root, and each node accumulates the scopes of one region under one parent.
+ */
+struct ThreadProfile
+{
+    struct Node
+    {
+        size_t region, parent;
+        std::vector<size_t> child;
+        size_t count;
+        double total, max; /// s
+        uint64_t counter[PERF_NUM];
+        double bytes, flops; /// Modelled work, see "profile_work"
+        AllocSample alloc;
+    };
+
+    struct Scope
+    {
+        size_t node;
+        Clock::time_point start;
+        PerfSample counter;
+        AllocSample alloc;
+    };
+
+    std::vector<Node> node;
+    std::vector<Scope> stack; /// Open scopes
+    TraceRing trace;
+    std::string name;
+};
+
+/// Shared by all threads, only touched on registration and reporting.
+static std::mutex mtx;
+static std::vector<std::string> region_name;
+static std::vector<std::unique_ptr<ThreadProfile>> thread_profile;
+static Clock::time_point enabled_at;
+static bool profiling = false;
+static bool counting = false;
+static double peak_bandwidth = 0.0; /// B/s, roofline columns are shown if positive
+
+/// Tracing state, fixed once turned on
+static bool tracing = false;
+static size_t trace_capacity = 0;
+static Clock::time_point trace_origin;
+static volatile std::sig_atomic_t trace_signal = 0;
+
+/// Owned by "thread_profile", so records survive their thread.
+static thread_local ThreadProfile *mine = nullptr;
+
+static void attach_thread()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    const bool was = alloc_exclude_thread(true);
+    thread_profile.push_back(std::make_unique<ThreadProfile>());
+    mine = thread_profile.back().get();
+    mine->node.push_back({SIZE_MAX, SIZE_MAX, {}, 0, 0.0, 0.0, {}, 0.0, 0.0, {0, 0}});
+    mine->trace.buf.resize(trace_capacity);
+    mine->name = "thread " + std::to_string(thread_profile.size() - 1);
+    alloc_exclude_thread(was);
+}
+
+/**
+ * Register a named region.
+ * @param name Label in the report, regions at different call sites may share it.
+ * @return Identifier of the region.
+ */
+size_t profile_region(const char *name)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    for (size_t i = 0; i < region_name.size(); ++i)
+        if (region_name[i] == name)
+            return i;
+
+    /// Once per call site, whenever it is first reached, so left out of "alloc_read_all"
+    const bool was = alloc_exclude_thread(true);
+    region_name.emplace_back(name);
+    alloc_exclude_thread(was);
+    return region_name.size() - 1;
+}
+
+/**
+ * Turn timing on or off.
+ * Scopes already open when the switch is flipped are closed consistently.
+ * Percentages in the report are relative to the wall time since profiling was turned on.
+ */
+void profile_enable(bool on)
+{
+    if (on && !profiling)
+        enabled_at = Clock::now();
+    profiling = on;
+    flm_profile_on.store(profiling || tracing);
+}
+
+/**
+ * Sample hardware counters around every timed scope, see "perf_read".
+ * Should be called once, before the first timed scope, and implies profiling.
+ * @param why Reason of the failure, if any.
+ * @return Whether counters are available, timing goes on regardless.
+ */
+bool profile_counters(std::string &why)
+{
+    profile_enable(true);
+    counting = perf_counters_init(why);
+    return counting;
+}
+
+/**
+ * Report achieved bandwidth and flop rate of regions that declare their work,
+ * and the bandwidth relative to that of the machine. Implies profiling.
+ * @param bandwidth Attainable memory bandwidth in B/s, e.g. from "stream_bandwidth".
+ */
+void profile_roofline(double bandwidth)
+{
+    profile_enable(true);
+    peak_bandwidth = bandwidth;
+}
+
+/**
+ * Add the modelled work of one call to the innermost open scope of the calling thread.
+ * Kernels call it once per call, from the thread that opened their region.
+ * @param bytes Bytes moved between memory and the core.
+ * @param flops Floating-point operations.
+ */
+void profile_work(double bytes, double flops)
+{
+    if (mine == nullptr || mine->stack.empty())
+        return;
+    auto &cur = mine->node[mine->stack.back().node];
+    cur.bytes += bytes;
+    cur.flops += flops;
+}
+
+static void on_trace_signal(int)
+{
+    trace_signal = 1;
+}
+
+/**
+ * Record a timeline of all timed scopes, to be exported by "trace_dump".
+ * Should be called once, before the first timed scope.
+ * SIGUSR1 then asks for a dump, see "trace_requested".
+ * @param capacity Number of events kept per thread.
+ */
+void trace_enable(size_t capacity)
+{
+    trace_capacity = std::max<size_t>(capacity, 1);
+    trace_origin = Clock::now();
+    tracing = true;
+    flm_profile_on.store(true);
+    std::signal(SIGUSR1, on_trace_signal);
+}
+
+/**
+ * Whether a dump was asked for by SIGUSR1 since the last call.
+ * Files are not written from the signal handler, so the solver polls this between steps.
+ */
+bool trace_requested()
+{
+    if (!trace_signal)
+        return false;
+    trace_signal = 0;
+    return true;
+}
+
+/**
+ * Label of the calling thread in the timeline.
+ * Unnamed threads are numbered in order of their first timed scope.
+ */
+void profile_thread_name(const char *name)
+{
+    if (!flm_profile_on.load())
+        return;
+    if (mine == nullptr)
+        attach_thread();
+    std::lock_guard<std::mutex> guard(mtx);
+    mine->name = name;
+}
+
+void profile_begin(size_t region)
+{
+    if (mine == nullptr)
+        attach_thread();
+
+    const size_t parent = mine->stack.empty() ? 0 : mine->stack.back().node;
+    size_t k = SIZE_MAX;
+    for (auto c : mine->node[parent].child)
+        if (mine->node[c].region == region)
+        {
+            k = c;
+            break;
+        }
+    /// The call tree and the stack only grow on the first visit of a path, left out of "alloc_read_all"
+    const bool was = alloc_exclude_thread(true);
+    if (k == SIZE_MAX)
+    {
+        k = mine->node.size();
+        mine->node.push_back({region, parent, {}, 0, 0.0, 0.0, {}, 0.0, 0.0, {0, 0}});
+        mine->node[parent].child.push_back(k);
+    }
+    mine->stack.push_back({k, {}, {}, {}});
+    alloc_exclude_thread(was);
+    auto &cur = mine->stack.back();
+    if (counting)
+        perf_read(cur.counter);
+    alloc_read(cur.alloc);
+    cur.start = Clock::now();
+}
+
+void profile_end()
+{
+    const auto stop = Clock::now();
+    const auto &open = mine->stack.back();
+    const auto start = open.start;
+    auto &cur = mine->node[open.node];
+    if (counting)
+    {
+        PerfSample now;
+        perf_read(now);
+        for (size_t j = 0; j < PERF_NUM; ++j)
+            cur.counter[j] += now.v[j] - open.counter.v[j];
+    }
+    {
+        AllocSample now;
+        alloc_read(now);
+        cur.alloc.count += now.count - open.alloc.count;
+        cur.alloc.bytes += now.bytes - open.alloc.bytes;
+    }
+    mine->stack.pop_back();
+
+    const double dt = std::chrono::duration<double>(stop - start).count();
+    ++cur.count;
+    cur.total += dt;
+    cur.max = std::max(cur.max, dt);
+
+    auto &ring = mine->trace;
+    if (!ring.buf.empty())
+    {
+        const uint64_t h = ring.head.load(std::memory_order_relaxed);
+        TraceEvent &e = ring.buf[h % ring.buf.size()];
+        e.region = cur.region;
+        e.depth = mine->stack.size();
+        e.begin = std::chrono::duration_cast<std::chrono::nanoseconds>(start - trace_origin).count();
+        e.dur = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+        ring.head.store(h + 1, std::memory_order_release);
+    }
+}
+
+/// Totals of one region along one call path, summed over threads.
+struct PathStat
+{
+    size_t count = 0;
+    double total = 0.0, max = 0.0;
+    uint64_t counter[PERF_NUM] = {};
+    double bytes = 0.0, flops = 0.0;
+    AllocSample alloc = {0, 0};
+};
+
+static void merge(const ThreadProfile &src, size_t k, std::vector<size_t> &path, std::map<std::vector<size_t>, PathStat> &dst)
+{
+    const auto &cur = src.node[k];
+    if (k != 0)
+    {
+        path.push_back(cur.region);
+        auto &e = dst[path];
+        e.count += cur.count;
+        e.total += cur.total;
+        e.max = std::max(e.max, cur.max);
+        for (size_t j = 0; j < PERF_NUM; ++j)
+            e.counter[j] += cur.counter[j];
+        e.bytes += cur.bytes;
+        e.flops += cur.flops;
+        e.alloc.count += cur.alloc.count;
+        e.alloc.bytes += cur.alloc.bytes;
+    }
+    for (auto c : cur.child)
+        merge(src, c, path, dst);
+    if (k != 0)
+        path.pop_back();
+}
+
+/**
+ * Print calls, total/mean/max wall time and share of the run for each region along each call path.
+ * With hardware counters, also IPC, LLC misses and DRAM traffic per call and per item,
+ * "-" marking events the machine does not provide. Counts include nested regions, like times.
+ * With a machine bandwidth from "profile_roofline", also achieved GB/s, GFLOP/s, flops per byte and
+ * share of the machine bandwidth, for regions that declare their work through "profile_work".
+ * With allocation tracking compiled in, also heap allocations and bytes per call, including nested regions.
+ * Should be called when no timed scope is open on other threads.
+ * @param out Destination of the table.
+ * @param n_item Number of items touched by a kernel call, typically cells, for per-item figures.
+ */
+void profile_report(std::ostream &out, size_t n_item)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    const double elapsed = std::chrono::duration<double>(Clock::now() - enabled_at).count();
+
+    /// Regions are numbered by first use, so the lexicographic order of paths follows the run
+    std::map<std::vector<size_t>, PathStat> stat;
+    std::vector<size_t> path;
+    for (const auto &e : thread_profile)
+        merge(*e, 0, path, stat);
+
+    const auto flags = out.flags();
+    const auto prec = out.precision();
+    const double per_item = n_item > 0 ? 1.0 / n_item : 1.0;
+    const char *item = n_item > 0 ? "/item" : "/call";
+    out << std::left << std::setw(40) << "Region" << std::right << std::setw(10) << "Calls" << std::setw(12) << "Total(s)" << std::setw(12) << "Mean(ms)" << std::setw(12) << "Max(ms)" << std::setw(9) << "%";
+    if (counting)
+        out << std::setw(8) << "IPC" << std::setw(14) << std::string("LLC miss") + item << std::setw(14) << std::string("DRAM B") + item;
+    const bool roofline = peak_bandwidth > 0.0;
+    if (roofline)
+        out << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << std::setw(8) << "F/B" << std::setw(8) << "%BW";
+    const bool allocs = alloc_tracking();
+    if (allocs)
+        out << std::setw(12) << "Alloc/call" << std::setw(12) << "B/call";
+    out << '\n';
+    out << std::string(95 + (counting ? 36 : 0) + (roofline ? 36 : 0) + (allocs ? 24 : 0), '-') << '\n';
+    for (const auto &e : stat)
+    {
+        const std::string label = std::string(2 * (e.first.size() - 1), ' ') + region_name[e.first.back()];
+        const PathStat &s = e.second;
+        out << std::left << std::setw(40) << label << std::right << std::setw(10) << s.count;
+        out << std::fixed << std::setprecision(4) << std::setw(12) << s.total;
+        out << std::setprecision(3) << std::setw(12) << 1e3 * s.total / s.count << std::setw(12) << 1e3 * s.max;
+        out << std::setprecision(1) << std::setw(9) << (elapsed > 0.0 ? 100.0 * s.total / elapsed : 0.0);
+        if (counting)
+        {
+            const double cycles = s.counter[PERF_CYCLES];
+            if (perf_available(PERF_INSTRUCTIONS) && cycles > 0.0)
+                out << std::setprecision(2) << std::setw(8) << s.counter[PERF_INSTRUCTIONS] / cycles;
+            else
+                out << std::setw(8) << "-";
+            for (size_t j : {PERF_LLC_MISSES, PERF_DRAM_BYTES})
+            {
+                if (perf_available(j))
+                    out << std::setprecision(3) << std::setw(14) << s.counter[j] * per_item / s.count;
+                else
+                    out << std::setw(14) << "-";
+            }
+        }
+        if (roofline)
+        {
+            /// Only regions that declare their work, so enclosing regions are not credited twice
+            if (s.bytes > 0.0 && s.total > 0.0)
+            {
+                const double bw = s.bytes / s.total;
+                out << std::setprecision(2) << std::setw(10) << 1e-9 * bw << std::setw(10) << 1e-9 * s.flops / s.total;
+                out << std::setw(8) << s.flops / s.bytes << std::setprecision(1) << std::setw(8) << 100.0 * bw / peak_bandwidth;
+            }
+            else
+                out << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(8) << "-" << std::setw(8) << "-";
+        }
+        if (allocs)
+            out << std::setprecision(1) << std::setw(12) << double(s.alloc.count) / s.count << std::setw(12) << double(s.alloc.bytes) / s.count;
+        out << '\n';
+    }
+    out.flags(flags);
+    out.precision(prec);
+}
+
+static void json_string(std::ostream &out, const std::string &s)
+{
+    out << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+/**
+ * Export recorded events in Chrome trace format, viewable in Perfetto or "chrome://tracing".
+ * May be called while other threads are running: events overwritten during the copy are dropped.
+ * The file is written under a temporary name first, so a viewer never sees a partial trace.
+ * @param path Path to the JSON output.
+ */
+void trace_dump(const std::string &path)
+{
+    if (!tracing)
+        return;
+
+    std::vector<std::pair<size_t, std::vector<TraceEvent>>> copy;
+    std::vector<std::string> names, label;
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        names = region_name;
+        for (size_t k = 0; k < thread_profile.size(); ++k)
+        {
+            const auto &ring = thread_profile[k]->trace;
+            const size_t cap = ring.buf.size();
+            if (cap == 0)
+                continue;
+
+            /// Keep only the slots not reused by the owner while they were copied.
+            /// While writing event "h1" the owner overwrites the slot of event "h1 - cap",
+            /// so that one may be torn as well.
+            const uint64_t h0 = ring.head.load(std::memory_order_acquire);
+            const uint64_t first = h0 > cap ? h0 - cap : 0;
+            std::vector<TraceEvent> e;
+            e.reserve(h0 - first);
+            for (uint64_t i = first; i < h0; ++i)
+                e.push_back(ring.buf[i % cap]);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t h1 = ring.head.load(std::memory_order_relaxed);
+            const uint64_t valid = h1 >= cap ? h1 - cap + 1 : 0;
+            if (valid > first)
+                e.erase(e.begin(), e.begin() + std::min<uint64_t>(valid - first, e.size()));
+
+            copy.emplace_back(k, std::move(e));
+            label.push_back(thread_profile[k]->name);
+        }
+    }
+
+    const std::string tmp = path + ".part";
+    {
+        std::ofstream out(tmp);
+        if (out.fail())
+            throw std::runtime_error("Failed to open \"" + tmp + "\".");
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << std::fixed << std::setprecision(3);
+        bool first = true;
+        for (size_t k = 0; k < copy.size(); ++k)
+        {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << copy[k].first << ",\"args\":{\"name\":";
+            json_string(out, label[k]);
+            out << "}}";
+            first = false;
+            for (const auto &e : copy[k].second)
+            {
+                out << ",\n{\"ph\":\"X\",\"name\":";
+                json_string(out, names[e.region]);
+                out << ",\"pid\":1,\"tid\":" << copy[k].first << ",\"ts\":" << 1e-3 * e.begin << ",\"dur\":" << 1e-3 * e.dur << ",\"args\":{\"depth\":" << e.depth << "}}";
+            }
+        }
+        out << "\n]}\n";
+        if (out.fail())
+            throw std::runtime_error("Failed to write \"" + tmp + "\".");
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Failed to replace \"" + path + "\".");
+}
@@ -0,0 +1,60 @@
+#include "../inc/reduction.h"
+
+/**
+ * Error-free transformation of "a + b" into "s + e".
+ */
+static inline void two_sum(FLM_SCALAR a, FLM_SCALAR b, FLM_SCALAR &s, FLM_SCALAR &e)
+{
+    s = a + b;
+    const FLM_SCALAR bb = s - a;
+    e = (a - (s - bb)) + (b - bb);
+}
+
+/**
+ * Storage for the chunk partials of one reduction, owned by the calling thread.
+ * It is kept between calls, so repeated reductions of the same size do not allocate.
+ * @param n Number of chunks.
+ * @return Scratch space of "n" partials, contents undefined.
+ */
+std::vector<FLM_PARTIAL> &reduction_scratch(size_t n)
+{
+    static thread_local std::vector<FLM_PARTIAL> partial;
+    partial.resize(n);
+    return partial;
+}
+
+/**
+ * Combine chunk partials by a balanced binary tree.
+ * The tree shape depends only on the number of partials.
+ * @param partial Chunk partials, overwritten during the reduction.
+ * @param mode Whether the compensation terms are carried along.
+ * @return The total.
+ */
+FLM_SCALAR combine_partials(std::vector<FLM_PARTIAL> &partial, FLM_REDUCTION mode)
+{
+    size_t n = partial.size();
+    if (n == 0)
+        return 0.0;
+
+    while (n > 1)
+    {
+        const size_t half = (n + 1) / 2;
+        for (size_t i = 0; i < n / 2; ++i)
+        {
+            auto &dst = partial[i];
+            const auto &src = partial[i + half];
+            if (mode == FLM_REDUCTION::Compensated)
+            {
+                FLM_SCALAR s, e;
+                two_sum(dst.s, src.s, s, e);
+                dst.s = s;
+                dst.c += src.c + e;
+            }
+            else
+                dst.s += src.s;
+        }
+        n = half;
+    }
+
+    return partial[0].s + partial[0].c;
+}
@@ -0,0 +1,47 @@
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include "../inc/roofline.h"
+
+/**
+ * Attainable memory bandwidth, measured once like the "triad" kernel of STREAM: "a = b + s * c".
+ * Arrays are first touched by the threads that later use them, so pages are local to those threads.
+ * Traffic is counted as 2 reads and 1 write per element, without write-allocate, as in STREAM.
+ * @param bytes Total size of the 3 arrays, well beyond the last-level cache.
+ * @return Best of several repetitions, in B/s.
+ */
+double stream_bandwidth(size_t bytes)
+{
+    static const int NTIMES = 5;
+    const size_t n = bytes / (3 * sizeof(double));
+
+    std::unique_ptr<double[]> a(new double[n]), b(new double[n]), c(new double[n]);
+    double *pa = a.get(), *pb = b.get(), *pc = c.get();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i)
+    {
+        pa[i] = 0.0;
+        pb[i] = 1.0;
+        pc[i] = 2.0;
+    }
+
+    double best = 0.0;
+    for (int k = 0; k < NTIMES; ++k)
+    {
+        const double s = 3.0 + k;
+        auto t0 = std::chrono::steady_clock::now();
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; ++i)
+            pa[i] = pb[i] + s * pc[i];
+        auto t1 = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(t1 - t0).count();
+        if (dt > 0.0)
+            best = std::max(best, 3.0 * sizeof(double) * n / dt);
+    }
+
+    /// Keep the stores observable
+    volatile double sink = pa[n / 2];
+    (void)sink;
+    return best;
+}
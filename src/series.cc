@@ -0,0 +1,274 @@
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../inc/binfile.h"
+#include "../inc/series.h"
+#include "../inc/profile.h"
+
+static const char MAGIC[8] = {'D', '3', 'D', 'S', 'E', 'R', 'I', 'E'};
+static const char INDEX_MAGIC[8] = {'D', '3', 'D', 'S', 'I', 'D', 'X', '\0'};
+
+/**
+ * Fixed-size header in front of both the records and the index.
+ */
+struct SeriesHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t mesh;
+    uint64_t padding;
+};
+static_assert(sizeof(SeriesHeader) == 32, "Unexpected padding in series header.");
+static_assert(sizeof(SeriesEntry) == 32, "Unexpected padding in series entry.");
+
+static std::string index_path(const std::string &path)
+{
+    return path + ".idx";
+}
+
+static uint64_t file_size(int fd, const std::string &path)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        throw std::runtime_error("Failed to query \"" + path + "\".");
+    return st.st_size;
+}
+
+static SeriesHeader read_header(int fd, const std::string &path, const char *magic)
+{
+    SeriesHeader hdr;
+    read_at(fd, reinterpret_cast<char *>(&hdr), sizeof(hdr), 0, path);
+    if (std::memcmp(hdr.magic, magic, 8) != 0)
+        throw invalid_file_format(path, "unrecognized identifier.");
+    if (hdr.version != FLM_SERIES_VERSION)
+        throw invalid_file_format(path, "version " + std::to_string(hdr.version) + " is not supported.");
+    return hdr;
+}
+
+bool is_series(const std::string &path)
+{
+    return has_magic(path, MAGIC);
+}
+
+/**
+ * Open a container for appending.
+ * A fresh run truncates any existing container at "path". When resuming, the index is
+ * trimmed to whole entries whose records lie within the data file, and the data file is
+ * cut after the last indexed record, discarding whatever an interrupted run left behind.
+ * @param path Path to the container; the index lives next to it.
+ * @param mesh Fingerprint of the mesh, see "mesh_hash".
+ * @param resume Keep existing records.
+ */
+SeriesWriter::SeriesWriter(const std::string &path, uint64_t mesh, bool resume) :
+    path(path),
+    ipath(index_path(path)),
+    fd_data(-1),
+    fd_index(-1),
+    n_entry(0),
+    end(sizeof(SeriesHeader))
+{
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary output is only supported on little-endian hosts.");
+
+    fd_data = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_data < 0)
+        throw failed_to_open_file(path);
+    fd_index = open(ipath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_index < 0)
+    {
+        close(fd_data);
+        throw failed_to_open_file(ipath);
+    }
+
+    try
+    {
+        const uint64_t data_len = file_size(fd_data, path);
+        const uint64_t index_len = file_size(fd_index, ipath);
+        if (resume && data_len >= sizeof(SeriesHeader) && index_len >= sizeof(SeriesHeader))
+        {
+            if (read_header(fd_data, path, MAGIC).mesh != mesh || read_header(fd_index, ipath, INDEX_MAGIC).mesh != mesh)
+                throw inconsistent_mesh();
+
+            n_entry = (index_len - sizeof(SeriesHeader)) / sizeof(SeriesEntry);
+            while (n_entry > 0)
+            {
+                SeriesEntry e;
+                read_at(fd_index, reinterpret_cast<char *>(&e), sizeof(e), sizeof(SeriesHeader) + (n_entry - 1) * sizeof(SeriesEntry), ipath);
+                if (e.offset + e.length <= data_len)
+                {
+                    end = e.offset + e.length;
+                    break;
+                }
+                --n_entry;
+            }
+        }
+        else
+        {
+            SeriesHeader hdr;
+            std::memset(&hdr, 0, sizeof(hdr));
+            hdr.version = FLM_SERIES_VERSION;
+            hdr.mesh = mesh;
+            std::memcpy(hdr.magic, MAGIC, 8);
+            write_at(fd_data, reinterpret_cast<const char *>(&hdr), sizeof(hdr), 0, path);
+            std::memcpy(hdr.magic, INDEX_MAGIC, 8);
+            write_at(fd_index, reinterpret_cast<const char *>(&hdr), sizeof(hdr), 0, ipath);
+        }
+
+        if (ftruncate(fd_data, end) != 0 || ftruncate(fd_index, sizeof(SeriesHeader) + n_entry * sizeof(SeriesEntry)) != 0)
+            throw std::runtime_error("Failed to truncate \"" + path + "\".");
+    }
+    catch (...)
+    {
+        close(fd_data);
+        close(fd_index);
+        throw;
+    }
+}
+
+SeriesWriter::~SeriesWriter()
+{
+    close(fd_data);
+    close(fd_index);
+}
+
+/**
+ * Add a snapshot at the end of the container.
+ * The record is written before its index entry, so a reader never sees an entry
+ * pointing to incomplete data.
+ * @param src The snapshot.
+ * @param codec Encoding of the arrays.
+ * @param tol Maximum absolute error, only used by lossy codecs.
+ */
+void SeriesWriter::append(const Snapshot &src, FLM_CODEC codec, FLM_SCALAR tol)
+{
+    FLM_PROFILE("SeriesWriter::append");
+    const auto &buf = encode_snapshot(src, codec, tol);
+    write_at(fd_data, buf.data(), buf.size(), end, path);
+
+    SeriesEntry e;
+    e.iter = src.iter;
+    e.t = src.t;
+    e.offset = end;
+    e.length = buf.size();
+    if (fdatasync(fd_data) != 0)
+        throw std::runtime_error("Failed to flush \"" + path + "\".");
+    write_at(fd_index, reinterpret_cast<const char *>(&e), sizeof(e), sizeof(SeriesHeader) + n_entry * sizeof(SeriesEntry), ipath);
+
+    end += buf.size();
+    ++n_entry;
+}
+
+/**
+ * Load the index of a container.
+ * Entries beyond the end of the data file are ignored.
+ * @param path Path to the container.
+ */
+SeriesReader::SeriesReader(const std::string &path) :
+    path(path),
+    fd(-1)
+{
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary input is only supported on little-endian hosts.");
+
+    const std::string ipath = index_path(path);
+    const int fd_index = open(ipath.c_str(), O_RDONLY);
+    if (fd_index < 0)
+        throw failed_to_open_file(ipath);
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        close(fd_index);
+        throw failed_to_open_file(path);
+    }
+
+    try
+    {
+        const uint64_t mesh = read_header(fd, path, MAGIC).mesh;
+        if (read_header(fd_index, ipath, INDEX_MAGIC).mesh != mesh)
+            throw invalid_file_format(ipath, "index does not belong to the container.");
+
+        const uint64_t data_len = file_size(fd, path);
+        index.resize((file_size(fd_index, ipath) - sizeof(SeriesHeader)) / sizeof(SeriesEntry));
+        read_at(fd_index, reinterpret_cast<char *>(index.data()), index.size() * sizeof(SeriesEntry), sizeof(SeriesHeader), ipath);
+        while (!index.empty() && index.back().offset + index.back().length > data_len)
+            index.pop_back();
+    }
+    catch (...)
+    {
+        close(fd_index);
+        close(fd);
+        throw;
+    }
+    close(fd_index);
+}
+
+SeriesReader::~SeriesReader()
+{
+    close(fd);
+}
+
+/**
+ * Locate the record of an iteration.
+ * Entries are in increasing order of iteration, as appended by the solver.
+ * @return Position of the record, or "size()" if absent.
+ */
+size_t SeriesReader::find(size_t iter) const
+{
+    auto it = std::lower_bound(index.begin(), index.end(), iter, [](const SeriesEntry &e, size_t val) {
+        return e.iter < val;
+    });
+    if (it == index.end() || it->iter != iter)
+        return index.size();
+    return it - index.begin();
+}
+
+/**
+ * Load one record.
+ * @param k Position of the record.
+ * @param dst The snapshot.
+ */
+void SeriesReader::read(size_t k, Snapshot &dst) const
+{
+    FLM_PROFILE("SeriesReader::read");
+    const SeriesEntry &e = index.at(k);
+    static thread_local std::vector<char> buf;
+    buf.resize(e.length);
+    read_at(fd, buf.data(), e.length, e.offset, path);
+    decode_snapshot(buf.data(), buf.size(), path + "@" + std::to_string(e.iter), dst);
+}
+
+/**
+ * Find the last record of a container by reading only the tail of its index.
+ * @param path Path to the container.
+ * @param dst Location of the record.
+ * @return "false" if the container does not exist or holds no record.
+ */
+bool series_latest(const std::string &path, SeriesEntry &dst)
+{
+    const std::string ipath = index_path(path);
+    const int fd_index = open(ipath.c_str(), O_RDONLY);
+    if (fd_index < 0)
+        return false;
+
+    bool found = false;
+    try
+    {
+        read_header(fd_index, ipath, INDEX_MAGIC);
+        const uint64_t n = (file_size(fd_index, ipath) - sizeof(SeriesHeader)) / sizeof(SeriesEntry);
+        if (n > 0)
+        {
+            read_at(fd_index, reinterpret_cast<char *>(&dst), sizeof(dst), sizeof(SeriesHeader) + (n - 1) * sizeof(SeriesEntry), ipath);
+            found = true;
+        }
+    }
+    catch (...)
+    {
+        close(fd_index);
+        throw;
+    }
+    close(fd_index);
+    return found;
+}
@@ -0,0 +1,283 @@
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../inc/element.h"
+#include "../inc/binfile.h"
+#include "../inc/misc.h"
+#include "../inc/fpcodec.h"
+#include "../inc/snapshot.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const char MAGIC[8] = {'D', '3', 'D', 'S', 'N', 'A', 'P', '\0'};
+
+/**
+ * Fixed-size header in front of the arrays.
+ * "checksum" covers the payload only.
+ * With a codec other than "Raw", the payload starts with the tolerance and the encoded
+ * length of each array, see "CodecPrefix".
+ */
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t codec;
+    uint64_t iter;
+    double t;
+    uint64_t n_node, n_face, n_cell;
+    uint64_t mesh;
+    uint64_t payload;
+    uint64_t checksum;
+};
+static_assert(sizeof(SnapshotHeader) == 80, "Unexpected padding in snapshot header.");
+
+struct CodecPrefix
+{
+    double tol;
+    uint64_t len[3];
+};
+static_assert(sizeof(CodecPrefix) == 32, "Unexpected padding in codec prefix.");
+
+/**
+ * Copy variables from mesh entities.
+ * Storage of "dst" is reused across calls.
+ */
+void gather_snapshot(Snapshot &dst, size_t iter, FLM_SCALAR t)
+{
+    FLM_PROFILE("gather_snapshot");
+    dst.iter = iter;
+    dst.t = t;
+
+    dst.node_T.resize(node.size());
+    dst.face_T.resize(face.size());
+    dst.cell_T.resize(cell.size());
+
+#pragma omp parallel
+    {
+        FLM_PROFILE("gather_snapshot.copy");
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < node.size(); ++i)
+            dst.node_T[i] = node[i]->T;
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < face.size(); ++i)
+            dst.face_T[i] = face[i]->T;
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < cell.size(); ++i)
+            dst.cell_T[i] = cell[i]->T;
+    }
+}
+
+/**
+ * Copy variables back to mesh entities.
+ */
+void scatter_snapshot(const Snapshot &src)
+{
+    FLM_PROFILE("scatter_snapshot");
+    if (src.node_T.size() != node.size() || src.face_T.size() != face.size() || src.cell_T.size() != cell.size())
+        throw inconsistent_mesh();
+
+#pragma omp parallel
+    {
+        FLM_PROFILE("scatter_snapshot.copy");
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < node.size(); ++i)
+            node[i]->T = src.node_T[i];
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < face.size(); ++i)
+            face[i]->T = src.face_T[i];
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < cell.size(); ++i)
+            cell[i]->T = src.cell_T[i];
+    }
+}
+
+bool is_binary_snapshot(const std::string &path)
+{
+    return has_magic(path, MAGIC);
+}
+
+/**
+ * Assemble header and arrays of a snapshot in memory.
+ * @param src The snapshot.
+ * @param codec Encoding of the arrays.
+ * @param tol Maximum absolute error, only used by lossy codecs.
+ * @return Thread-local buffer, valid until the next call on the same thread.
+ */
+const std::vector<char> &encode_snapshot(const Snapshot &src, FLM_CODEC codec, FLM_SCALAR tol)
+{
+    FLM_PROFILE("encode_snapshot");
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary output is only supported on little-endian hosts.");
+    if (codec == FLM_CODEC::Quantized && !(tol > 0.0))
+        throw std::invalid_argument("Tolerance of lossy compression must be positive.");
+
+    const auto arrays = {&src.node_T, &src.face_T, &src.cell_T};
+
+    static thread_local std::vector<char> buf;
+    if (codec == FLM_CODEC::Raw)
+    {
+        const size_t n_val = src.node_T.size() + src.face_T.size() + src.cell_T.size();
+        buf.resize(sizeof(SnapshotHeader) + n_val * sizeof(FLM_SCALAR));
+
+        char *p = buf.data() + sizeof(SnapshotHeader);
+        for (const auto *e : arrays)
+        {
+            std::memcpy(p, e->data(), e->size() * sizeof(FLM_SCALAR));
+            p += e->size() * sizeof(FLM_SCALAR);
+        }
+    }
+    else
+    {
+        buf.resize(sizeof(SnapshotHeader) + sizeof(CodecPrefix));
+
+        CodecPrefix pre;
+        pre.tol = codec == FLM_CODEC::Quantized ? tol : 0.0;
+        int k = 0;
+        for (const auto *e : arrays)
+        {
+            if (codec == FLM_CODEC::Xor)
+                pre.len[k++] = encode_xor(e->data(), e->size(), buf);
+            else
+                pre.len[k++] = encode_quantized(e->data(), e->size(), tol, buf);
+        }
+        std::memcpy(buf.data() + sizeof(SnapshotHeader), &pre, sizeof(CodecPrefix));
+    }
+    const size_t payload = buf.size() - sizeof(SnapshotHeader);
+
+    SnapshotHeader hdr;
+    std::memcpy(hdr.magic, MAGIC, 8);
+    hdr.version = FLM_SNAPSHOT_VERSION;
+    hdr.codec = static_cast<uint32_t>(codec);
+    hdr.iter = src.iter;
+    hdr.t = src.t;
+    hdr.n_node = src.node_T.size();
+    hdr.n_face = src.face_T.size();
+    hdr.n_cell = src.cell_T.size();
+    hdr.mesh = src.mesh;
+    hdr.payload = payload;
+    hdr.checksum = hash64(buf.data() + sizeof(SnapshotHeader), payload);
+    std::memcpy(buf.data(), &hdr, sizeof(SnapshotHeader));
+
+    return buf;
+}
+
+/**
+ * Dump a snapshot in binary format.
+ * The encoded snapshot is written by one call into a temporary file,
+ * which then replaces "path", so an interrupted write never leaves a truncated snapshot.
+ * @param path Path to the output file.
+ * @param src The snapshot.
+ * @param codec Encoding of the arrays.
+ * @param tol Maximum absolute error, only used by lossy codecs.
+ */
+void write_snapshot(const std::string &path, const Snapshot &src, FLM_CODEC codec, FLM_SCALAR tol)
+{
+    FLM_PROFILE("write_snapshot");
+    const auto &buf = encode_snapshot(src, codec, tol);
+
+    const std::string tmp = path + ".part";
+    const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw failed_to_open_file(tmp);
+    try
+    {
+        write_at(fd, buf.data(), buf.size(), 0, tmp);
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Failed to replace \"" + path + "\".");
+}
+
+/**
+ * Parse an encoded snapshot.
+ * Counts are checked against the loaded mesh by the caller through "scatter_snapshot".
+ * @param data Start of the header.
+ * @param len Number of bytes available, expected to cover exactly one snapshot.
+ * @param path Origin of the data, for error messages.
+ * @param dst The snapshot.
+ */
+void decode_snapshot(const char *data, size_t len, const std::string &path, Snapshot &dst)
+{
+    FLM_PROFILE("decode_snapshot");
+    if (!host_is_little_endian())
+        throw std::runtime_error("Binary input is only supported on little-endian hosts.");
+
+    if (len < sizeof(SnapshotHeader))
+        throw invalid_file_format(path, "truncated header.");
+
+    SnapshotHeader hdr;
+    std::memcpy(&hdr, data, sizeof(SnapshotHeader));
+    if (std::memcmp(hdr.magic, MAGIC, 8) != 0)
+        throw invalid_file_format(path, "unrecognized identifier.");
+    if (hdr.version != FLM_SNAPSHOT_VERSION)
+        throw invalid_file_format(path, "version " + std::to_string(hdr.version) + " is not supported.");
+    const FLM_CODEC codec = static_cast<FLM_CODEC>(hdr.codec);
+    if (codec != FLM_CODEC::Raw && codec != FLM_CODEC::Xor && codec != FLM_CODEC::Quantized)
+        throw invalid_file_format(path, "unknown encoding " + std::to_string(hdr.codec) + ".");
+
+    const char *payload = data + sizeof(SnapshotHeader);
+    if (hdr.payload != len - sizeof(SnapshotHeader))
+        throw invalid_file_format(path, "unexpected payload size.");
+    if (hash64(payload, hdr.payload) != hdr.checksum)
+        throw invalid_file_format(path, "checksum mismatch.");
+
+    dst.iter = hdr.iter;
+    dst.t = hdr.t;
+    dst.mesh = hdr.mesh;
+    const std::pair<std::vector<FLM_SCALAR> *, uint64_t> arrays[3] = {{&dst.node_T, hdr.n_node}, {&dst.face_T, hdr.n_face}, {&dst.cell_T, hdr.n_cell}};
+    if (codec == FLM_CODEC::Raw)
+    {
+        if (hdr.payload != (hdr.n_node + hdr.n_face + hdr.n_cell) * sizeof(FLM_SCALAR))
+            throw invalid_file_format(path, "unexpected payload size.");
+
+        for (auto e : arrays)
+        {
+            e.first->resize(e.second);
+            std::memcpy(e.first->data(), payload, e.second * sizeof(FLM_SCALAR));
+            payload += e.second * sizeof(FLM_SCALAR);
+        }
+    }
+    else
+    {
+        CodecPrefix pre;
+        if (hdr.payload < sizeof(CodecPrefix))
+            throw invalid_file_format(path, "truncated payload.");
+        std::memcpy(&pre, payload, sizeof(CodecPrefix));
+        payload += sizeof(CodecPrefix);
+        if (pre.len[0] + pre.len[1] + pre.len[2] != hdr.payload - sizeof(CodecPrefix))
+            throw invalid_file_format(path, "unexpected payload size.");
+
+        for (int k = 0; k < 3; ++k)
+        {
+            auto e = arrays[k];
+            e.first->resize(e.second);
+            const bool ok = codec == FLM_CODEC::Xor ? decode_xor(payload, pre.len[k], e.first->data(), e.second)
+                                                    : decode_quantized(payload, pre.len[k], pre.tol, e.first->data(), e.second);
+            if (!ok)
+                throw invalid_file_format(path, "corrupted array.");
+            payload += pre.len[k];
+        }
+    }
+}
+
+/**
+ * Load a snapshot in binary format.
+ * @param path Path to the input file.
+ * @param dst The snapshot.
+ */
+void read_snapshot(const std::string &path, Snapshot &dst)
+{
+    MappedFile src(path);
+    decode_snapshot(src.data(), src.size(), path, dst);
+}
@@ -1,27 +1,245 @@
+#include <algorithm>
 #include "../inc/element.h"
 #include "../inc/spatial.h"
+#include "../inc/roofline.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
 extern std::vector<Face *> face;
 extern std::vector<Cell *> cell;
 
+typedef Eigen::Matrix<FLM_SCALAR, 4, 4> Mat44;
+typedef Eigen::Matrix<FLM_SCALAR, 4, 1> Vec4;
+
+/**
+ * Boundary nodes fit a linear field to the values of adjacent cells and to the B.C. of adjacent boundary faces:
+ * prescribed values on Dirichlet faces, surface normal gradients on Neumann faces.
+ * Value rows are weighted by inverse squared distance, so the fit stays local.
+ * Unlike the one-sided average over cells, this is exact for linear fields.
+ * Nodes whose system is singular keep the cell-weighted value.
+ * @return Number of rows in total.
+ */
+static size_t boundary_nodal_value()
+{
+    const size_t NumOfNode = node.size();
+    size_t nRow = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nRow)
+    for (size_t i = 0; i < NumOfNode; ++i)
+    {
+        auto n = node[i];
+        if (!n->at_boundary)
+            continue;
+
+        Mat44 A = Mat44::Zero();
+        Vec4 b = Vec4::Zero();
+        auto add_row = [&A, &b, &nRow](const Vec4 &r, FLM_SCALAR w, FLM_SCALAR val) {
+            A.noalias() += w * r * r.transpose();
+            b += w * val * r;
+            ++nRow;
+        };
+        for (auto c : n->cell_dependency)
+        {
+            const FLM_VECTOR d = c->centroid - n->coordinate;
+            add_row(Vec4(1.0, d.x(), d.y(), d.z()), 1.0 / d.squaredNorm(), c->T);
+
+            /// Each boundary face belongs to exactly one cell
+            for (auto f : c->surface)
+            {
+                if (!f->at_boundary() || std::find(f->vertex.begin(), f->vertex.end(), n) == f->vertex.end())
+                    continue;
+
+                if (f->parent->T == FLM_BC_MATH::Dirichlet)
+                {
+                    const FLM_VECTOR d = f->centroid - n->coordinate;
+                    add_row(Vec4(1.0, d.x(), d.y(), d.z()), 1.0 / d.squaredNorm(), f->T);
+                }
+                else if (f->parent->T == FLM_BC_MATH::Neumann)
+                {
+                    const FLM_VECTOR &nf = f->c0 ? f->n01 : f->n10;
+                    add_row(Vec4(0.0, nf.x(), nf.y(), nf.z()), 1.0, static_cast<BoundaryFace *>(f)->sn_grad_T);
+                }
+            }
+        }
+
+        const Eigen::FullPivLU<Mat44> lu(A);
+        if (lu.isInvertible())
+            n->T = lu.solve(b)[0];
+    }
+
+    return nRow;
+}
+
 /**
  * Interpolation from cell to node.
+ * Interior nodes use the linear preserving weights of dependent cells,
+ * boundary nodes take their B.C. into account, see "boundary_nodal_value".
+ * Before call to this function:
+ *   Dirichlet values and Neumann surface normal gradients should be updated.
  */
 void interpolate_nodal_value()
 {
-    for (auto n : node)
+    FLM_PROFILE("interpolate_nodal_value");
+    const size_t NumOfNode = node.size();
+    size_t nDep = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nDep)
+    for (size_t i = 0; i < NumOfNode; ++i)
     {
+        auto n = node[i];
         n->T = 0.0;
 
         const size_t N = n->cell_dependency.size();
+        nDep += N;
         for (size_t j = 0; j < N; ++j)
         {
-            const auto cwf = n->cell_weighting1.at(j);
-            auto cdc = n->cell_dependency.at(j);
+            const auto cwf = n->cell_weighting4[j];
+            auto cdc = n->cell_dependency[j];
 
             n->T += cwf * cdc->T;
         }
     }
+
+    const size_t nRow = boundary_nodal_value();
+
+    /// Per node: entity, 2 lists and the result; per dependency: weight, cell and its value;
+    /// per row of boundary nodes: an entity, its location and value, and a rank-1 update of the normal equations
+    profile_work(NumOfNode * (sizeof(Node *) + 2 * FLM_LIST_BYTES + sizeof(FLM_SCALAR)) + nDep * (sizeof(FLM_SCALAR) + sizeof(Cell *) + sizeof(FLM_SCALAR)) +
+                     nRow * (sizeof(Cell *) + sizeof(FLM_VECTOR) + sizeof(FLM_SCALAR)),
+                 2.0 * nDep + 130.0 * nRow);
+}
+
+/**
+ * Interpolation from cell to face.
+ * Internal faces are weighted by inverse distance to adjacent centroids,
+ * Neumann boundary faces are extrapolated along the surface normal gradient.
+ * Dirichlet boundary faces keep their prescribed values.
+ */
+void interpolate_face_value()
+{
+    FLM_PROFILE("interpolate_face_value");
+    const size_t NumOfFace = face.size();
+    size_t nBoundary = 0, nNeumann = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nBoundary, nNeumann)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        auto f = face[i];
+        if (f->at_boundary())
+        {
+            ++nBoundary;
+            if (f->parent->T != FLM_BC_MATH::Neumann)
+                continue;
+            ++nNeumann;
+
+            const FLM_SCALAR sn_grad = static_cast<BoundaryFace *>(f)->sn_grad_T;
+            if (f->c0)
+                f->T = f->c0->T + sn_grad * f->r0.dot(f->n01);
+            else
+                f->T = f->c1->T + sn_grad * f->r1.dot(f->n10);
+        }
+        else
+            f->T = f->cell_weighting1[0] * f->c0->T + f->cell_weighting1[1] * f->c1->T;
+    }
+
+    /// Per face: entity and type; internal: 2 weights, 2 cells and their values, the result;
+    /// boundary: B.C. type; Neumann: gradient, cell and its value, displacement, normal, the result
+    const size_t nInternal = NumOfFace - nBoundary;
+    const double bytes = NumOfFace * (sizeof(Face *) + FLM_VPTR_BYTES) +
+                         nInternal * (2 * sizeof(FLM_SCALAR) + 2 * sizeof(Cell *) + 2 * sizeof(FLM_SCALAR) + sizeof(FLM_SCALAR)) +
+                         nBoundary * (sizeof(Patch *) + sizeof(FLM_BC_MATH)) +
+                         nNeumann * (sizeof(FLM_SCALAR) + sizeof(Cell *) + sizeof(FLM_SCALAR) + 2 * sizeof(FLM_VECTOR) + sizeof(FLM_SCALAR));
+    profile_work(bytes, 3.0 * nInternal + 7.0 * nNeumann);
+}
+
+/**
+ * Net diffusive flux into each cell per unit volume, with unit conductivity.
+ * Each face flux is split as "S = S_E + S_T":
+ * the orthogonal part uses the difference across the face,
+ * the non-orthogonal part uses the interpolated gradient.
+ * Evaluated cell by cell, so no write is shared between threads.
+ * Before call to this function, cell gradients should be updated.
+ * @param dst Residual of each cell, in order of cell index.
+ */
+void calculate_residual(std::vector<FLM_SCALAR> &dst)
+{
+    FLM_PROFILE("calculate_residual");
+    const size_t NumOfCell = cell.size();
+    dst.resize(NumOfCell);
+    size_t nInternal = 0, nDirichlet = 0, nNeumann = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nInternal, nDirichlet, nNeumann)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c = cell[i];
+        const size_t nF = c->surface.size();
+
+        FLM_SCALAR flux = 0.0;
+        for (size_t j = 0; j < nF; ++j)
+        {
+            auto curFace = c->surface[j];
+            const FLM_SCALAR E = c->S_E[j].norm() / c->d[j].norm();
+            if (curFace->at_boundary())
+            {
+                if (curFace->parent->T == FLM_BC_MATH::Neumann)
+                {
+                    ++nNeumann;
+                    flux += static_cast<BoundaryFace *>(curFace)->sn_grad_T * curFace->area;
+                }
+                else
+                {
+                    ++nDirichlet;
+                    flux += E * (curFace->T - c->T) + c->grad_T.dot(c->S_T[j]);
+                }
+            }
+            else
+            {
+                ++nInternal;
+                const auto &w = curFace->cell_weighting1;
+                const FLM_VECTOR grad_f = w[0] * curFace->c0->grad_T + w[1] * curFace->c1->grad_T;
+                flux += E * (c->cell_adjacency[j]->T - c->T) + grad_f.dot(c->S_T[j]);
+            }
+        }
+        dst[i] = flux / c->volume;
+    }
+
+    /// Per cell: entity, 5 lists, volume, value and the result;
+    /// per face: face and type, "S_E" and "d";
+    /// internal: 2 weights, 2 cells and their gradients, "S_T", neighbour and its value;
+    /// Dirichlet: patch and B.C. type, face value, cell gradient and "S_T";
+    /// Neumann: patch and B.C. type, gradient and area
+    const size_t nVisit = nInternal + nDirichlet + nNeumann;
+    const double bytes = NumOfCell * (sizeof(Cell *) + 5 * FLM_LIST_BYTES + 3 * sizeof(FLM_SCALAR)) +
+                         nVisit * (sizeof(Face *) + FLM_VPTR_BYTES + 2 * sizeof(FLM_VECTOR)) +
+                         nInternal * (2 * sizeof(FLM_SCALAR) + 2 * sizeof(Cell *) + 3 * sizeof(FLM_VECTOR) + sizeof(Cell *) + sizeof(FLM_SCALAR)) +
+                         nDirichlet * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + sizeof(FLM_SCALAR) + 2 * sizeof(FLM_VECTOR)) +
+                         nNeumann * (sizeof(Patch *) + sizeof(FLM_BC_MATH) + 2 * sizeof(FLM_SCALAR));
+    profile_work(bytes, NumOfCell + 13.0 * nVisit + 18.0 * nInternal + 9.0 * nDirichlet + 2.0 * nNeumann);
+}
+
+/**
+ * Diffusive flux through a boundary face with unit conductivity, positive outwards.
+ * Discretized as in "calculate_residual", so the fluxes of all boundary faces balance
+ * the change of cell values.
+ * Before call to this function: same as for "calculate_residual".
+ * @param f The boundary face.
+ * @return Flux through the whole face.
+ */
+FLM_SCALAR boundary_flux(const BoundaryFace *f)
+{
+    if (f->parent->T == FLM_BC_MATH::Neumann)
+        return -f->sn_grad_T * f->area;
+
+    const Cell *c = f->c0 ? f->c0 : f->c1;
+    const size_t nF = c->surface.size();
+    for (size_t j = 0; j < nF; ++j)
+    {
+        if (c->surface[j] == f)
+        {
+            const FLM_SCALAR E = c->S_E[j].norm() / c->d[j].norm();
+            return -(E * (f->T - c->T) + c->grad_T.dot(c->S_T[j]));
+        }
+    }
+    return 0.0;
 }
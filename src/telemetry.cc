@@ -0,0 +1,251 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <csignal>
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../inc/element.h"
+#include "../inc/telemetry.h"
+#include "../inc/temporal.h"
+#include "../inc/diagnose.h"
+#include "../inc/reduction.h"
+#include "../inc/misc.h"
+#include "../inc/alloctrack.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static bool is_fifo(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/**
+ * @param output Path to a regular file, created if missing, or to an existing named pipe.
+ * @param resume Append to an existing file instead of starting over.
+ * @param depth Number of record slots, at least 1.
+ */
+Telemetry::Telemetry(const std::string &output, bool resume, size_t depth) :
+    path(output),
+    append(resume),
+    fd(-1),
+    slot(std::max<size_t>(depth, 1)),
+    head(0),
+    count(0),
+    dropped(0),
+    stop(false),
+    failed(false),
+    warned(false)
+{
+    /// A reader going away must not kill the run, writes fail with EPIPE instead
+    std::signal(SIGPIPE, SIG_IGN);
+
+    /// Regular files are opened here, so that a bad path is reported right away
+    if (!is_fifo(path) && !open_output())
+        throw failed_to_open_file(path);
+
+    worker = std::thread(&Telemetry::run, this);
+}
+
+/**
+ * Write the pending records and join the background thread.
+ * Records still pending on a pipe that never got a reader are lost.
+ */
+Telemetry::~Telemetry()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    worker.join();
+    if (fd >= 0)
+        close(fd);
+}
+
+/**
+ * Open the output without blocking.
+ * @return "false" if a named pipe has no reader yet, or the file cannot be opened.
+ */
+bool Telemetry::open_output()
+{
+    if (is_fifo(path))
+    {
+        fd = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd < 0)
+            return false;
+
+        /// Only the background thread waits on a slow reader
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    }
+    else
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+    return fd >= 0;
+}
+
+/**
+ * Queue one record of the current state, to be called after each step to be reported.
+ * Residual norms are evaluated here, extrema are those of the latest "diagnose".
+ * @param iter Iteration.
+ * @param t Physical time.
+ * @param dt Time step.
+ * @param wall Wall time of each stage of the step.
+ */
+void Telemetry::record(size_t iter, FLM_SCALAR t, FLM_SCALAR dt, const FLM_STAGE_TIME &wall)
+{
+    FLM_PROFILE("Telemetry::record");
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (failed)
+        {
+            if (!warned)
+            {
+                warned = true;
+                const std::string why = failure;
+                lck.unlock();
+                std::cout << "\nWarning: telemetry stopped: " << why << '\n';
+            }
+            return;
+        }
+    }
+
+    const auto &R = last_residual();
+    const auto &diag = last_diagnosis();
+    const size_t NumOfCell = std::min(R.size(), cell.size());
+
+    FLM_SCALAR res_l2 = 0.0, res_max = 0.0;
+    if (NumOfCell > 0)
+    {
+#pragma omp parallel for schedule(static) reduction(max:res_max)
+        for (size_t i = 0; i < NumOfCell; ++i)
+            res_max = std::max(res_max, std::abs(R[i]));
+
+        const FLM_SCALAR R2 = reduce_sum(NumOfCell, [&R](size_t i) { return cell[i]->volume * R[i] * R[i]; });
+        res_l2 = std::sqrt(R2 / diag.volume);
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (count == slot.size())
+        {
+            ++dropped;
+            return;
+        }
+        slot[(head + count) % slot.size()] = {iter, t, dt, res_l2, res_max, diag.T_min, diag.T_max, wall, dropped};
+        dropped = 0;
+        ++count;
+    }
+    cv.notify_one();
+}
+
+/**
+ * Append a number in JSON, shortest form that reads back exactly.
+ * Non-finite values have no representation in JSON.
+ */
+static void json_number(std::string &dst, double v)
+{
+    char buf[32];
+    if (std::isfinite(v))
+        dst.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    else
+        dst += "null";
+}
+
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        const ssize_t k = write(fd, p, n);
+        if (k < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+void Telemetry::run()
+{
+    profile_thread_name("telemetry");
+    alloc_exclude_thread();
+
+    std::vector<Record> batch;
+    std::string text;
+    bool done = false;
+    while (!done)
+    {
+        /// A pipe is polled until a reader shows up, records wait in their slots meanwhile
+        if (fd < 0)
+            open_output();
+
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lck(mtx);
+            if (fd < 0)
+                cv.wait_for(lck, std::chrono::milliseconds(100), [this] { return stop; });
+            else
+                cv.wait(lck, [this] { return count > 0 || stop; });
+            if (fd >= 0)
+            {
+                for (; count > 0; --count)
+                {
+                    batch.push_back(slot[head]);
+                    head = (head + 1) % slot.size();
+                }
+            }
+            done = stop;
+        }
+        if (batch.empty())
+            continue;
+
+        /// Sampled once per batch, as all of its records leave together
+        const size_t rss = resident_memory();
+        text.clear();
+        for (const auto &e : batch)
+        {
+            text += "{\"iter\":" + std::to_string(e.iter);
+            text += ",\"t\":";
+            json_number(text, e.t);
+            text += ",\"dt\":";
+            json_number(text, e.dt);
+            text += ",\"res_l2\":";
+            json_number(text, e.res_l2);
+            text += ",\"res_max\":";
+            json_number(text, e.res_max);
+            text += ",\"T_min\":";
+            json_number(text, e.T_min);
+            text += ",\"T_max\":";
+            json_number(text, e.T_max);
+            text += ",\"wall\":{\"step\":";
+            json_number(text, e.wall.step);
+            text += ",\"check\":";
+            json_number(text, e.wall.check);
+            text += ",\"output\":";
+            json_number(text, e.wall.output);
+            text += "},\"rss\":" + std::to_string(rss);
+            text += ",\"dropped\":" + std::to_string(e.dropped) + "}\n";
+        }
+
+        if (!write_all(fd, text.data(), text.size()))
+        {
+            const int err = errno;
+            std::lock_guard<std::mutex> lck(mtx);
+            failed = true;
+            failure = "failed to write \"" + path + "\" (" + std::strerror(err) + ")";
+            count = 0;
+            done = true;
+        }
+    }
+}
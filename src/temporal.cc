@@ -1,17 +1,86 @@
 #include "../inc/element.h"
 #include "../inc/temporal.h"
+#include "../inc/gradient.h"
+#include "../inc/spatial.h"
+#include "../inc/profile.h"
 
 extern std::vector<Patch *> patch;
 extern std::vector<Node *> node;
 extern std::vector<Face *> face;
 extern std::vector<Cell *> cell;
 
+/// Residual and starting value of each cell, kept across steps to avoid reallocation
+static std::vector<FLM_SCALAR> R, T0;
+
+/**
+ * Time derivative of cell values from the current field.
+ */
+static void evaluate()
+{
+    calculate_cell_gradient();
+    calculate_residual(R);
+}
+
+/**
+ * Bring face and nodal values in line with updated cell values.
+ */
+static void update_auxiliary()
+{
+    interpolate_face_value();
+    interpolate_nodal_value();
+}
+
+/**
+ * Strong-stability-preserving 3rd-order Runge-Kutta.
+ * Each stage is a convex combination of the starting value and a forward Euler step.
+ * @param TimeStep Time step.
+ */
 void RK3(FLM_SCALAR TimeStep)
 {
+    FLM_PROFILE("RK3");
+    static const FLM_SCALAR alpha[3] = {0.0, 0.75, 1.0 / 3.0};
+
+    const size_t NumOfCell = cell.size();
+    T0.resize(NumOfCell);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        T0[i] = cell[i]->T;
 
+    for (int k = 0; k < 3; ++k)
+    {
+        evaluate();
+        const FLM_SCALAR a = alpha[k];
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < NumOfCell; ++i)
+        {
+            auto c = cell[i];
+            c->T = a * T0[i] + (1.0 - a) * (c->T + TimeStep * R[i]);
+        }
+        update_auxiliary();
+    }
 }
 
+/**
+ * 1st-order explicit Euler.
+ * @param TimeStep Time step.
+ */
 void ForwardEuler(FLM_SCALAR TimeStep)
 {
+    FLM_PROFILE("ForwardEuler");
+    const size_t NumOfCell = cell.size();
 
+    evaluate();
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        cell[i]->T += TimeStep * R[i];
+    update_auxiliary();
+}
+
+/**
+ * Time derivative of cell values from the latest evaluation, in order of cell index.
+ * Empty before the first step.
+ */
+const std::vector<FLM_SCALAR> &last_residual()
+{
+    return R;
 }
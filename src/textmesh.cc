@@ -0,0 +1,535 @@
+#include <charconv>
+#include <exception>
+#include "../inc/element.h"
+#include "../inc/mapped.h"
+#include "../inc/io.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+/// Thrown when a record does not fit exactly within its line.
+struct record_layout_mismatch
+{
+};
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * Whitespace-separated tokens within [pos, end).
+ * Numbers are converted with "std::from_chars", which is locale-independent.
+ */
+class TokenStream
+{
+public:
+    TokenStream(const char *begin, const char *end, const std::string &fn) :
+        pos(begin),
+        end(end),
+        fn(fn)
+    {}
+
+    size_t get_size()
+    {
+        size_t ret;
+        convert(ret);
+        return ret;
+    }
+
+    int get_int()
+    {
+        int ret;
+        convert(ret);
+        return ret;
+    }
+
+    FLM_SCALAR get_scalar()
+    {
+        FLM_SCALAR ret;
+        convert(ret);
+        return ret;
+    }
+
+    std::string get_string()
+    {
+        const char *b, *e;
+        next(b, e);
+        return std::string(b, e);
+    }
+
+    /// true if only whitespace remains.
+    bool exhausted()
+    {
+        while (pos < end && is_space(*pos))
+            ++pos;
+        return pos == end;
+    }
+
+    const char *position() const { return pos; }
+
+private:
+    void next(const char *&b, const char *&e)
+    {
+        while (pos < end && is_space(*pos))
+            ++pos;
+        if (pos == end)
+            throw record_layout_mismatch();
+
+        b = pos;
+        while (pos < end && !is_space(*pos))
+            ++pos;
+        e = pos;
+    }
+
+    template<typename T>
+    void convert(T &val)
+    {
+        const char *b, *e;
+        next(b, e);
+        if (*b == '+' && e - b > 1)
+            ++b;
+
+        const auto res = std::from_chars(b, e, val);
+        if (res.ec != std::errc() || res.ptr != e)
+            throw invalid_file_format(fn, "invalid number \"" + std::string(b, e) + "\".");
+    }
+
+    const char *pos;
+    const char *end;
+    const std::string &fn;
+};
+
+/**
+ * The record parsers below mirror "read_mesh" entry by entry.
+ */
+static void parse_node(TokenStream &fin, size_t i)
+{
+    auto n_dst = node[i - 1];
+
+    /// 1-based global index
+    n_dst->index = i;
+
+    /// Boundary flag
+    const int flag = fin.get_int();
+    if (flag == 1)
+        n_dst->at_boundary = true;
+    else if (flag == 0)
+        n_dst->at_boundary = false;
+    else
+        throw invalid_boundary_flag("node", i, flag);
+
+    /// 3D location
+    n_dst->coordinate.x() = fin.get_scalar();
+    n_dst->coordinate.y() = fin.get_scalar();
+    n_dst->coordinate.z() = fin.get_scalar();
+
+    /// Adjacent nodes
+    const size_t n_adj_node = fin.get_size();
+    for (size_t j = 0; j < n_adj_node; ++j)
+        fin.get_size();
+
+    /// Dependent faces
+    const size_t n_dep_face = fin.get_size();
+    for (size_t j = 0; j < n_dep_face; ++j)
+        fin.get_size();
+
+    /// Dependent cells
+    const size_t n_dep_cell = fin.get_size();
+    n_dst->cell_dependency.resize(n_dep_cell);
+    n_dst->cell_weighting1.resize(n_dep_cell);
+    n_dst->cell_weighting2.resize(n_dep_cell);
+    n_dst->cell_weighting3.resize(n_dep_cell);
+    n_dst->cell_weighting4.resize(n_dep_cell);
+    for (size_t j = 0; j < n_dep_cell; ++j)
+        n_dst->cell_dependency.at(j) = cell.at(fin.get_size() - 1);
+}
+
+static void parse_face(TokenStream &fin, size_t i)
+{
+    /// Boundary flag
+    const int flag = fin.get_int();
+    if (flag == 1)
+        face[i - 1] = new BoundaryFace();
+    else if (flag == 0)
+        face[i - 1] = new InternalFace();
+    else
+        throw invalid_boundary_flag("face", i, flag);
+
+    auto f_dst = face[i - 1];
+
+    /// Connection to high-level group.
+    f_dst->parent = nullptr;
+
+    /// 1-based global index
+    f_dst->index = i;
+
+    /// Shape
+    const int shape = fin.get_int();
+    if (shape != 3 && shape != 4)
+        throw unsupported_shape("face", i, shape);
+
+    /// Centroid
+    f_dst->centroid.x() = fin.get_scalar();
+    f_dst->centroid.y() = fin.get_scalar();
+    f_dst->centroid.z() = fin.get_scalar();
+
+    /// Area
+    f_dst->area = fin.get_scalar();
+
+    /// Included nodes
+    f_dst->vertex.resize(shape);
+    for (int j = 0; j < shape; ++j)
+        f_dst->vertex.at(j) = node.at(fin.get_size() - 1);
+
+    /// Adjacent cells
+    const size_t c0 = fin.get_size();
+    const size_t c1 = fin.get_size();
+    f_dst->c0 = (c0 == 0) ? nullptr : cell.at(c0 - 1);
+    f_dst->c1 = (c1 == 0) ? nullptr : cell.at(c1 - 1);
+
+    /// Unit normal vector
+    f_dst->n01.x() = fin.get_scalar();
+    f_dst->n01.y() = fin.get_scalar();
+    f_dst->n01.z() = fin.get_scalar();
+    f_dst->n10.x() = fin.get_scalar();
+    f_dst->n10.y() = fin.get_scalar();
+    f_dst->n10.z() = fin.get_scalar();
+}
+
+static void parse_cell(TokenStream &fin, size_t i)
+{
+    auto c_dst = cell[i - 1];
+
+    /// 1-based global index
+    c_dst->index = i;
+
+    /// Shape
+    const int shape = fin.get_int();
+    int N1, N2;
+    if (shape == 2) /// tet
+    {
+        N1 = 4;
+        N2 = 4;
+    }
+    else if (shape == 4) /// hex
+    {
+        N1 = 8;
+        N2 = 6;
+    }
+    else if (shape == 5) /// pyr
+    {
+        N1 = 5;
+        N2 = 5;
+    }
+    else if (shape == 6) /// wedge
+    {
+        N1 = 6;
+        N2 = 5;
+    }
+    else
+        throw unsupported_shape("cell", i, shape);
+
+    /// Centroid
+    c_dst->centroid.x() = fin.get_scalar();
+    c_dst->centroid.y() = fin.get_scalar();
+    c_dst->centroid.z() = fin.get_scalar();
+
+    /// Volume
+    c_dst->volume = fin.get_scalar();
+
+    /// Included nodes
+    c_dst->vertex.resize(N1);
+    for (int j = 0; j < N1; ++j)
+        c_dst->vertex.at(j) = node.at(fin.get_size() - 1);
+
+    /// Included faces
+    c_dst->surface.resize(N2);
+    for (int j = 0; j < N2; ++j)
+        c_dst->surface.at(j) = face.at(fin.get_size() - 1);
+
+    /// Adjacent cells
+    c_dst->cell_adjacency.resize(N2);
+    for (int j = 0; j < N2; ++j)
+    {
+        const size_t tmp = fin.get_size();
+        c_dst->cell_adjacency.at(j) = (tmp == 0) ? nullptr : cell.at(tmp - 1);
+    }
+
+    /// Surface OUTWARD normal vectors
+    c_dst->S.resize(N2);
+    for (int j = 0; j < N2; ++j)
+    {
+        auto &tmp = c_dst->S.at(j);
+        tmp.x() = fin.get_scalar();
+        tmp.y() = fin.get_scalar();
+        tmp.z() = fin.get_scalar();
+        tmp *= c_dst->surface.at(j)->area;
+    }
+
+    /// Storage for derived geometric quantities
+    c_dst->d.resize(N2);
+    c_dst->S_E.resize(N2);
+    c_dst->S_T.resize(N2);
+}
+
+static void parse_patch(TokenStream &fin, size_t i)
+{
+    auto p_dst = patch[i - 1] = new Patch();
+
+    /// Identifier
+    p_dst->name = fin.get_string();
+
+    const size_t n_face = fin.get_size();
+    const size_t n_node = fin.get_size();
+
+    /// Included faces
+    p_dst->surface.resize(n_face);
+    for (size_t j = 0; j < n_face; ++j)
+    {
+        const size_t tmp = fin.get_size();
+        auto f_b = dynamic_cast<BoundaryFace *>(face.at(tmp - 1));
+        if (f_b == nullptr)
+            throw wrong_face(tmp);
+
+        p_dst->surface.at(j) = f_b;
+
+        /// Connection
+        f_b->parent = p_dst;
+    }
+
+    /// Included nodes
+    p_dst->vertex.resize(n_node);
+    for (size_t j = 0; j < n_node; ++j)
+        p_dst->vertex.at(j) = node.at(fin.get_size() - 1);
+}
+
+static void release_mesh()
+{
+    for (auto e : node)
+        delete e;
+    for (auto e : face)
+        delete e;
+    for (auto e : cell)
+        delete e;
+    for (auto e : patch)
+        delete e;
+    node.clear();
+    face.clear();
+    cell.clear();
+    patch.clear();
+}
+
+static void allocate_mesh(size_t NumOfNode, size_t NumOfFace, size_t NumOfCell, size_t NumOfPatch)
+{
+    node.assign(NumOfNode, nullptr);
+    face.assign(NumOfFace, nullptr);
+    cell.assign(NumOfCell, nullptr);
+    patch.assign(NumOfPatch, nullptr);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
+        node[i] = new Node();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        cell[i] = new Cell();
+}
+
+/**
+ * Line-parallel parsing, assuming every node, face and cell record occupies exactly one line.
+ * @return false if the assumption does not hold, in which case the mesh is left empty.
+ */
+static bool parse_by_line(const char *body, const char *end, size_t NumOfNode, size_t NumOfFace, size_t NumOfCell, size_t NumOfPatch, const std::string &fn)
+{
+    /// Chunks end right after a line break.
+    static const size_t CHUNK_SIZE = 1 << 20;
+    std::vector<const char *> chunk{body};
+    while (chunk.back() < end)
+    {
+        const char *p = chunk.back() + std::min<size_t>(CHUNK_SIZE, end - chunk.back());
+        while (p < end && *(p - 1) != '\n')
+            ++p;
+        chunk.push_back(p);
+    }
+    const size_t nChunk = chunk.size() - 1;
+
+    /// Non-blank lines per chunk, and 0-based index of the first record in each chunk.
+    std::vector<size_t> first(nChunk + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (size_t k = 0; k < nChunk; ++k)
+    {
+        size_t n = 0;
+        bool blank = true;
+        for (const char *p = chunk[k]; p < chunk[k + 1]; ++p)
+        {
+            if (*p == '\n')
+            {
+                n += blank ? 0 : 1;
+                blank = true;
+            }
+            else if (!is_space(*p))
+                blank = false;
+        }
+        first[k + 1] = n + (blank ? 0 : 1);
+    }
+    for (size_t k = 0; k < nChunk; ++k)
+        first[k + 1] += first[k];
+
+    const size_t r_face = NumOfNode, r_cell = NumOfNode + NumOfFace, r_patch = r_cell + NumOfCell;
+    if (first[nChunk] < r_patch)
+        return false;
+
+    allocate_mesh(NumOfNode, NumOfFace, NumOfCell, NumOfPatch);
+
+    /// Faces must exist before cells refer to them, hence two sweeps.
+    std::vector<std::exception_ptr> err(nChunk);
+    std::vector<char> mismatch(nChunk, 0);
+    const char *patch_begin = end;
+    bool failed = false;
+    for (int sweep = 0; sweep < 2 && !failed; ++sweep)
+    {
+        const size_t r_lo = sweep == 0 ? 0 : r_cell;
+        const size_t r_hi = sweep == 0 ? r_cell : r_patch;
+
+#pragma omp parallel for schedule(dynamic)
+        for (size_t k = 0; k < nChunk; ++k)
+        {
+            if (first[k + 1] <= r_lo || first[k] >= r_hi)
+                continue;
+
+            size_t r = first[k];
+            const char *p = chunk[k];
+            try
+            {
+                while (p < chunk[k + 1] && r < r_hi)
+                {
+                    const char *eol = p;
+                    bool blank = true;
+                    for (; eol < chunk[k + 1] && *eol != '\n'; ++eol)
+                        blank = blank && is_space(*eol);
+                    if (!blank)
+                    {
+                        if (r >= r_lo)
+                        {
+                            TokenStream fin(p, eol, fn);
+                            if (r < r_face)
+                                parse_node(fin, r + 1);
+                            else if (r < r_cell)
+                                parse_face(fin, r - r_face + 1);
+                            else
+                                parse_cell(fin, r - r_cell + 1);
+
+                            if (!fin.exhausted())
+                                throw record_layout_mismatch();
+                        }
+                        ++r;
+                    }
+                    p = eol + 1;
+                }
+                if (r == r_patch)
+                    patch_begin = p;
+            }
+            catch (const record_layout_mismatch &)
+            {
+                mismatch[k] = 1;
+            }
+            catch (...)
+            {
+                err[k] = std::current_exception();
+            }
+        }
+
+        for (size_t k = 0; k < nChunk; ++k)
+            failed = failed || mismatch[k] || err[k];
+    }
+
+    for (size_t k = 0; k < nChunk; ++k)
+    {
+        if (mismatch[k])
+        {
+            release_mesh();
+            return false;
+        }
+        if (err[k])
+        {
+            release_mesh();
+            std::rethrow_exception(err[k]);
+        }
+    }
+
+    /// Patches may span multiple lines.
+    if (patch_begin > end)
+        patch_begin = end;
+    TokenStream fin(patch_begin, end, fn);
+    try
+    {
+        for (size_t i = 1; i <= NumOfPatch; ++i)
+            parse_patch(fin, i);
+    }
+    catch (...)
+    {
+        release_mesh();
+        throw;
+    }
+
+    return true;
+}
+
+/**
+ * Load computation mesh in the text format of "read_mesh", producing identical entities.
+ * The file is mapped into memory and tokenized with "std::from_chars".
+ * When each node, face and cell record sits on its own line, the file is split
+ * at line boundaries into chunks parsed concurrently.
+ * Otherwise it is parsed sequentially as a plain token stream.
+ * @param path Path to the mesh file.
+ */
+void read_mesh_mapped(const std::string &path)
+{
+    FLM_PROFILE("read_mesh_mapped");
+    MappedFile src(path);
+    const char *begin = src.data(), *end = begin + src.size();
+
+    size_t NumOfPatch, NumOfNode, NumOfFace, NumOfCell;
+    try
+    {
+        TokenStream fin(begin, end, path);
+        NumOfNode = fin.get_size();
+        NumOfFace = fin.get_size();
+        NumOfCell = fin.get_size();
+        NumOfPatch = fin.get_size();
+
+        /// The header must sit on its own line for line-parallel parsing.
+        const char *eol = fin.position();
+        while (eol < end && *eol != '\n' && is_space(*eol))
+            ++eol;
+        if (eol < end && *eol == '\n' &&
+            parse_by_line(eol + 1, end, NumOfNode, NumOfFace, NumOfCell, NumOfPatch, path))
+            return;
+
+        allocate_mesh(NumOfNode, NumOfFace, NumOfCell, NumOfPatch);
+        try
+        {
+            for (size_t i = 1; i <= NumOfNode; ++i)
+                parse_node(fin, i);
+            for (size_t i = 1; i <= NumOfFace; ++i)
+                parse_face(fin, i);
+            for (size_t i = 1; i <= NumOfCell; ++i)
+                parse_cell(fin, i);
+            for (size_t i = 1; i <= NumOfPatch; ++i)
+                parse_patch(fin, i);
+        }
+        catch (...)
+        {
+            release_mesh();
+            throw;
+        }
+    }
+    catch (const record_layout_mismatch &)
+    {
+        throw invalid_file_format(path, "unexpected end of file.");
+    }
+}
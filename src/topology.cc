@@ -0,0 +1,243 @@
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/geom.h"
+#include "../inc/topology.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+/**
+ * Counting sort of (key, value) pairs into CSR form.
+ * Values of each key keep their input order.
+ * @param n_key Number of keys, which are 0-based.
+ * @param n_pair Number of pairs.
+ * @param pair Callable invoked as "pair(i, emit)", calling "emit(key, value)" for each pair generated by item "i".
+ * @param n_item Number of input items.
+ * @param ptr Offsets, [n_key + 1].
+ * @param idx Values grouped by key.
+ */
+template<typename F>
+static void counting_sort(size_t n_key, size_t n_item, F pair, std::vector<size_t> &ptr, std::vector<size_t> &idx)
+{
+    ptr.assign(n_key + 1, 0);
+    for (size_t i = 0; i < n_item; ++i)
+        pair(i, [&ptr](size_t key, size_t) { ++ptr[key + 1]; });
+
+    for (size_t k = 0; k < n_key; ++k)
+        ptr[k + 1] += ptr[k];
+
+    idx.resize(ptr[n_key]);
+    std::vector<size_t> pos(ptr.begin(), ptr.end() - 1);
+    for (size_t i = 0; i < n_item; ++i)
+        pair(i, [&pos, &idx](size_t key, size_t val) { idx[pos[key]++] = val; });
+}
+
+/**
+ * Create all entities from a face-based description.
+ * Derived in linear time:
+ *   cell to face and cell to cell, ordered by face index;
+ *   cell to node, in order of first appearance along its faces;
+ *   node to cell, ordered by cell index;
+ *   boundary flags and patch nodes.
+ * Centroids, areas, volumes and normals are then evaluated from node coordinates.
+ * @param src The face-based description.
+ */
+void build_mesh(const FLM_FACE_MESH &src)
+{
+    FLM_PROFILE("build_mesh");
+    const size_t NumOfNode = src.NumOfNode;
+    const size_t NumOfFace = src.NumOfFace;
+    const size_t NumOfCell = src.NumOfCell;
+    const size_t NumOfPatch = src.patch_name.size();
+
+    /// Validation
+    if (src.face_node_ptr[0] != 0)
+        throw inconsistent_connectivity("Face to node offsets must start from 0.");
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        const auto j0 = src.face_node_ptr[i], j1 = src.face_node_ptr[i + 1];
+        if (j1 < j0 + 3)
+            throw unsupported_shape("face", i + 1, static_cast<int>(j1 - j0));
+        for (auto j = j0; j < j1; ++j)
+            if (src.face_node_idx[j] == 0 || src.face_node_idx[j] > NumOfNode)
+                throw inconsistent_connectivity("Invalid node " + std::to_string(src.face_node_idx[j]) + " on face " + std::to_string(i + 1) + ".");
+
+        const auto c0 = src.face_cell[2 * i], c1 = src.face_cell[2 * i + 1];
+        if (c0 == 0 && c1 == 0)
+            throw empty_connectivity(i + 1);
+        if (c0 > NumOfCell || c1 > NumOfCell || c0 == c1)
+            throw inconsistent_connectivity("Invalid cells on face " + std::to_string(i + 1) + ".");
+    }
+    if (src.patch_face_ptr[0] != 0)
+        throw inconsistent_connectivity("Patch to face offsets must start from 0.");
+    for (size_t i = 0; i < NumOfPatch; ++i)
+        for (auto j = src.patch_face_ptr[i]; j < src.patch_face_ptr[i + 1]; ++j)
+            if (src.patch_face_idx[j] == 0 || src.patch_face_idx[j] > NumOfFace)
+                throw wrong_face(src.patch_face_idx[j]);
+
+    /// Cell to face
+    std::vector<size_t> cf_ptr, cf_idx;
+    counting_sort(NumOfCell, NumOfFace, [&src](size_t i, auto emit) {
+        for (int k = 0; k < 2; ++k)
+        {
+            const auto c = src.face_cell[2 * i + k];
+            if (c != 0)
+                emit(c - 1, i);
+        }
+    }, cf_ptr, cf_idx);
+
+    for (size_t i = 0; i < NumOfCell; ++i)
+        if (cf_ptr[i + 1] - cf_ptr[i] < 4)
+            throw inconsistent_connectivity("Cell " + std::to_string(i + 1) + " is not closed by its faces.");
+
+    /// Cell to node
+    std::vector<std::vector<size_t>> cn_list(NumOfCell);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto &dst = cn_list[i];
+        for (auto j = cf_ptr[i]; j < cf_ptr[i + 1]; ++j)
+        {
+            const auto f = cf_idx[j];
+            for (auto k = src.face_node_ptr[f]; k < src.face_node_ptr[f + 1]; ++k)
+            {
+                const size_t n = src.face_node_idx[k] - 1;
+                if (std::find(dst.begin(), dst.end(), n) == dst.end())
+                    dst.push_back(n);
+            }
+        }
+    }
+
+    /// Node to cell
+    std::vector<size_t> nc_ptr, nc_idx;
+    counting_sort(NumOfNode, NumOfCell, [&cn_list](size_t i, auto emit) {
+        for (auto n : cn_list[i])
+            emit(n, i);
+    }, nc_ptr, nc_idx);
+
+    /// Allocate memory for geom entities.
+    node.resize(NumOfNode);
+    face.resize(NumOfFace);
+    cell.resize(NumOfCell);
+    patch.resize(NumOfPatch);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
+        node[i] = new Node();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+        cell[i] = new Cell();
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        if (src.face_cell[2 * i] == 0 || src.face_cell[2 * i + 1] == 0)
+            face[i] = new BoundaryFace();
+        else
+            face[i] = new InternalFace();
+    }
+
+    /// Update nodal information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfNode; ++i)
+    {
+        auto n_dst = node[i];
+        n_dst->index = i + 1;
+        n_dst->at_boundary = false;
+        n_dst->coordinate << src.coordinate[3 * i], src.coordinate[3 * i + 1], src.coordinate[3 * i + 2];
+
+        const size_t j0 = nc_ptr[i], N = nc_ptr[i + 1] - j0;
+        n_dst->cell_dependency.resize(N);
+        for (size_t j = 0; j < N; ++j)
+            n_dst->cell_dependency[j] = cell[nc_idx[j0 + j]];
+
+        n_dst->cell_weighting1.resize(N);
+        n_dst->cell_weighting2.resize(N);
+        n_dst->cell_weighting3.resize(N);
+        n_dst->cell_weighting4.resize(N);
+    }
+
+    /// Update face information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfFace; ++i)
+    {
+        auto f_dst = face[i];
+        f_dst->parent = nullptr;
+        f_dst->index = i + 1;
+
+        const size_t j0 = src.face_node_ptr[i], N = src.face_node_ptr[i + 1] - j0;
+        f_dst->vertex.resize(N);
+        for (size_t j = 0; j < N; ++j)
+            f_dst->vertex[j] = node[src.face_node_idx[j0 + j] - 1];
+
+        const auto c0 = src.face_cell[2 * i], c1 = src.face_cell[2 * i + 1];
+        f_dst->c0 = (c0 == 0) ? nullptr : cell[c0 - 1];
+        f_dst->c1 = (c1 == 0) ? nullptr : cell[c1 - 1];
+    }
+
+    /// Nodes on any boundary face are boundary nodes.
+    for (size_t i = 0; i < NumOfFace; ++i)
+        if (face[i]->at_boundary())
+            for (auto n : face[i]->vertex)
+                n->at_boundary = true;
+
+    /// Update cell information.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfCell; ++i)
+    {
+        auto c_dst = cell[i];
+        c_dst->index = i + 1;
+
+        c_dst->vertex.resize(cn_list[i].size());
+        for (size_t j = 0; j < cn_list[i].size(); ++j)
+            c_dst->vertex[j] = node[cn_list[i][j]];
+
+        const size_t j0 = cf_ptr[i], N = cf_ptr[i + 1] - j0;
+        c_dst->surface.resize(N);
+        c_dst->cell_adjacency.resize(N);
+        for (size_t j = 0; j < N; ++j)
+        {
+            auto f = face[cf_idx[j0 + j]];
+            c_dst->surface[j] = f;
+            c_dst->cell_adjacency[j] = (f->c0 == c_dst) ? f->c1 : f->c0;
+        }
+
+        c_dst->S.resize(N);
+        c_dst->d.resize(N);
+        c_dst->S_E.resize(N);
+        c_dst->S_T.resize(N);
+    }
+
+    /// Update boundary patch information.
+    for (size_t i = 0; i < NumOfPatch; ++i)
+    {
+        auto p_dst = patch[i] = new Patch();
+        p_dst->name = src.patch_name[i];
+
+        std::vector<size_t> vertex;
+        for (auto j = src.patch_face_ptr[i]; j < src.patch_face_ptr[i + 1]; ++j)
+        {
+            const auto idx = src.patch_face_idx[j];
+            auto f_b = dynamic_cast<BoundaryFace *>(face[idx - 1]);
+            if (f_b == nullptr)
+                throw wrong_face(idx);
+
+            p_dst->surface.push_back(f_b);
+            f_b->parent = p_dst;
+            for (auto n : f_b->vertex)
+                vertex.push_back(n->index - 1);
+        }
+
+        std::sort(vertex.begin(), vertex.end());
+        vertex.erase(std::unique(vertex.begin(), vertex.end()), vertex.end());
+        p_dst->vertex.resize(vertex.size());
+        for (size_t j = 0; j < vertex.size(); ++j)
+            p_dst->vertex[j] = node[vertex[j]];
+    }
+
+    calculate_mesh_metrics();
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <algorithm>
+#include "../inc/element.h"
+#include "../inc/io.h"
+#include "../inc/locator.h"
+#include "../inc/transfer.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static void release_mesh(std::vector<Patch *> &p, std::vector<Node *> &n, std::vector<Face *> &f, std::vector<Cell *> &c)
+{
+    for (auto e : n)
+        delete e;
+    for (auto e : f)
+        delete e;
+    for (auto e : c)
+        delete e;
+    for (auto e : p)
+        delete e;
+    n.clear();
+    f.clear();
+    c.clear();
+    p.clear();
+}
+
+static void swap_mesh(std::vector<Patch *> &p, std::vector<Node *> &n, std::vector<Face *> &f, std::vector<Cell *> &c)
+{
+    patch.swap(p);
+    node.swap(n);
+    face.swap(f);
+    cell.swap(c);
+}
+
+/**
+ * Interpolate a solution from another mesh onto the loaded one, as initial condition.
+ * Each target point is located in the source mesh and takes the value of the containing cell,
+ * reconstructed linearly with its Green-Gauss gradient and bounded by the values on that cell,
+ * its faces, neighbours and vertices. Points outside the source mesh use the cell with the nearest centroid.
+ * Cells and internal faces are set, boundary faces are left to the B.C. and nodes to the caller.
+ * @param mesh_path Path to the source mesh, in any supported format.
+ * @param data_path Path to the source solution, consistent with the source mesh.
+ */
+void transfer_solution(const std::string &mesh_path, const std::string &data_path)
+{
+    FLM_PROFILE("transfer_solution");
+    /// The source mesh occupies the global containers while it is loaded
+    std::vector<Patch *> dst_patch;
+    std::vector<Node *> dst_node;
+    std::vector<Face *> dst_face;
+    std::vector<Cell *> dst_cell;
+    swap_mesh(dst_patch, dst_node, dst_face, dst_cell);
+    try
+    {
+        size_t src_iter;
+        FLM_SCALAR src_t;
+        load_mesh(mesh_path);
+        load_data(data_path, src_iter, src_t);
+    }
+    catch (...)
+    {
+        release_mesh(patch, node, face, cell);
+        swap_mesh(dst_patch, dst_node, dst_face, dst_cell);
+        throw;
+    }
+
+    /// Green-Gauss gradient of each source cell, and bounds over its faces, neighbours and vertices
+    const size_t NumOfSrcCell = cell.size();
+    std::vector<FLM_VECTOR> grad(NumOfSrcCell);
+    std::vector<FLM_SCALAR> lo(NumOfSrcCell), hi(NumOfSrcCell);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < NumOfSrcCell; ++i)
+    {
+        const auto c = cell[i];
+        grad[i].setZero();
+        lo[i] = hi[i] = c->T;
+        for (size_t j = 0; j < c->surface.size(); ++j)
+        {
+            const auto f = c->surface[j];
+            grad[i] += f->T * c->S[j];
+            for (FLM_SCALAR val : {f->T, f->c0 ? f->c0->T : f->T, f->c1 ? f->c1->T : f->T})
+            {
+                lo[i] = std::min(lo[i], val);
+                hi[i] = std::max(hi[i], val);
+            }
+        }
+        for (auto n : c->vertex)
+        {
+            lo[i] = std::min(lo[i], n->T);
+            hi[i] = std::max(hi[i], n->T);
+        }
+        grad[i] /= c->volume;
+    }
+
+    const CellLocator locator(cell);
+    std::vector<Patch *> src_patch;
+    std::vector<Node *> src_node;
+    std::vector<Face *> src_face;
+    std::vector<Cell *> src_cell;
+    swap_mesh(src_patch, src_node, src_face, src_cell);
+    swap_mesh(dst_patch, dst_node, dst_face, dst_cell);
+
+    auto sample = [&](const FLM_VECTOR &x, size_t &outside) {
+        const Cell *c = locator.locate(x);
+        if (c == nullptr)
+        {
+            c = locator.nearest(x);
+            ++outside;
+        }
+        const size_t k = c->index - 1;
+        return std::clamp(c->T + grad[k].dot(x - c->centroid), lo[k], hi[k]);
+    };
+
+    const size_t NumOfCell = cell.size();
+    const size_t NumOfFace = face.size();
+    size_t outside = 0;
+#pragma omp parallel
+    {
+#pragma omp for schedule(static) reduction(+:outside) nowait
+        for (size_t i = 0; i < NumOfCell; ++i)
+            cell[i]->T = sample(cell[i]->centroid, outside);
+#pragma omp for schedule(static) reduction(+:outside) nowait
+        for (size_t i = 0; i < NumOfFace; ++i)
+            if (!face[i]->at_boundary())
+                face[i]->T = sample(face[i]->centroid, outside);
+    }
+    if (outside > 0)
+        std::cout << "\nWarning: " << outside << " point(s) outside the source mesh, using nearest cells." << std::endl;
+
+    release_mesh(src_patch, src_node, src_face, src_cell);
+}
@@ -0,0 +1,249 @@
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+#include "../inc/element.h"
+#include "../inc/binfile.h"
+#include "../inc/vtk.h"
+#include "../inc/profile.h"
+
+extern std::vector<Patch *> patch;
+extern std::vector<Node *> node;
+extern std::vector<Face *> face;
+extern std::vector<Cell *> cell;
+
+static const unsigned char VTK_TETRA = 10;
+static const unsigned char VTK_POLYHEDRON = 42;
+
+/**
+ * Append one block of raw data, preceded by its size as required by header_type="UInt64".
+ * @return Offset of the block within "dst".
+ */
+static size_t append_block(std::vector<char> &dst, const void *src, size_t bytes)
+{
+    const size_t pos = dst.size();
+    const uint64_t len = bytes;
+    dst.resize(pos + sizeof(len) + bytes);
+    std::memcpy(dst.data() + pos, &len, sizeof(len));
+    if (bytes > 0)
+        std::memcpy(dst.data() + pos + sizeof(len), src, bytes);
+    return pos;
+}
+
+static std::string data_array(const char *type, const char *name, int n_comp, size_t offset)
+{
+    std::ostringstream ss;
+    ss << "<DataArray type=\"" << type << "\" Name=\"" << name << "\"";
+    if (n_comp > 1)
+        ss << " NumberOfComponents=\"" << n_comp << "\"";
+    ss << " format=\"appended\" offset=\"" << offset << "\"/>\n";
+    return ss.str();
+}
+
+/**
+ * Prepare output of a series.
+ * @param dir Output directory.
+ * @param prefix File name of each step is "prefix" followed by the iteration.
+ * @param resume Keep entries of an existing collection.
+ */
+VtuSeries::VtuSeries(const std::string &dir, const std::string &prefix, bool resume) :
+    dir(dir),
+    prefix(prefix)
+{
+    if (!host_is_little_endian())
+        throw std::runtime_error("VTK output is only supported on little-endian hosts.");
+
+    if (resume)
+    {
+        std::ifstream in(std::filesystem::path(dir) / (prefix + ".pvd"));
+        std::string s;
+        while (std::getline(in, s))
+            if (s.find("<DataSet") != std::string::npos)
+                record.push_back(s);
+    }
+
+    encode_topology();
+}
+
+/**
+ * Encode node locations and cell connectivity.
+ * Faces of polyhedra are ordered to have their normals pointing out of the cell,
+ * as detected from the vertex order of each face against "n01".
+ * Tetrahedra are reordered to have positive volume.
+ */
+void VtuSeries::encode_topology()
+{
+    FLM_PROFILE("VtuSeries::encode_topology");
+    std::vector<FLM_SCALAR> coordinate(3 * node.size());
+    for (size_t i = 0; i < node.size(); ++i)
+        for (int k = 0; k < 3; ++k)
+            coordinate[3 * i + k] = node[i]->coordinate(k);
+
+    std::vector<char> aligned(face.size());
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < face.size(); ++i)
+    {
+        const auto &v = face[i]->vertex;
+        FLM_VECTOR n = FLM_VECTOR::Zero();
+        for (size_t j = 0; j < v.size(); ++j)
+            n += v[j]->coordinate.cross(v[(j + 1) % v.size()]->coordinate);
+        aligned[i] = n.dot(face[i]->n01) > 0.0;
+    }
+
+    std::vector<int64_t> connectivity, offsets, faces, faceoffsets;
+    std::vector<unsigned char> types;
+    offsets.reserve(cell.size());
+    faceoffsets.reserve(cell.size());
+    types.reserve(cell.size());
+    for (auto c : cell)
+    {
+        for (auto n : c->vertex)
+            connectivity.push_back(n->index - 1);
+
+        if (c->vertex.size() == 4 && c->surface.size() == 4)
+        {
+            /// VTK expects the first three vertices to see the last one on their positive side
+            const auto &v = c->vertex;
+            const FLM_VECTOR a = v[1]->coordinate - v[0]->coordinate;
+            const FLM_VECTOR b = v[2]->coordinate - v[0]->coordinate;
+            const FLM_VECTOR d = v[3]->coordinate - v[0]->coordinate;
+            if (a.cross(b).dot(d) < 0.0)
+                std::swap(connectivity[connectivity.size() - 1], connectivity[connectivity.size() - 2]);
+            offsets.push_back(connectivity.size());
+            types.push_back(VTK_TETRA);
+            faceoffsets.push_back(-1);
+            continue;
+        }
+
+        offsets.push_back(connectivity.size());
+        types.push_back(VTK_POLYHEDRON);
+        faces.push_back(c->surface.size());
+        for (auto f : c->surface)
+        {
+            const auto &v = f->vertex;
+            faces.push_back(v.size());
+            const bool forward = aligned[f->index - 1] == (f->c0 == c);
+            for (size_t j = 0; j < v.size(); ++j)
+                faces.push_back(v[forward ? j : v.size() - 1 - j]->index - 1);
+        }
+        faceoffsets.push_back(faces.size());
+    }
+    const bool polyhedral = !faces.empty();
+
+    topology.clear();
+    std::ostringstream ss;
+    ss << "<Points>\n";
+    ss << data_array("Float64", "Points", 3, append_block(topology, coordinate.data(), coordinate.size() * sizeof(FLM_SCALAR)));
+    ss << "</Points>\n";
+    ss << "<Cells>\n";
+    ss << data_array("Int64", "connectivity", 1, append_block(topology, connectivity.data(), connectivity.size() * sizeof(int64_t)));
+    ss << data_array("Int64", "offsets", 1, append_block(topology, offsets.data(), offsets.size() * sizeof(int64_t)));
+    ss << data_array("UInt8", "types", 1, append_block(topology, types.data(), types.size()));
+    if (polyhedral)
+    {
+        ss << data_array("Int64", "faces", 1, append_block(topology, faces.data(), faces.size() * sizeof(int64_t)));
+        ss << data_array("Int64", "faceoffsets", 1, append_block(topology, faceoffsets.data(), faceoffsets.size() * sizeof(int64_t)));
+    }
+    ss << "</Cells>\n";
+    topology_xml = ss.str();
+}
+
+/**
+ * Dump current solution and add it to the collection.
+ * @param iter Iteration, used in the file name.
+ * @param t Physical time, used as the time step of the collection.
+ */
+void VtuSeries::write(size_t iter, FLM_SCALAR t)
+{
+    FLM_PROFILE("VtuSeries::write");
+    const std::string name = prefix + std::to_string(iter) + ".vtu";
+    const std::filesystem::path path = std::filesystem::path(dir) / name;
+
+    std::vector<FLM_SCALAR> node_T(node.size()), cell_T(cell.size()), cell_grad_T(3 * cell.size());
+#pragma omp parallel
+    {
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < node.size(); ++i)
+            node_T[i] = node[i]->T;
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < cell.size(); ++i)
+        {
+            cell_T[i] = cell[i]->T;
+            for (int k = 0; k < 3; ++k)
+                cell_grad_T[3 * i + k] = cell[i]->grad_T(k);
+        }
+    }
+
+    /// Offsets of fields start after the cached topology
+    field.clear();
+    const size_t base = topology.size();
+    std::ostringstream ss;
+    ss << "<?xml version=\"1.0\"?>\n";
+    ss << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n";
+    ss << "<UnstructuredGrid>\n";
+    ss << "<Piece NumberOfPoints=\"" << node.size() << "\" NumberOfCells=\"" << cell.size() << "\">\n";
+    ss << topology_xml;
+    ss << "<PointData Scalars=\"T\">\n";
+    ss << data_array("Float64", "T", 1, base + append_block(field, node_T.data(), node_T.size() * sizeof(FLM_SCALAR)));
+    ss << "</PointData>\n";
+    ss << "<CellData Scalars=\"T\" Vectors=\"grad_T\">\n";
+    ss << data_array("Float64", "T", 1, base + append_block(field, cell_T.data(), cell_T.size() * sizeof(FLM_SCALAR)));
+    ss << data_array("Float64", "grad_T", 3, base + append_block(field, cell_grad_T.data(), cell_grad_T.size() * sizeof(FLM_SCALAR)));
+    ss << "</CellData>\n";
+    ss << "</Piece>\n";
+    ss << "</UnstructuredGrid>\n";
+    ss << "<AppendedData encoding=\"raw\">\n_";
+    const std::string head = ss.str();
+    static const std::string TAIL = "\n</AppendedData>\n</VTKFile>\n";
+
+    std::ofstream out(path, std::ios::binary);
+    if (out.fail())
+        throw failed_to_open_file(path.string());
+    out.write(head.data(), head.size());
+    out.write(topology.data(), topology.size());
+    out.write(field.data(), field.size());
+    out.write(TAIL.data(), TAIL.size());
+    out.close();
+    if (out.fail())
+        throw std::runtime_error("Failed to write \"" + path.string() + "\".");
+
+    /// Entries left by an interrupted run are superseded
+    const std::string file_attr = "file=\"" + name + "\"";
+    record.erase(std::remove_if(record.begin(), record.end(), [&file_attr](const std::string &e) {
+        return e.find(file_attr) != std::string::npos;
+    }), record.end());
+
+    std::ostringstream entry;
+    entry.precision(std::numeric_limits<FLM_SCALAR>::max_digits10);
+    entry << "    <DataSet timestep=\"" << t << "\" group=\"\" part=\"0\" file=\"" << name << "\"/>";
+    record.push_back(entry.str());
+    write_collection();
+}
+
+/**
+ * Rewrite the collection file, replacing the previous one atomically.
+ */
+void VtuSeries::write_collection() const
+{
+    const std::filesystem::path path = std::filesystem::path(dir) / (prefix + ".pvd");
+    const std::string tmp = path.string() + ".part";
+    {
+        std::ofstream out(tmp);
+        if (out.fail())
+            throw failed_to_open_file(tmp);
+        out << "<?xml version=\"1.0\"?>\n";
+        out << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"LittleEndian\">\n";
+        out << "  <Collection>\n";
+        for (const auto &e : record)
+            out << e << '\n';
+        out << "  </Collection>\n";
+        out << "</VTKFile>\n";
+        if (out.fail())
+            throw std::runtime_error("Failed to write \"" + tmp + "\".");
+    }
+    if (std::rename(tmp.c_str(), path.string().c_str()) != 0)
+        throw std::runtime_error("Failed to replace \"" + path.string() + "\".");
+}
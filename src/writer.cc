@@ -0,0 +1,127 @@
+#include <algorithm>
+#include "../inc/writer.h"
+#include "../inc/alloctrack.h"
+#include "../inc/profile.h"
+
+/**
+ * @param depth Number of snapshot buffers, at least 1.
+ * @param mesh Fingerprint of the mesh, stamped on every snapshot.
+ * @param sink Encoder and writer of one snapshot.
+ */
+AsyncWriter::AsyncWriter(size_t depth, uint64_t mesh, Sink sink) :
+    sink(std::move(sink)),
+    pool(std::max<size_t>(depth, 1)),
+    busy(0),
+    stop(false)
+{
+    idle.reserve(pool.size());
+    ready.reserve(pool.size());
+    for (auto &e : pool)
+    {
+        /// Sized upfront, so that "submit" only copies
+        gather_snapshot(e, 0, 0.0);
+        e.mesh = mesh;
+        idle.push_back(&e);
+    }
+    worker = std::thread(&AsyncWriter::run, this);
+}
+
+/**
+ * Drain the queue and join the background thread.
+ * Errors raised by pending writes are dropped here, call "flush" beforehand to observe them.
+ */
+AsyncWriter::~AsyncWriter()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+/**
+ * Copy current field into an idle buffer and queue it for writing.
+ * @param iter Iteration of the field.
+ * @param t Physical time of the field.
+ */
+void AsyncWriter::submit(size_t iter, FLM_SCALAR t)
+{
+    Snapshot *buf;
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        cv.wait(lck, [this] { return !idle.empty() || error; });
+        rethrow();
+        buf = idle.back();
+        idle.pop_back();
+    }
+
+    /// Copying happens outside the lock, the worker never touches idle buffers.
+    gather_snapshot(*buf, iter, t);
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        ready.push_back(buf);
+    }
+    cv.notify_all();
+}
+
+/**
+ * Block until every queued snapshot has been written.
+ * Rethrows the first error raised on the background thread.
+ */
+void AsyncWriter::flush()
+{
+    std::unique_lock<std::mutex> lck(mtx);
+    cv.wait(lck, [this] { return (ready.empty() && busy == 0) || error; });
+    rethrow();
+}
+
+void AsyncWriter::rethrow()
+{
+    if (error)
+    {
+        auto e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void AsyncWriter::run()
+{
+    profile_thread_name("output");
+    alloc_exclude_thread();
+    while (true)
+    {
+        Snapshot *buf;
+        {
+            std::unique_lock<std::mutex> lck(mtx);
+            cv.wait(lck, [this] { return !ready.empty() || stop; });
+            if (ready.empty())
+                return;
+            buf = ready.front();
+            ready.erase(ready.begin());
+            ++busy;
+        }
+
+        std::exception_ptr err;
+        try
+        {
+            FLM_PROFILE("AsyncWriter::sink");
+            sink(*buf);
+        }
+        catch (...)
+        {
+            err = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            --busy;
+            idle.push_back(buf);
+            if (err && !error)
+                error = err;
+        }
+        cv.notify_all();
+    }
+}